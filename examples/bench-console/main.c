@@ -0,0 +1,242 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Console_Format throughput, before and after the switch to
+ * buffered formatting.
+ *
+ * The "legacy" benchmarks use a copy of the original formatter,
+ * which made one writeChar call per character and recursed once
+ * per digit. Each formatter runs against a null console, to
+ * isolate the cost of formatting, and against the VGA console.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "intr.h"
+#include "clock.h"
+#include "bench.h"
+
+#define TEST_FORMAT  "%08x: %d %u %s\n"
+#define TEST_ARGS    0xC0FFEE, -12345, 4000000000U, "abcdefgh"
+
+static uint32 nullBytes;
+
+static fastcall void
+nullWriteChar(char c)
+{
+   nullBytes++;
+}
+
+static fastcall void
+nullWriteBuffer(const char *buf, uint32 len)
+{
+   nullBytes += len;
+}
+
+static fastcall void
+nullFlush(void)
+{
+}
+
+
+/*
+ * The original formatter, for comparison.
+ */
+
+static fastcall void
+legacyWriteUInt32(uint32 num, int digits, char padding, int base, Bool suppressZero)
+{
+   if (digits == 0) {
+      return;
+   }
+
+   legacyWriteUInt32(num / base, digits - 1, padding, base, TRUE);
+
+   if (num == 0 && suppressZero) {
+      if (padding) {
+         Console_WriteChar(padding);
+      }
+   } else {
+      uint8 digit = num % base;
+      Console_WriteChar(digit >= 10 ? digit - 10 + 'A' : digit + '0');
+   }
+}
+
+static fastcall void
+legacyFormatV(const char **args)
+{
+   char c;
+   const char *fmt = *(args++);
+
+   while ((c = *(fmt++))) {
+      int width = 0;
+      Bool isSigned = FALSE;
+      char padding = '\0';
+
+      if (c != '%') {
+         Console_WriteChar(c);
+         continue;
+      }
+
+      while ((c = *(fmt++))) {
+         if (c == '0' && width == 0) {
+            padding = '0';
+            continue;
+         }
+         if (c >= '0' && c <= '9') {
+            width = (width * 10) + (c - '0');
+            if (padding == '\0') {
+               padding = ' ';
+            }
+            continue;
+         }
+         if (width == 0) {
+            width = 32;
+         }
+
+         if (c == 's') {
+            const char *str = (const char*) *(args++);
+            while ((c = *(str++))) {
+               Console_WriteChar(c);
+            }
+            break;
+         }
+         if (c == 'c') {
+            Console_WriteChar((char)(uint32) *(args++));
+            break;
+         }
+
+         int base = 0;
+
+         if (c == 'X' || c == 'x') {
+            base = 16;
+         } else if (c == 'd') {
+            base = 10;
+            isSigned = TRUE;
+         } else if (c == 'u') {
+            base = 10;
+         } else if (c == 'b') {
+            base = 2;
+         }
+
+         if (base) {
+            uint32 value = (uint32)*(args++);
+
+            if (isSigned && 0 > (int32)value) {
+               Console_WriteChar('-');
+               width--;
+               value = -value;
+            }
+
+            legacyWriteUInt32(value, width, padding, base, FALSE);
+            break;
+         }
+
+         Console_WriteChar(c);
+         break;
+      }
+   }
+}
+
+static void
+legacyFormat(const char *fmt, ...)
+{
+   legacyFormatV(&fmt);
+}
+
+
+/*
+ * Benchmarks. 'arg' is the console to format into.
+ */
+
+static fastcall void
+benchLegacyFormat(uint32 iterations, void *arg)
+{
+   ConsoleInterface saved = gConsole;
+
+   gConsole = *(ConsoleInterface*)arg;
+   while (iterations--) {
+      legacyFormat(TEST_FORMAT, TEST_ARGS);
+   }
+   Console_Flush();
+   gConsole = saved;
+}
+
+static fastcall void
+benchFormat(uint32 iterations, void *arg)
+{
+   ConsoleInterface saved = gConsole;
+
+   gConsole = *(ConsoleInterface*)arg;
+   while (iterations--) {
+      Console_Format(TEST_FORMAT, TEST_ARGS);
+   }
+   Console_Flush();
+   gConsole = saved;
+}
+
+static fastcall void
+benchFormat64(uint32 iterations, void *arg)
+{
+   ConsoleInterface saved = gConsole;
+
+   gConsole = *(ConsoleInterface*)arg;
+   while (iterations--) {
+      Console_Format("%016llx %llu\n", 0x0123456789ABCDEFULL, 12345678901234567ULL);
+   }
+   Console_Flush();
+   gConsole = saved;
+}
+
+static ConsoleInterface nullConsole;
+static ConsoleInterface nullCharConsole;
+static ConsoleInterface vgaConsole;
+static ConsoleInterface vgaCharConsole;
+
+static Bench benchmarks[] = {
+   { "Legacy format, null console", benchLegacyFormat, &nullCharConsole },
+   { "Console_Format, null console, writeChar only", benchFormat, &nullCharConsole },
+   { "Console_Format, null console", benchFormat, &nullConsole },
+   { "Console_Format %llx/%llu, null console", benchFormat64, &nullConsole },
+   { "Legacy format, VGA", benchLegacyFormat, &vgaCharConsole },
+   { "Console_Format, VGA, writeChar only", benchFormat, &vgaCharConsole },
+   { "Console_Format, VGA", benchFormat, &vgaConsole },
+};
+
+int
+main(void)
+{
+   int i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   vgaConsole = gConsole;
+   vgaCharConsole = gConsole;
+   vgaCharConsole.writeBuffer = NULL;
+
+   nullConsole = gConsole;
+   nullConsole.writeChar = nullWriteChar;
+   nullConsole.writeBuffer = nullWriteBuffer;
+   nullConsole.flush = nullFlush;
+   nullCharConsole = nullConsole;
+   nullCharConsole.writeBuffer = NULL;
+
+   Console_WriteString("Calibrating...\n");
+   Console_Flush();
+
+   Clock_Init();
+   Bench_Init();
+
+   for (i = 0; i < arraysize(benchmarks); i++) {
+      Bench_Register(&benchmarks[i]);
+   }
+
+   Console_WriteString("Running benchmarks...\n");
+   Console_Flush();
+
+   Bench_RunAll();
+
+   return 0;
+}
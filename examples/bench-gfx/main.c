@@ -0,0 +1,193 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Fill-rate and blit-rate benchmarks for the gfx module, at 8, 16
+ * and 32 bits per pixel, with and without the SSE2 fast paths. Fills
+ * and blits go straight to the framebuffer; blit sources are in
+ * system memory. Results go to COM1, in megapixels per second.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "clock.h"
+#include "bench.h"
+#include "vbe.h"
+#include "gfx.h"
+
+#define WIDTH        640
+#define HEIGHT       480
+#define SPRITE_SIZE  256
+#define SMALL_SIZE   32
+#define KEY_COLOR    0x05
+
+static GfxSurface screen;
+static GfxSurface opaqueSprite, keyedSprite, alphaSprite;
+
+static uint32 opaquePixels[SPRITE_SIZE * SPRITE_SIZE];
+static uint32 keyedPixels[SPRITE_SIZE * SPRITE_SIZE];
+static uint32 alphaPixels[SPRITE_SIZE * SPRITE_SIZE];
+
+/*
+ * Each benchmark's argument selects the SSE2 fast paths (TRUE) or
+ * rep stosl / rep movsl (FALSE).
+ */
+
+static fastcall void
+benchFillScreen(uint32 iterations, void *arg)
+{
+   gGfx.sse2 = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      Gfx_FillRect(&screen, 0, 0, WIDTH, HEIGHT, iterations);
+   }
+}
+
+static fastcall void
+benchFillSmall(uint32 iterations, void *arg)
+{
+   gGfx.sse2 = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      Gfx_FillRect(&screen, iterations & 0xFF, 100, SMALL_SIZE, SMALL_SIZE, iterations);
+   }
+}
+
+static fastcall void
+benchBlit(uint32 iterations, void *arg)
+{
+   gGfx.sse2 = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      Gfx_Blit(&screen, iterations & 0xFF, 100, &opaqueSprite, 0, 0,
+               SPRITE_SIZE, SPRITE_SIZE);
+   }
+}
+
+static fastcall void
+benchBlitKeyed(uint32 iterations, void *arg)
+{
+   gGfx.sse2 = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      Gfx_BlitKeyed(&screen, iterations & 0xFF, 100, &keyedSprite, 0, 0,
+                    SPRITE_SIZE, SPRITE_SIZE, KEY_COLOR);
+   }
+}
+
+static fastcall void
+benchBlitAlpha(uint32 iterations, void *arg)
+{
+   gGfx.sse2 = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      Gfx_BlitAlpha(&screen, iterations & 0xFF, 100, &alphaSprite, 0, 0,
+                    SPRITE_SIZE, SPRITE_SIZE);
+   }
+}
+
+static fastcall void
+benchLine(uint32 iterations, void *arg)
+{
+   while (iterations--) {
+      Gfx_Line(&screen, 0, iterations & 0xFF, WIDTH - 1, HEIGHT - 1, iterations);
+   }
+}
+
+typedef struct {
+   Bench   bench;
+   uint32  bpp;
+   uint32  pixels;      // Per operation
+} GfxBench;
+
+#define GFX_BENCH(bpp, name, fn, pixels)                                           \
+   { { name ", " #bpp "bpp, SSE2", fn, (void*) TRUE }, bpp, pixels },              \
+   { { name ", " #bpp "bpp, rep stos/movs", fn, (void*) FALSE }, bpp, pixels }
+
+#define GFX_BENCHES(bpp)                                                           \
+   GFX_BENCH(bpp, "Gfx_FillRect 640x480", benchFillScreen, WIDTH * HEIGHT),        \
+   GFX_BENCH(bpp, "Gfx_FillRect 32x32", benchFillSmall, SMALL_SIZE * SMALL_SIZE),  \
+   GFX_BENCH(bpp, "Gfx_Blit 256x256", benchBlit, SPRITE_SIZE * SPRITE_SIZE),       \
+   GFX_BENCH(bpp, "Gfx_BlitKeyed 256x256", benchBlitKeyed, SPRITE_SIZE * SPRITE_SIZE)
+
+static GfxBench benchmarks[] = {
+   GFX_BENCHES(8),
+   GFX_BENCHES(16),
+   GFX_BENCH(16, "Gfx_BlitAlpha 256x256", benchBlitAlpha, SPRITE_SIZE * SPRITE_SIZE),
+   { { "Gfx_Line 640 pixels, 16bpp", benchLine }, 16, WIDTH },
+   GFX_BENCHES(32),
+   GFX_BENCH(32, "Gfx_BlitAlpha 256x256", benchBlitAlpha, SPRITE_SIZE * SPRITE_SIZE),
+   { { "Gfx_Line 640 pixels, 32bpp", benchLine }, 32, WIDTH },
+};
+
+/*
+ * Switch video modes, and draw the sprites in the new pixel format.
+ * The keyed sprite is a checkerboard with transparent squares; the
+ * alpha sprite is always 32-bit ARGB, with alpha ramping across it.
+ */
+
+static void
+setMode(uint32 bpp)
+{
+   int x, y;
+
+   VBE_InitSimple(WIDTH, HEIGHT, bpp);
+   Gfx_InitVBESurface(&screen, NULL);
+
+   Gfx_InitSurface(&opaqueSprite, opaquePixels, SPRITE_SIZE, SPRITE_SIZE,
+                   SPRITE_SIZE * screen.bytesPerPixel, bpp);
+   Gfx_InitSurface(&keyedSprite, keyedPixels, SPRITE_SIZE, SPRITE_SIZE,
+                   SPRITE_SIZE * screen.bytesPerPixel, bpp);
+   Gfx_InitSurface(&alphaSprite, alphaPixels, SPRITE_SIZE, SPRITE_SIZE,
+                   SPRITE_SIZE * sizeof(uint32), 32);
+
+   for (y = 0; y < SPRITE_SIZE; y++) {
+      for (x = 0; x < SPRITE_SIZE; x++) {
+         Gfx_PutPixel(&opaqueSprite, x, y, x ^ y);
+         Gfx_PutPixel(&keyedSprite, x, y, ((x ^ y) & 16) ? KEY_COLOR : x + y);
+         Gfx_PutPixel(&alphaSprite, x, y, (x << 24) | (y << 8) | 0xFF);
+      }
+   }
+}
+
+int
+main(void)
+{
+   Bool haveSSE2;
+   uint32 bpp = 0;
+   int i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, SERIAL_MAX_BAUD);
+
+   Clock_Init();
+   Bench_Init();
+   Gfx_Init();
+
+   haveSSE2 = gGfx.sse2;
+   Console_Format("SSE2 %s\n\n", haveSSE2 ? "available" : "not available");
+
+   for (i = 0; i < arraysize(benchmarks); i++) {
+      GfxBench *b = &benchmarks[i];
+
+      if (b->bench.arg && !haveSSE2) {
+         continue;
+      }
+      if (b->bpp != bpp) {
+         bpp = b->bpp;
+         setMode(bpp);
+      }
+
+      Bench_Run(&b->bench);
+      Bench_Report(&b->bench);
+
+      Console_Format("   %u Mpixels/s\n",
+                     (uint32)(b->pixels * 100000ULL / MAX(b->bench.medianCentinanos, 1)));
+   }
+
+   gGfx.sse2 = haveSSE2;
+   return 0;
+}
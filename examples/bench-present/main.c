@@ -0,0 +1,162 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Measure the cost of presenting a frame through the damage-tracked
+ * presentation layer: a mostly-static UI, where only a clock and a
+ * mouse pointer change each frame, versus a full-screen update.
+ * Each is run with SSE2 streaming stores and with ordinary stores.
+ * Results go to COM1, in frames per second.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "clock.h"
+#include "bench.h"
+#include "vbe.h"
+#include "present.h"
+
+#define WIDTH      640
+#define HEIGHT     480
+
+#define CLOCK_X    (WIDTH - 104)
+#define CLOCK_Y    6
+#define CLOCK_W    96
+#define CLOCK_H    16
+#define CURSOR_W   12
+#define CURSOR_H   20
+
+static uint32 backBuffer[WIDTH * HEIGHT];
+
+static inline uint32
+rgb(uint8 r, uint8 g, uint8 b)
+{
+   return (r << 16) | (g << 8) | b;
+}
+
+static fastcall void
+fillRect(int x, int y, int w, int h, uint32 color)
+{
+   int i;
+
+   for (i = 0; i < h; i++) {
+      memset32(Present_BackBuffer(x, y + i), color, w);
+   }
+   Present_Damage(x, y, w, h);
+}
+
+/*
+ * A desktop: a gradient background, a title bar, and a couple of
+ * windows. It's drawn once; the benchmarks only touch small parts.
+ */
+
+static void
+drawDesktop(void)
+{
+   int y;
+
+   for (y = 0; y < HEIGHT; y++) {
+      memset32(Present_BackBuffer(0, y), rgb(0, y / 4, 64 + y / 4), WIDTH);
+   }
+   Present_DamageAll();
+
+   fillRect(0, 0, WIDTH, 28, rgb(40, 40, 48));
+   fillRect(40, 60, 320, 240, rgb(220, 220, 220));
+   fillRect(40, 60, 320, 20, rgb(0, 0, 128));
+   fillRect(280, 200, 300, 200, rgb(200, 200, 208));
+   fillRect(280, 200, 300, 20, rgb(96, 96, 160));
+
+   Present_Flush();
+}
+
+/*
+ * Each benchmark's argument selects streaming stores (TRUE) or
+ * ordinary stores (FALSE).
+ */
+
+static fastcall void
+benchStatic(uint32 iterations, void *arg)
+{
+   static uint32 frame;
+
+   gPresent.streaming = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      int cx = 100 + (frame % 400);
+      int cy = 120 + (frame % 200);
+
+      /*
+       * Repaint the clock, and move the pointer one pixel. The
+       * pointer's old position is damaged by the window we erase it
+       * with.
+       */
+      fillRect(CLOCK_X, CLOCK_Y, CLOCK_W, CLOCK_H, rgb(frame, 255 - frame, 0));
+      fillRect(cx - 1, cy - 1, CURSOR_W + 1, CURSOR_H + 1, rgb(220, 220, 220));
+      fillRect(cx, cy, CURSOR_W, CURSOR_H, rgb(0, 0, 0));
+
+      Present_Flush();
+      frame++;
+   }
+}
+
+static fastcall void
+benchFullScreen(uint32 iterations, void *arg)
+{
+   gPresent.streaming = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      Present_DamageAll();
+      Present_Flush();
+   }
+}
+
+static Bench benchmarks[] = {
+   { "Present, mostly static, streaming stores", benchStatic, (void*) TRUE },
+   { "Present, mostly static, ordinary stores", benchStatic, (void*) FALSE },
+   { "Present, full screen, streaming stores", benchFullScreen, (void*) TRUE },
+   { "Present, full screen, ordinary stores", benchFullScreen, (void*) FALSE },
+};
+
+int
+main(void)
+{
+   Bool haveSSE2;
+   int i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, SERIAL_MAX_BAUD);
+
+   Clock_Init();
+   Bench_Init();
+
+   VBE_InitSimple(WIDTH, HEIGHT, 32);
+   if (!Present_Init(backBuffer, WIDTH * sizeof(uint32))) {
+      Console_Panic("No linear framebuffer in this video mode.");
+   }
+
+   haveSSE2 = gPresent.streaming;
+   Console_Format("SSE2 streaming stores %s\n\n",
+                  haveSSE2 ? "available" : "not available");
+
+   drawDesktop();
+
+   for (i = 0; i < arraysize(benchmarks); i++) {
+      Bench *bench = &benchmarks[i];
+
+      if (bench->arg && !haveSSE2) {
+         continue;
+      }
+
+      Bench_Run(bench);
+      Bench_Report(bench);
+
+      Console_Format("   %u frames/s\n",
+                     (uint32)(100ULL * NSEC_PER_SEC / MAX(bench->medianCentinanos, 1)));
+   }
+
+   gPresent.streaming = haveSSE2;
+   return 0;
+}
@@ -0,0 +1,163 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Measure the cost of the low-level primitives that Metalkit apps
+ * rely on, so we can track them across releases and between
+ * emulators and real hardware.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "intr.h"
+#include "io.h"
+#include "clock.h"
+#include "bench.h"
+#include "bios.h"
+#include "pci.h"
+
+#define NOP_VECTOR      USER_VECTOR(0)
+#define MAX_COPY_SIZE   (256 * 1024)
+
+static uint32 copySrc[MAX_COPY_SIZE / 4];
+static uint32 copyDest[MAX_COPY_SIZE / 4];
+
+static void
+nopHandler(int vector)
+{
+}
+
+static fastcall void
+benchSoftInterrupt(uint32 iterations, void *arg)
+{
+   while (iterations--) {
+      asm volatile ("int %0" :: "i" (NOP_VECTOR) : "memory");
+   }
+}
+
+static fastcall void
+benchContextSwitch(uint32 iterations, void *arg)
+{
+   volatile uint32 remaining = iterations;
+   IntrContext ctx;
+
+   /*
+    * Like a setjmp/longjmp round trip: save a context, then restore
+    * it, which returns from Intr_SaveContext a second time.
+    */
+   while (remaining) {
+      ctx.eax = 0;
+      if (Intr_SaveContext(&ctx) == 0) {
+         ctx.eax = 1;
+         Intr_RestoreContext(&ctx);
+      }
+      remaining--;
+   }
+}
+
+static fastcall void
+benchBIOSCall(uint32 iterations, void *arg)
+{
+   while (iterations--) {
+      Regs reg = {};
+      reg.ax = 0x0F00;   // Get current video mode
+      BIOS_Call(0x10, &reg);
+   }
+}
+
+static fastcall void
+benchPCIConfigRead(uint32 iterations, void *arg)
+{
+   const PCIAddress addr = {};
+
+   while (iterations--) {
+      Bench_Escape(PCI_ConfigRead32(&addr, 0));
+   }
+}
+
+static fastcall void
+benchPortRead(uint32 iterations, void *arg)
+{
+   while (iterations--) {
+      Bench_Escape(IO_In8(PIC1_DATA_PORT));
+   }
+}
+
+static fastcall void
+benchConsoleWriteChar(uint32 iterations, void *arg)
+{
+   while (iterations--) {
+      Console_WriteChar('.');
+   }
+}
+
+static fastcall void
+benchConsoleFormat(uint32 iterations, void *arg)
+{
+   while (iterations--) {
+      Console_Format("%08x", iterations);
+   }
+}
+
+static fastcall void
+benchMemcpy(uint32 iterations, void *arg)
+{
+   uint32 size = (uint32) arg;
+
+   while (iterations--) {
+      memcpy(copyDest, copySrc, size);
+   }
+}
+
+static fastcall void
+benchMemcpy32(uint32 iterations, void *arg)
+{
+   uint32 words = (uint32) arg / 4;
+
+   while (iterations--) {
+      memcpy32(copyDest, copySrc, words);
+   }
+}
+
+static Bench benchmarks[] = {
+   { "Software interrupt round-trip", benchSoftInterrupt },
+   { "Intr_SaveContext + Intr_RestoreContext", benchContextSwitch },
+   { "BIOS_Call (INT 10h, AH=0Fh)", benchBIOSCall },
+   { "PCI_ConfigRead32", benchPCIConfigRead },
+   { "IO_In8 (PIC data port)", benchPortRead },
+   { "Console_WriteChar", benchConsoleWriteChar },
+   { "Console_Format(\"%08x\")", benchConsoleFormat },
+   { "memcpy 64 bytes", benchMemcpy, (void*) 64 },
+   { "memcpy32 64 bytes", benchMemcpy32, (void*) 64 },
+   { "memcpy 4 KB", benchMemcpy, (void*) 4096 },
+   { "memcpy32 4 KB", benchMemcpy32, (void*) 4096 },
+   { "memcpy 256 KB", benchMemcpy, (void*) MAX_COPY_SIZE },
+   { "memcpy32 256 KB", benchMemcpy32, (void*) MAX_COPY_SIZE },
+};
+
+int
+main(void)
+{
+   int i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+   Intr_SetHandler(NOP_VECTOR, nopHandler);
+
+   Console_WriteString("Calibrating...\n");
+   Console_Flush();
+
+   Clock_Init();
+   Bench_Init();
+
+   for (i = 0; i < arraysize(benchmarks); i++) {
+      Bench_Register(&benchmarks[i]);
+   }
+
+   Console_WriteString("Running benchmarks...\n");
+   Console_Flush();
+
+   Bench_RunAll();
+
+   return 0;
+}
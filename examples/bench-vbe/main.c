@@ -0,0 +1,140 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Compare the cost of frequent VBE calls through BIOS_Call, which
+ * drops to real mode, with the VBE 2.0 protected-mode interface,
+ * when the video BIOS has one, and with writing the VGA DAC ports
+ * directly for palette updates. Results are shown on the framebuffer
+ * console, in calls per second.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_fb.h"
+#include "intr.h"
+#include "clock.h"
+#include "bench.h"
+#include "vbe.h"
+#include "palette.h"
+
+static uint32 palette[256];
+static uint32 palette8[256];
+
+/*
+ * Each benchmark's argument selects the protected-mode interface
+ * (TRUE) or BIOS_Call (FALSE).
+ */
+
+static fastcall void
+benchSetStartAddress(uint32 iterations, void *arg)
+{
+   gVBE.pm.enabled = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      VBE_SetStartAddress(0, 0);
+   }
+}
+
+static fastcall void
+benchSetPalette(uint32 iterations, void *arg)
+{
+   gVBE.pm.enabled = (Bool)(uint32) arg;
+
+   while (iterations--) {
+      VBE_SetPalette(0, arraysize(palette), palette);
+   }
+}
+
+static fastcall void
+benchPaletteSet(uint32 iterations, void *arg)
+{
+   while (iterations--) {
+      Palette_Set(0, arraysize(palette8), palette8);
+   }
+}
+
+static Bench paletteBenchmark = {
+   "Palette_Set 256, VGA DAC ports", benchPaletteSet
+};
+
+static Bench benchmarks[] = {
+   { "VBE_SetStartAddress, BIOS_Call", benchSetStartAddress, (void*) FALSE },
+   { "VBE_SetStartAddress, protected mode", benchSetStartAddress, (void*) TRUE },
+   { "VBE_SetPalette 256, BIOS_Call", benchSetPalette, (void*) FALSE },
+   { "VBE_SetPalette 256, protected mode", benchSetPalette, (void*) TRUE },
+};
+
+int
+main(void)
+{
+   Bool havePM;
+   int i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   Clock_Init();
+   Bench_Init();
+
+   VBE_InitSimple(640, 480, 8);
+   if (!ConsoleFB_Init(0)) {
+      Console_Panic("Can't draw text in this video mode.");
+   }
+
+   /*
+    * A gray ramp, except for the console's colors, so the palette
+    * benchmark doesn't make the console unreadable. Entries are
+    * BGRX, 6 bits per component.
+    */
+   for (i = 0; i < arraysize(palette); i++) {
+      uint32 level = i >> 2;
+      palette[i] = (level << 16) | (level << 8) | level;
+   }
+   palette[VGA_COLOR_BLUE] = 0x00002A;
+   palette[VGA_COLOR_RED] = 0x2A0000;
+   palette[VGA_COLOR_WHITE] = 0x3F3F3F;
+   for (i = 0; i < arraysize(palette); i++) {
+      palette8[i] = palette[i] << 2;
+   }
+
+   havePM = gVBE.pm.enabled;
+   Console_Format("VBE %d.%d, protected-mode interface %s\n\n",
+                  gVBE.cInfo.verMajor, gVBE.cInfo.verMinor,
+                  havePM ? "found" : "not available");
+   Console_Flush();
+
+   for (i = 0; i < arraysize(benchmarks); i++) {
+      Bench *bench = &benchmarks[i];
+
+      if (bench->arg && !havePM) {
+         continue;
+      }
+
+      Bench_Run(bench);
+      Bench_Report(bench);
+
+      Console_Format("   %u calls/s\n",
+                     (uint32)(100ULL * NSEC_PER_SEC / MAX(bench->medianCentinanos, 1)));
+      Console_Flush();
+   }
+
+   gVBE.pm.enabled = havePM;
+
+   /*
+    * This may switch the DAC to 8 bits, so it goes last.
+    */
+   Palette_Init();
+   if (gPalette.direct) {
+      Bench_Run(&paletteBenchmark);
+      Bench_Report(&paletteBenchmark);
+
+      Console_Format("   %u calls/s, %d-bit DAC\n",
+                     (uint32)(100ULL * NSEC_PER_SEC /
+                              MAX(paletteBenchmark.medianCentinanos, 1)),
+                     gPalette.dacBits);
+      Console_Flush();
+   }
+
+   return 0;
+}
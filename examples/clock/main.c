@@ -0,0 +1,39 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+#include "types.h"
+#include "console_vga.h"
+#include "clock.h"
+#include "intr.h"
+
+int
+main(void)
+{
+   uint32 seconds = 0;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   Clock_Init();
+
+   Console_Format("TSC frequency: %d kHz\n"
+                  "Invariant TSC: %s\n"
+                  "ns multiplier: %08x >> %d\n",
+                  (uint32)(gClock.tscHz / 1000),
+                  gClock.invariantTSC ? "yes" : "no",
+                  gClock.nsMult, gClock.nsShift);
+
+   while (1) {
+      uint64 start = Clock_Nanos();
+      Clock_Delay(NSEC_PER_SEC);
+      uint32 elapsed = (Clock_Nanos() - start) / 1000;
+
+      seconds++;
+      Console_MoveTo(0, 4);
+      Console_Format("Uptime: %d s    Clock_Delay(1 s) took %d us ",
+                     seconds, elapsed);
+      Console_Flush();
+   }
+
+   return 0;
+}
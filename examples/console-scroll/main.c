@@ -0,0 +1,41 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Console scrolling throughput test: print 100k lines as fast as
+ * possible, and report how long it took.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "intr.h"
+#include "clock.h"
+
+#define NUM_LINES  100000
+
+int
+main(void)
+{
+   uint64 start, elapsed;
+   uint32 i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+   Clock_Init();
+
+   start = Clock_Nanos();
+
+   for (i = 0; i < NUM_LINES; i++) {
+      Console_Format("Line %d of %d: the quick brown fox jumps over the lazy dog\n",
+                     i, NUM_LINES);
+      Console_Flush();
+   }
+
+   elapsed = Clock_Nanos() - start;
+
+   Console_Format("\n%d lines in %d ms, %d ns/line\n", NUM_LINES,
+                  (uint32)(elapsed / 1000000), (uint32)(elapsed / NUM_LINES));
+   Console_Flush();
+
+   return 0;
+}
@@ -0,0 +1,65 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+#include "types.h"
+#include "console_vga.h"
+#include "intr.h"
+#include "timer.h"
+#include "clock.h"
+#include "hpet.h"
+
+volatile uint32 count = 0;
+
+void
+hpetHandler(int vector)
+{
+   count++;
+}
+
+int
+main(void)
+{
+   static ClockSource *const sources[] = {
+      &gClockSourceTSC,
+      &gClockSourceHPET,
+      &gClockSourcePIT,
+   };
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   Clock_Init();
+   Timer_InitPITClockSource();
+
+   if (!HPET_Init()) {
+      Console_Panic("No HPET found. (Try QEMU's \"-machine q35\")");
+   }
+
+   Console_Format("HPET at %08x, period %d fs, %d timers, legacy routing: %s\n",
+                  gHPET.regs, gHPET.periodFs, gHPET.numTimers,
+                  gHPET.legacyRoute ? "yes" : "no");
+
+   /*
+    * With legacy routing enabled, HPET timer 0 takes over IRQ 0.
+    */
+   HPET_SetPeriodic(0, NSEC_PER_SEC / 100);
+   Intr_SetMask(HPET_TIMER0_IRQ, TRUE);
+   Intr_SetHandler(IRQ_VECTOR(HPET_TIMER0_IRQ), hpetHandler);
+
+   while (1) {
+      int i;
+
+      Console_MoveTo(0, 2);
+      for (i = 0; i < arraysize(sources); i++) {
+         const ClockSource *cs = sources[i];
+
+         Console_Format("%4s: %10d kHz  %10d us\n",
+                        cs->name, (uint32)(cs->hz / 1000),
+                        (uint32)(ClockSource_Nanos(cs) / 1000));
+      }
+      Console_Format("\nHPET timer 0 interrupts (100 Hz): %d", count);
+      Console_Flush();
+   }
+
+   return 0;
+}
@@ -0,0 +1,75 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Function instrumentation example. Everything in this image is
+ * compiled with -finstrument-functions. Run a workload made of many
+ * short calls, which a sampling profiler would mostly miss, then
+ * report per-function call counts and cycles on screen and dump them
+ * to the serial port.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "clock.h"
+#include "instrument.h"
+
+#define NUM_ITERATIONS  100000
+
+static volatile uint32 sink;
+
+static __attribute__((noinline)) uint32
+hash(uint32 x)
+{
+   x ^= x >> 16;
+   x *= 0x85EBCA6B;
+   x ^= x >> 13;
+   return x;
+}
+
+static __attribute__((noinline)) void
+hashPair(uint32 a, uint32 b)
+{
+   sink += hash(a) ^ hash(b);
+}
+
+static __attribute__((noinline)) void
+hashMany(uint32 n)
+{
+   while (n--) {
+      sink += hash(n);
+   }
+}
+
+int
+main(void)
+{
+   uint32 i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, SERIAL_MAX_BAUD);
+   gConsole = gConsoleVGAInterface;
+
+   Clock_Init();
+   Instrument_Init();
+
+   for (i = 0; i < NUM_ITERATIONS; i++) {
+      hashPair(i, i + 1);
+      if ((i & 63) == 0) {
+         hashMany(16);
+      }
+   }
+
+   Instrument_Report(16);
+   Console_Flush();
+
+   Instrument_Dump(&gConsoleSerialInterface);
+   Console_WriteString("Totals written to COM1.\n");
+   Console_Flush();
+
+   return 0;
+}
@@ -0,0 +1,59 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Port I/O accounting example. We do a bit of everything that
+ * touches ports: console output, a PCI bus scan, IRQ mask changes,
+ * and keyboard setup. Then we report which ports and call sites
+ * cost the most.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "keyboard.h"
+#include "timer.h"
+#include "pci.h"
+#include "ioacct.h"
+
+int
+main(void)
+{
+   PCIScanState busScan = {};
+   uint32 functions = 0;
+   int i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   /*
+    * The serial console is only for the dump. Keep VGA as the
+    * main console.
+    */
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, SERIAL_MAX_BAUD);
+   gConsole = gConsoleVGAInterface;
+
+   Keyboard_Init();
+
+   while (PCI_ScanBus(&busScan)) {
+      functions++;
+   }
+
+   for (i = 0; i < 100; i++) {
+      Intr_SetMask(PIT_IRQ, i & 1);
+      Console_Format("Line %d of some console output\n", i);
+      Console_Flush();
+   }
+
+   Console_Clear();
+   Console_Format("%d PCI functions found\n\n", functions);
+   IOAcct_Report(8);
+   Console_Flush();
+
+   IOAcct_Dump(&gConsoleSerialInterface);
+   Console_WriteString("\nFull report written to COM1.\n");
+   Console_Flush();
+
+   return 0;
+}
@@ -0,0 +1,84 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+#include "types.h"
+#include "console_vga.h"
+#include "intr.h"
+#include "clock.h"
+#include "lapic.h"
+
+#define PERIODIC_VECTOR   USER_VECTOR(0)
+#define DEADLINE_VECTOR   USER_VECTOR(1)
+
+volatile uint32 periodicCount = 0;
+volatile uint32 deadlineCount = 0;
+volatile uint64 nextDeadline;
+volatile int64 maxLateness;
+
+void
+periodicHandler(int vector)
+{
+   periodicCount++;
+   LAPIC_EOI();
+}
+
+/*
+ * Re-arm a deadline every 10ms, exactly on the TSC grid,
+ * and keep track of how late the interrupt arrives.
+ */
+void
+deadlineHandler(int vector)
+{
+   int64 late = Clock_Cycles() - nextDeadline;
+
+   maxLateness = MAX(maxLateness, late);
+   deadlineCount++;
+
+   nextDeadline += Clock_NanosToCycles(NSEC_PER_SEC / 100);
+   LAPIC_TimerDeadline(DEADLINE_VECTOR, nextDeadline);
+   LAPIC_EOI();
+}
+
+int
+main(void)
+{
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   Clock_Init();
+   if (!LAPIC_Init()) {
+      Console_Panic("This CPU has no local APIC.");
+   }
+
+   Console_Format("LAPIC ID %d, timer %d kHz, TSC-deadline mode: %s\n",
+                  LAPIC_GetID(), (uint32)(gLAPIC.timerHz / 1000),
+                  gLAPIC.tscDeadline ? "yes" : "no");
+
+   /*
+    * Run a 1 kHz periodic timer for one second, then switch
+    * this CPU's timer over to a chain of 100 Hz deadlines.
+    */
+
+   Intr_SetHandler(PERIODIC_VECTOR, periodicHandler);
+   Intr_SetHandler(DEADLINE_VECTOR, deadlineHandler);
+
+   LAPIC_TimerPeriodic(PERIODIC_VECTOR, NSEC_PER_SEC / 1000);
+   Clock_Delay(NSEC_PER_SEC);
+   LAPIC_TimerStop();
+
+   Console_Format("Periodic: %d interrupts in 1 second (expected 1000)\n",
+                  periodicCount);
+
+   nextDeadline = Clock_Cycles() + Clock_NanosToCycles(NSEC_PER_SEC / 100);
+   LAPIC_TimerDeadline(DEADLINE_VECTOR, nextDeadline);
+
+   while (1) {
+      Console_MoveTo(0, 3);
+      Console_Format("Deadlines: %d   worst lateness: %d cycles ",
+                     deadlineCount, (int32)maxLateness);
+      Console_Flush();
+      Intr_Halt();
+   }
+
+   return 0;
+}
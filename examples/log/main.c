@@ -0,0 +1,78 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Log ring example: the timer IRQ and the main loop both log, and
+ * the local APIC timer drains the ring to both VGA and COM1 in the
+ * background. Without a local APIC, the main loop drains it
+ * whenever it has nothing better to do.
+ *
+ * Every 100 ticks the main loop logs a burst while the timer keeps
+ * interrupting it, to show that messages from both sides interleave
+ * without anybody waiting.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "timer.h"
+#include "clock.h"
+#include "lapic.h"
+#include "log.h"
+
+#define DRAIN_VECTOR  USER_VECTOR(0)
+
+volatile uint32 ticks;
+
+static void
+timerHandler(int vector)
+{
+   ticks++;
+   if (ticks % 25 == 0) {
+      Log_Format("IRQ: tick %d", ticks);
+   }
+}
+
+int
+main(void)
+{
+   uint32 lastBurst = 0;
+   Bool background;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, SERIAL_MAX_BAUD);
+
+   Clock_Init();
+   Log_Init();
+   Log_Format("Log ring: %d bytes", LOG_RING_SIZE);
+
+   background = LAPIC_Init();
+   if (background) {
+      Log_StartDrain(DRAIN_VECTOR, NSEC_PER_SEC / 50);
+   }
+
+   Timer_InitPIT(PIT_HZ / 100);
+   Intr_SetMask(PIT_IRQ, TRUE);
+   Intr_SetHandler(IRQ_VECTOR(PIT_IRQ), timerHandler);
+
+   while (1) {
+      if (ticks - lastBurst >= 100) {
+         uint32 i;
+
+         lastBurst = ticks;
+         for (i = 0; i < 8; i++) {
+            Log_Format("main: burst %d message %d, %llu cycles", lastBurst / 100, i,
+                       Clock_Cycles() - gClock.tscBase);
+         }
+      }
+
+      if (!background) {
+         Log_Drain();
+      }
+      Intr_Halt();
+   }
+
+   return 0;
+}
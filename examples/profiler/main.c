@@ -0,0 +1,87 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Sampling profiler example. Profile a few seconds of a synthetic
+ * workload, where each function should take roughly twice as long
+ * as the one before it. Then show the hottest addresses on screen,
+ * and dump every sample to the serial port.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "clock.h"
+#include "profiler.h"
+
+#define PROFILE_SECONDS  5
+
+static volatile uint32 sink;
+
+static __attribute__((noinline)) void
+spin(uint32 iterations)
+{
+   while (iterations--) {
+      sink = sink * 1103515245 + 12345;
+   }
+}
+
+static __attribute__((noinline)) void
+light(void)
+{
+   spin(1000);
+}
+
+static __attribute__((noinline)) void
+medium(void)
+{
+   spin(2000);
+}
+
+static __attribute__((noinline)) void
+heavy(void)
+{
+   spin(4000);
+   light();
+}
+
+int
+main(void)
+{
+   uint64 end;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   /*
+    * The serial console is only for the dump. Keep VGA as the
+    * main console.
+    */
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, SERIAL_MAX_BAUD);
+   gConsole = gConsoleVGAInterface;
+
+   Clock_Init();
+   Profiler_Init(PROFILER_STACKS);
+
+   Console_Format("Profiling for %d seconds...\n", PROFILE_SECONDS);
+   Console_Flush();
+
+   Profiler_Start();
+   end = Clock_Nanos() + PROFILE_SECONDS * NSEC_PER_SEC;
+   while (Clock_Nanos() < end) {
+      light();
+      medium();
+      heavy();
+   }
+   Profiler_Stop();
+
+   Profiler_Report(16);
+   Console_Flush();
+
+   Profiler_Dump(&gConsoleSerialInterface);
+   Console_WriteString("Samples written to COM1.\n");
+   Console_Flush();
+
+   return 0;
+}
@@ -0,0 +1,36 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+#include "types.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "clock.h"
+
+int
+main(void)
+{
+   uint32 line = 0;
+   uint32 cycles = 0;
+
+   Intr_Init();
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, 115200);
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+   Clock_Init();
+
+   /*
+    * Each line is queued in the transmit ring, so writing it costs
+    * far less than the ~5ms it takes to go out at 115200 baud. Once
+    * the ring fills, we end up waiting at the UART's pace anyway.
+    */
+
+   while (1) {
+      uint64 start = Clock_Cycles();
+
+      Console_Format("Line %d, previous line took %d cycles to queue\n",
+                     line++, cycles);
+      Console_Flush();
+
+      cycles = Clock_Cycles() - start;
+   }
+
+   return 0;
+}
@@ -0,0 +1,89 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Statistics dashboard example. Once a second the main loop scans
+ * the PCI bus and makes a BIOS call, to give the library's stats
+ * something to count, and logs a line to the console.
+ *
+ * F12 flips to the dashboard and back; the console keeps scrolling
+ * underneath. F11 dumps every stat to COM1.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "timer.h"
+#include "keyboard.h"
+#include "bios.h"
+#include "pci.h"
+#include "stats.h"
+#include "stats_dashboard.h"
+
+#define TIMER_HZ  100
+
+STAT_GAUGE(gSecondsStat, "example.seconds");
+STAT_HISTOGRAM(gScanStat, "example.pci_functions");
+
+volatile uint32 ticks;
+
+static void
+timerHandler(int vector)
+{
+   ticks++;
+   if (ticks % (TIMER_HZ / STATS_DASHBOARD_REFRESH_HZ) == 0) {
+      StatsDashboard_Refresh();
+   }
+}
+
+int
+main(void)
+{
+   uint32 seconds = 0;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   /*
+    * The serial console is only for dumps. Keep VGA as the main
+    * console.
+    */
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, SERIAL_MAX_BAUD);
+   gConsole = gConsoleVGAInterface;
+
+   Keyboard_Init();
+   StatsDashboard_Init(KEY_F12, KEY_F11, &gConsoleSerialInterface);
+
+   Timer_InitPIT(PIT_HZ / TIMER_HZ);
+   Intr_SetMask(PIT_IRQ, TRUE);
+   Intr_SetHandler(IRQ_VECTOR(PIT_IRQ), timerHandler);
+
+   Console_WriteString("F12: toggle stats dashboard.  F11: dump stats to COM1.\n\n");
+   Console_Flush();
+
+   while (1) {
+      PCIScanState busScan = {};
+      uint32 functions = 0;
+      Regs reg = {};
+
+      while (ticks < (seconds + 1) * TIMER_HZ) {
+         Intr_Halt();
+      }
+      seconds++;
+      Stat_Set(&gSecondsStat, seconds);
+
+      while (PCI_ScanBus(&busScan)) {
+         functions++;
+      }
+      Stat_Sample(&gScanStat, functions);
+
+      BIOS_Call(0x12, &reg);
+
+      Console_Format("%d s: %d PCI functions, %d KB base memory\n",
+                     seconds, functions, reg.ax);
+      Console_Flush();
+   }
+
+   return 0;
+}
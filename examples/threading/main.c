@@ -18,6 +18,7 @@
 #include "console_vga.h"
 #include "timer.h"
 #include "intr.h"
+#include "trace.h"
 
 #define STACK_SIZE 1024
 
@@ -84,8 +85,21 @@ schedulerIRQ(int vector)
     * Switch tasks
     */
 
+   Trace_Instant("sched_switch", "prev,next", prevTask, nextTask, 0);
+
    memcpy(&prevTask->context, context, sizeof *context);
    memcpy(context, &nextTask->context, sizeof *context);
+
+#ifdef TRACE
+   /*
+    * When built with TRACE=1, dump the first two seconds of
+    * scheduling activity to the debug port.
+    */
+   static uint32 ticks;
+   if (++ticks == 200) {
+      Trace_Dump();
+   }
+#endif
 }
 
 void
@@ -0,0 +1,70 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Event tracing example. A 1 kHz timer, the keyboard, and a loop of
+ * BIOS calls all generate trace events. Press any key to dump the
+ * trace buffer to the debug port.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "intr.h"
+#include "timer.h"
+#include "bios.h"
+#include "keyboard.h"
+#include "clock.h"
+#include "trace.h"
+
+volatile Bool dumpRequested;
+
+static void
+timerHandler(int vector)
+{
+   /* Nothing to do; the trace module records the IRQ itself. */
+}
+
+static fastcall void
+keyHandler(KeyEvent *event)
+{
+   if (event->pressed) {
+      dumpRequested = TRUE;
+   }
+}
+
+int
+main(void)
+{
+   uint32 dumps = 0;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   Clock_Init();
+   Keyboard_Init();
+   Keyboard_SetHandler(keyHandler);
+
+   Timer_InitPIT(PIT_HZ / 1000);
+   Intr_SetMask(PIT_IRQ, TRUE);
+   Intr_SetHandler(IRQ_VECTOR(PIT_IRQ), timerHandler);
+
+   Console_WriteString("Tracing. Press any key to dump the trace to the debug port.\n");
+   Console_Flush();
+
+   while (1) {
+      Regs reg = {};
+      reg.ax = 0x0F00;   // Get current video mode
+      BIOS_Call(0x10, &reg);
+
+      if (dumpRequested) {
+         dumpRequested = FALSE;
+         Trace_Dump();
+         Console_Format("Dump %d written\n", ++dumps);
+         Console_Flush();
+      }
+
+      Intr_Halt();
+   }
+
+   return 0;
+}
@@ -0,0 +1,45 @@
+/* -*- Mode: C; c-basic-offset: 3 -*- */
+
+/*
+ * Framebuffer console example. We switch to a VBE graphics mode,
+ * then keep using the console as if nothing happened: a few hundred
+ * lines of colorful scrolling text, panning through video memory,
+ * and finally a panic to show that it's still readable.
+ */
+
+#include "types.h"
+#include "console_vga.h"
+#include "console_fb.h"
+#include "intr.h"
+#include "vbe.h"
+
+#define NUM_LINES  500
+
+int
+main(void)
+{
+   int i;
+
+   ConsoleVGA_Init();
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+
+   VBE_InitSimple(800, 600, 32);
+   if (!ConsoleFB_Init(CONSOLE_FB_PAN)) {
+      Console_Panic("Can't draw text in this video mode.");
+   }
+
+   for (i = 0; i < NUM_LINES; i++) {
+      ConsoleFB_SetColor(VGA_COLOR_LIGHT_GRAY);
+      Console_Format("Line %3d:", i);
+      ConsoleFB_SetColor(1 + i % 15);
+      Console_Format(" The quick brown fox jumps over the lazy dog.\n");
+      Console_Flush();
+   }
+
+   Console_Panic("Panic after %d lines, in %dx%dx%d.", NUM_LINES,
+                 gVBE.current.info.width, gVBE.current.info.height,
+                 gVBE.current.info.bitsPerPixel);
+
+   return 0;
+}
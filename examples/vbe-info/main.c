@@ -40,13 +40,11 @@ main(void)
                   gVBE.numModes);
 
    for (i = 0; i < gVBE.numModes; i++) {
-      uint16 mode = gVBE.modes[i];
-      VBEModeInfo info;
-
-      VBE_GetModeInfo(mode, &info);
+      const VBEModeSummary *mode = &gVBE.modes[i];
 
       Console_Format("Mode 0x%x: %dx%d \tbpp=%d \tattr=%016b\n",
-                     mode, info.width, info.height, info.bitsPerPixel, info.attributes);
+                     mode->mode, mode->width, mode->height,
+                     mode->bitsPerPixel, mode->attributes);
    }
 
    Console_Flush();
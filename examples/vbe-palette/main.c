@@ -1,9 +1,14 @@
 /* -*- Mode: C; c-basic-offset: 3 -*-
  *
  * Metalkit example: Demonstrate color palette manipulation in VBE mode.
+ *
+ * The palette is reloaded 60 times a second from a timer interrupt,
+ * so it goes straight to the VGA DAC ports when the mode allows.
  */
 
 #include "vbe.h"
+#include "gfx.h"
+#include "palette.h"
 #include "console_vga.h"
 #include "timer.h"
 #include "intr.h"
@@ -38,14 +43,14 @@ timerISR(int vector)
       const int y = (i >> 4) - 3;
       const float t = (x*x + y*y) * 0.05 + tick * 0.02;
 
-      const uint8 r = sinf(t + rPhase) * 0x0f + 0x10;
-      const uint8 g = sinf(t + gPhase) * 0x0f + 0x10;
-      const uint8 b = sinf(t + bPhase) * 0x0f + 0x10;
+      const uint8 r = sinf(t + rPhase) * 0x3f + 0x40;
+      const uint8 g = sinf(t + gPhase) * 0x3f + 0x40;
+      const uint8 b = sinf(t + bPhase) * 0x3f + 0x40;
 
       palette[i] = (r << 16) | (g << 8) | b;
    }
 
-   VBE_SetPalette(0, 256, palette);
+   Palette_Set(0, 256, palette);
    tick++;
 }
 
@@ -59,22 +64,17 @@ timerISR(int vector)
 static inline void
 drawTestPattern(void)
 {
-   uint8 *fb = (uint8*) gVBE.current.info.linearAddress;
-   int bytesPerLine = gVBE.current.info.bytesPerLine;
+   GfxSurface screen;
    int boxWidth = gVBE.current.info.width >> 4;
    int boxHeight = gVBE.current.info.height >> 4;
-   int x, y;
-
-   for (y = 0; y < gVBE.current.info.height; y++) {
-      uint8 *line = fb;
-      fb += bytesPerLine;
+   int row, col;
 
-      for (x = 0; x < gVBE.current.info.width; x++) {
-         int row = y / boxHeight;
-         int col = x / boxWidth;
-         int color = (row << 4) | col;
+   Gfx_InitVBESurface(&screen, NULL);
 
-         *(line++) = color;
+   for (row = 0; row < 16; row++) {
+      for (col = 0; col < 16; col++) {
+         Gfx_FillRect(&screen, col * boxWidth, row * boxHeight,
+                      boxWidth, boxHeight, (row << 4) | col);
       }
    }
 }
@@ -88,6 +88,7 @@ main(void)
    Intr_SetFaultHandlers(Console_UnhandledFault);
 
    VBE_InitSimple(640, 480, 8);
+   Palette_Init();
    drawTestPattern();
 
    /*
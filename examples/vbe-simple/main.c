@@ -1,16 +1,35 @@
 /* -*- Mode: C; c-basic-offset: 3 -*-
  *
  * Metalkit example: A simple particle system demo, to show off VBE graphics.
+ *
+ * Frames are drawn straight into a hidden page of video memory and
+ * shown with VBE_Flip(), triple-buffered when there's room. A frame
+ * pacer holds the demo to 60 frames per second, flipping during
+ * vertical retrace and sleeping the rest of the time. Once a second,
+ * frame time statistics go to COM1; run QEMU with "-serial stdio"
+ * to see them.
+ *
+ * On Bochs, QEMU and VirtualBox the mode is set through the Bochs
+ * Graphics Adapter's own registers, with room for three pages,
+ * instead of through the VBE BIOS.
  */
 
 #include "vbe.h"
+#include "bga.h"
+#include "gfx.h"
 #include "console_vga.h"
+#include "console_serial.h"
+#include "intr.h"
+#include "clock.h"
+#include "lapic.h"
+#include "display.h"
 #include "math.h"
 
 #define NUM_PARTICLES 32768
 #define WIDTH         800
 #define HEIGHT        600
 #define MAX_AGE       3.0
+#define FRAME_HZ      60
 
 typedef struct {
    float x, y;
@@ -19,13 +38,7 @@ typedef struct {
 } Particle;
 
 Particle particles[NUM_PARTICLES];
-uint32 backBuffer[WIDTH * HEIGHT];
-
-static inline uint32
-rgb(uint8 r, uint8 g, uint8 b)
-{
-   return (r << 16) | (g << 8) | b;
-}
+VBESurface surface;
 
 fastcall static float
 prng(void)
@@ -55,16 +68,18 @@ init_particle(Particle *p)
 static inline void
 draw_and_update_particles(float dt)
 {
+   GfxSurface back;
    int i;
 
+   Gfx_InitVBESurface(&back, VBE_SurfaceBackBuffer(&surface));
+
    for (i = 0; i < NUM_PARTICLES; i++) {
       Particle *p = &particles[i];
       int ix = (p->x * 0.5 + 0.5) * WIDTH;
       int iy = (p->y * 0.5 + 0.5) * HEIGHT;
-      if (ix >= 0 && iy >= 0 && ix < WIDTH && iy < HEIGHT) {
-	 uint8 l = 0xFF - (p->age * (0xFF / MAX_AGE));
-	 backBuffer[ix + iy * WIDTH] = rgb(l,l,l);
-      }
+      uint8 l = 0xFF - (p->age * (0xFF / MAX_AGE));
+
+      Gfx_PutPixel(&back, ix, iy, VBE_MapRGB(l, l, l));
       p->x += p->vx * dt;
       p->y += p->vy * dt;
       p->age += dt;
@@ -75,27 +90,58 @@ draw_and_update_particles(float dt)
 }
 
 static inline void
-flip(void)
+clear(void)
 {
-   memcpy32(gVBE.current.info.linearAddress, backBuffer, sizeof backBuffer / 4);
-   memset32(backBuffer, 0, sizeof backBuffer / 4);
+   memset32(VBE_SurfaceBackBuffer(&surface), 0, surface.pageBytes / 4);
 }
 
 int
 main(void)
 {
+   DisplayPacer pacer;
+   uint64 reportStart;
    int i;
 
    ConsoleVGA_Init();
-   VBE_InitSimple(800, 600, 32);
+   Intr_Init();
+   Intr_SetFaultHandlers(Console_UnhandledFault);
+   ConsoleSerial_Init(SERIAL_COM1_IOBASE, SERIAL_COM1_IRQ, SERIAL_MAX_BAUD);
+   Clock_Init();
+   LAPIC_Init();
+
+   if (!BGA_Init() || !BGA_SetMode(WIDTH, HEIGHT, 32, 3)) {
+      VBE_InitSimple(WIDTH, HEIGHT, 32);
+   }
+   if (!VBE_InitSurface(&surface, 3) && !VBE_InitSurface(&surface, 2)) {
+      Console_Panic("Not enough video memory for two pages.");
+   }
+   Console_Format("Drawing into %d pages of video memory.\n", surface.numPages);
 
    for (i = 0; i < NUM_PARTICLES; i++) {
       particles[i].age = i * (MAX_AGE / (float)NUM_PARTICLES);
    }
 
+   Display_InitPacer(&pacer, FRAME_HZ, DISPLAY_PACER_VBLANK);
+   reportStart = Clock_Cycles();
+
    while (1) {
+      clear();
       draw_and_update_particles(0.01);
-      flip();
+
+      Display_PaceFrame(&pacer);
+      VBE_Flip(&surface, 0);
+
+      if (Clock_CyclesToNanos(Clock_Cycles() - reportStart) >= NSEC_PER_SEC) {
+         DisplayPacerStats stats;
+
+         Display_GetPacerStats(&pacer, &stats);
+         Console_Format("%u frames, frame time %u/%u/%u us (avg/p99/max), %u missed\n",
+                        stats.frames, stats.avgMicros, stats.p99Micros,
+                        stats.maxMicros, stats.missed);
+
+         Display_ResetPacerStats(&pacer);
+         reportStart = Clock_Cycles();
+      }
    }
 
    return 0;
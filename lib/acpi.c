@@ -0,0 +1,158 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * acpi.c - Minimal ACPI table discovery.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "acpi.h"
+
+/*
+ * We don't use paging, so all of these tables are reachable with
+ * their physical addresses. We only walk the 32-bit RSDT; every
+ * ACPI implementation is required to provide it, and anything in a
+ * 64-bit-only XSDT would be above 4GB where we can't reach it anyway.
+ */
+
+#define BIOS_EBDA_SEGMENT_PTR   ((uint16*) 0x40E)
+#define BIOS_ROM_START          0xE0000
+#define BIOS_ROM_END            0x100000
+
+
+/*
+ * ACPIChecksum --
+ *
+ *    All ACPI tables are valid when their bytes sum to zero.
+ */
+
+static fastcall Bool
+ACPIChecksum(const void *table, uint32 length)
+{
+   const uint8 *p = table;
+   uint8 sum = 0;
+
+   while (length--) {
+      sum += *(p++);
+   }
+   return sum == 0;
+}
+
+
+/*
+ * ACPIScanRSDP --
+ *
+ *    Look for the RSDP signature on 16-byte boundaries in one
+ *    region of low memory.
+ */
+
+static fastcall const ACPIRSDP *
+ACPIScanRSDP(uint32 start, uint32 end)
+{
+   for (; start < end; start += 16) {
+      const ACPIRSDP *rsdp = (const ACPIRSDP*) start;
+
+      if (rsdp->signature[0] == SIGNATURE_RSDP_LOW &&
+          rsdp->signature[1] == SIGNATURE_RSDP_HIGH &&
+          ACPIChecksum(rsdp, offsetof(ACPIRSDP, length))) {
+         return rsdp;
+      }
+   }
+   return NULL;
+}
+
+
+/*
+ * ACPI_FindRSDP --
+ *
+ *    Locate the Root System Description Pointer. Per the spec, it
+ *    lives either in the first kilobyte of the EBDA or in the BIOS
+ *    ROM area. Returns NULL if this isn't an ACPI system.
+ */
+
+fastcall const ACPIRSDP *
+ACPI_FindRSDP(void)
+{
+   const uint16 *ebdaSegment = BIOS_EBDA_SEGMENT_PTR;
+   const ACPIRSDP *rsdp = NULL;
+   uint32 ebda;
+
+   /*
+    * gcc treats a constant address as a zero-length object, and
+    * -Warray-bounds rejects reading it. Hide the address from it.
+    */
+   asm ("" : "+r" (ebdaSegment));
+   ebda = (uint32)*ebdaSegment << 4;
+
+   if (ebda) {
+      rsdp = ACPIScanRSDP(ebda, ebda + 1024);
+   }
+   if (!rsdp) {
+      rsdp = ACPIScanRSDP(BIOS_ROM_START, BIOS_ROM_END);
+   }
+   return rsdp;
+}
+
+
+/*
+ * ACPI_FindTable --
+ *
+ *    Find a system description table by its 4-character signature,
+ *    as constructed with ACPI_SIG(). Returns NULL if the table
+ *    can't be found or has a bad checksum.
+ */
+
+fastcall const ACPITableHeader *
+ACPI_FindTable(uint32 signature)
+{
+   const ACPIRSDP *rsdp = ACPI_FindRSDP();
+   const ACPITableHeader *rsdt;
+   const uint32 *entries;
+   uint32 i, numEntries;
+
+   if (!rsdp) {
+      return NULL;
+   }
+
+   rsdt = (const ACPITableHeader*) rsdp->rsdtAddress;
+   if (rsdt->signature != ACPI_SIG_RSDT || !ACPIChecksum(rsdt, rsdt->length)) {
+      return NULL;
+   }
+
+   entries = (const uint32*) &rsdt[1];
+   numEntries = (rsdt->length - sizeof *rsdt) / sizeof *entries;
+
+   for (i = 0; i < numEntries; i++) {
+      const ACPITableHeader *table = (const ACPITableHeader*) entries[i];
+
+      if (table->signature == signature && ACPIChecksum(table, table->length)) {
+         return table;
+      }
+   }
+
+   return NULL;
+}
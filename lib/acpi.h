@@ -0,0 +1,95 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * acpi.h - Minimal ACPI table discovery.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __ACPI_H__
+#define __ACPI_H__
+
+#include "types.h"
+
+#define SIGNATURE_RSDP_LOW    0x20445352   // "RSD "
+#define SIGNATURE_RSDP_HIGH   0x20525450   // "PTR "
+
+#define ACPI_SIG(a, b, c, d)  ((a) | ((b) << 8) | ((c) << 16) | ((d) << 24))
+#define ACPI_SIG_RSDT         ACPI_SIG('R', 'S', 'D', 'T')
+#define ACPI_SIG_HPET         ACPI_SIG('H', 'P', 'E', 'T')
+#define ACPI_SIG_APIC         ACPI_SIG('A', 'P', 'I', 'C')
+
+#define ACPI_ADDRSPACE_MEMORY 0
+#define ACPI_ADDRSPACE_IO     1
+
+typedef struct {
+   uint32    signature[2];
+   uint8     checksum;
+   char      oemId[6];
+   uint8     revision;
+   uint32    rsdtAddress;
+
+   /* ACPI 2.0+ */
+   uint32    length;
+   uint64    xsdtAddress;
+   uint8     extChecksum;
+   uint8     reserved[3];
+} PACKED ACPIRSDP;
+
+typedef struct {
+   uint32    signature;
+   uint32    length;
+   uint8     revision;
+   uint8     checksum;
+   char      oemId[6];
+   char      oemTableId[8];
+   uint32    oemRevision;
+   uint32    creatorId;
+   uint32    creatorRevision;
+} PACKED ACPITableHeader;
+
+typedef struct {
+   uint8     addressSpace;
+   uint8     bitWidth;
+   uint8     bitOffset;
+   uint8     accessSize;
+   uint64    address;
+} PACKED ACPIGenericAddress;
+
+typedef struct {
+   ACPITableHeader     header;
+   uint32              eventTimerBlockId;
+   ACPIGenericAddress  address;
+   uint8               hpetNumber;
+   uint16              minimumTick;
+   uint8               pageProtection;
+} PACKED ACPITableHPET;
+
+fastcall const ACPIRSDP *ACPI_FindRSDP(void);
+fastcall const ACPITableHeader *ACPI_FindTable(uint32 signature);
+
+#endif /* __ACPI_H__ */
@@ -0,0 +1,350 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * bench.c - Cycle-accurate microbenchmark harness.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bench.h"
+#include "clock.h"
+#include "cpu.h"
+#include "intr.h"
+#include "console.h"
+#include "debugport.h"
+
+/*
+ * Along with the human-readable report on the console, each result
+ * is written to the debug port as one tab-separated line, so results
+ * from different builds can be collected and diffed on the host:
+ *
+ *    BENCH <name> <iterations> <samples> <min> <median> <p99> <ns>
+ *
+ * All per-operation values are in hundredths of a cycle, except the
+ * last column which is the median in hundredths of a nanosecond.
+ */
+
+static struct {
+   Bench *benchmarks[BENCH_MAX_BENCHMARKS];
+   uint32 numBenchmarks;
+   uint32 overhead;
+   Bool hasLfence;
+   Bool hasRdtscp;
+   uint32 samples[BENCH_MAX_SAMPLES];
+} gBench;
+
+
+/*
+ * BenchStart --
+ * BenchStop --
+ *
+ *    Serialized TSC reads for the beginning and end of a timed
+ *    region. We want the timed code to be unable to leak outside
+ *    the region in either direction:
+ *
+ *      - lfence before RDTSC waits for earlier instructions to finish.
+ *      - lfence after RDTSC keeps later instructions from starting.
+ *      - RDTSCP waits for earlier instructions on its own.
+ *
+ *    On CPUs without SSE2 (and therefore no lfence) we fall back on
+ *    CPUID, which is fully serializing but much slower.
+ */
+
+static inline uint64
+BenchStart(void)
+{
+   uint64 tsc;
+
+   if (gBench.hasLfence) {
+      asm volatile ("lfence; rdtsc; lfence" : "=A" (tsc) :: "memory");
+   } else {
+      CPUIDRegs id;
+      CPU_GetID(0, &id);
+      tsc = CPU_ReadTSC();
+   }
+   return tsc;
+}
+
+static inline uint64
+BenchStop(void)
+{
+   uint64 tsc;
+
+   if (gBench.hasRdtscp) {
+      asm volatile ("rdtscp; lfence" : "=A" (tsc) :: "ecx", "memory");
+   } else if (gBench.hasLfence) {
+      asm volatile ("lfence; rdtsc; lfence" : "=A" (tsc) :: "memory");
+   } else {
+      CPUIDRegs id;
+      CPU_GetID(0, &id);
+      tsc = CPU_ReadTSC();
+   }
+   return tsc;
+}
+
+
+/*
+ * BenchSample --
+ *
+ *    Time one batch of 'iterations' operations, in cycles.
+ */
+
+static fastcall uint32
+BenchSample(Bench *bench, uint32 iterations)
+{
+   Bool iFlag = Intr_Save();
+   uint64 start, end;
+
+   if (!(bench->flags & BENCH_FLAG_INTERRUPTS)) {
+      Intr_Disable();
+   }
+
+   start = BenchStart();
+   bench->fn(iterations, bench->arg);
+   end = BenchStop();
+
+   Intr_Restore(iFlag);
+
+   return MIN(end - start, 0xFFFFFFFF);
+}
+
+
+/*
+ * BenchNop --
+ *
+ *    Empty benchmark, for measuring the harness's own overhead.
+ */
+
+static fastcall void
+BenchNop(uint32 iterations, void *arg)
+{
+}
+
+
+/*
+ * Bench_Init --
+ *
+ *    Detect the available serializing instructions, and measure the
+ *    fixed cost of one timed sample. Requires Clock_Init() first.
+ */
+
+fastcall void
+Bench_Init(void)
+{
+   Bench nop = { .fn = BenchNop };
+   CPUIDRegs id;
+   int i;
+
+   CPU_GetID(1, &id);
+   gBench.hasLfence = (id.edx & CPUID_1_EDX_SSE2) != 0;
+
+   CPU_GetID(0x80000000, &id);
+   if (id.eax >= 0x80000001) {
+      CPU_GetID(0x80000001, &id);
+      gBench.hasRdtscp = gBench.hasLfence && (id.edx & CPUID_80000001_EDX_RDTSCP);
+   }
+
+   gBench.overhead = 0xFFFFFFFF;
+   for (i = 0; i < BENCH_MIN_SAMPLES; i++) {
+      gBench.overhead = MIN(gBench.overhead, BenchSample(&nop, 0));
+   }
+}
+
+
+/*
+ * Bench_Register --
+ *
+ *    Add a benchmark to the list run by Bench_RunAll. The Bench
+ *    structure must stay allocated, since its results are stored
+ *    there.
+ */
+
+fastcall void
+Bench_Register(Bench *bench)
+{
+   if (gBench.numBenchmarks < BENCH_MAX_BENCHMARKS) {
+      gBench.benchmarks[gBench.numBenchmarks++] = bench;
+   }
+}
+
+
+/*
+ * BenchSort --
+ *
+ *    Sort samples in ascending order. Insertion sort is plenty
+ *    fast for a few hundred mostly-similar values.
+ */
+
+static fastcall void
+BenchSort(uint32 *samples, uint32 count)
+{
+   uint32 i, j;
+
+   for (i = 1; i < count; i++) {
+      uint32 value = samples[i];
+
+      for (j = i; j > 0 && samples[j - 1] > value; j--) {
+         samples[j] = samples[j - 1];
+      }
+      samples[j] = value;
+   }
+}
+
+
+/*
+ * BenchPerOp --
+ *
+ *    Convert a sample into hundredths of a cycle per operation.
+ */
+
+static fastcall uint32
+BenchPerOp(uint32 sample, uint32 iterations)
+{
+   uint32 cycles = sample > gBench.overhead ? sample - gBench.overhead : 0;
+   return (uint64)cycles * 100 / iterations;
+}
+
+
+/*
+ * Bench_Run --
+ *
+ *    Run one benchmark and store its results:
+ *
+ *      1. Double the iteration count until one sample takes at
+ *         least BENCH_BATCH_CYCLES.
+ *      2. Discard BENCH_WARMUP_SAMPLES samples, to warm up caches
+ *         and branch predictors.
+ *      3. Take samples until the 95% confidence interval of the mean
+ *         is within BENCH_TARGET_ERROR, or we run out of room.
+ */
+
+fastcall void
+Bench_Run(Bench *bench)
+{
+   uint32 *samples = gBench.samples;
+   uint32 iterations = 1;
+   uint32 n = 0;
+   float mean = 0, m2 = 0;
+   int i;
+
+   while (iterations < 0x40000000 &&
+          BenchSample(bench, iterations) < BENCH_BATCH_CYCLES) {
+      iterations <<= 1;
+   }
+
+   for (i = 0; i < BENCH_WARMUP_SAMPLES; i++) {
+      BenchSample(bench, iterations);
+   }
+
+   while (n < BENCH_MAX_SAMPLES) {
+      uint32 sample = BenchSample(bench, iterations);
+      float delta = sample - mean;
+
+      /* Welford's running mean and variance */
+      samples[n++] = sample;
+      mean += delta / n;
+      m2 += delta * (sample - mean);
+
+      if (n >= BENCH_MIN_SAMPLES) {
+         float halfWidth = 1.96f * __builtin_sqrtf(m2 / (n - 1) / n);
+         if (halfWidth <= mean * BENCH_TARGET_ERROR) {
+            break;
+         }
+      }
+   }
+
+   BenchSort(samples, n);
+
+   bench->iterations = iterations;
+   bench->numSamples = n;
+   bench->minCenticycles = BenchPerOp(samples[0], iterations);
+   bench->medianCenticycles = BenchPerOp(samples[n / 2], iterations);
+   bench->p99Centicycles = BenchPerOp(samples[n * 99 / 100], iterations);
+   bench->medianCentinanos = Clock_CyclesToNanos(bench->medianCenticycles);
+}
+
+
+/*
+ * Bench_Report --
+ *
+ *    Print a benchmark's results on the console, as one line of
+ *    min/median/p99 cycles and median ns per operation. Also write
+ *    them to the debug port in machine-readable form.
+ */
+
+fastcall void
+Bench_Report(const Bench *bench)
+{
+   const uint32 fields[] = {
+      bench->iterations,
+      bench->numSamples,
+      bench->minCenticycles,
+      bench->medianCenticycles,
+      bench->p99Centicycles,
+      bench->medianCentinanos,
+   };
+   int i;
+
+   Console_Format("%d.%02d/%d.%02d/%d.%02d cyc %d.%02d ns  %s\n",
+                  bench->minCenticycles / 100, bench->minCenticycles % 100,
+                  bench->medianCenticycles / 100, bench->medianCenticycles % 100,
+                  bench->p99Centicycles / 100, bench->p99Centicycles % 100,
+                  bench->medianCentinanos / 100, bench->medianCentinanos % 100,
+                  bench->name);
+   Console_Flush();
+
+   DebugPort_WriteString("BENCH\t");
+   DebugPort_WriteString(bench->name);
+   for (i = 0; i < arraysize(fields); i++) {
+      DebugPort_WriteString("\t");
+      DebugPort_WriteDec(fields[i]);
+   }
+   DebugPort_WriteString("\n");
+}
+
+
+/*
+ * Bench_RunAll --
+ *
+ *    Run every registered benchmark, in order, then report all of
+ *    the results. Nothing is printed until all benchmarks finish, so
+ *    console output never perturbs a measurement, and benchmarks of
+ *    the console itself don't garble the report.
+ */
+
+fastcall void
+Bench_RunAll(void)
+{
+   uint32 i;
+
+   for (i = 0; i < gBench.numBenchmarks; i++) {
+      Bench_Run(gBench.benchmarks[i]);
+   }
+   for (i = 0; i < gBench.numBenchmarks; i++) {
+      Bench_Report(gBench.benchmarks[i]);
+   }
+}
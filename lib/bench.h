@@ -0,0 +1,91 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * bench.h - Cycle-accurate microbenchmark harness.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "types.h"
+
+#define BENCH_MAX_BENCHMARKS   64
+#define BENCH_MAX_SAMPLES      512
+#define BENCH_MIN_SAMPLES      32
+#define BENCH_WARMUP_SAMPLES   8
+#define BENCH_BATCH_CYCLES     20000   // Minimum duration of one timed sample
+#define BENCH_TARGET_ERROR     0.01    // Stop at a 95% confidence of +/- 1%
+
+#define BENCH_FLAG_INTERRUPTS  (1 << 0)   // Leave interrupts enabled while timing
+
+/*
+ * A benchmark function performs the operation under test
+ * 'iterations' times in a row. The harness picks the iteration
+ * count, so that each timed sample is long enough to dwarf the cost
+ * of reading the TSC.
+ */
+
+typedef fastcall void (*BenchFn)(uint32 iterations, void *arg);
+
+/*
+ * Describes one benchmark, and holds its results once it has run.
+ * Per-operation results are in hundredths of a cycle, so that very
+ * cheap operations are still resolvable.
+ */
+
+typedef struct Bench {
+   const char *name;
+   BenchFn     fn;
+   void       *arg;
+   uint32      flags;
+
+   /* Results */
+   uint32      iterations;      // Operations per sample
+   uint32      numSamples;
+   uint32      minCenticycles;  // Per operation, x100
+   uint32      medianCenticycles;
+   uint32      p99Centicycles;
+   uint32      medianCentinanos;
+} Bench;
+
+/*
+ * Keep the compiler from optimizing away a value, or from assuming
+ * anything about the contents of memory.
+ */
+
+#define Bench_Escape(value)   asm volatile ("" :: "g" (value) : "memory")
+#define Bench_Clobber()       asm volatile ("" ::: "memory")
+
+fastcall void Bench_Init(void);
+fastcall void Bench_Register(Bench *bench);
+fastcall void Bench_Run(Bench *bench);
+fastcall void Bench_RunAll(void);
+fastcall void Bench_Report(const Bench *bench);
+
+#endif /* __BENCH_H__ */
@@ -0,0 +1,293 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * bga.c - Native driver for the Bochs Graphics Adapter, the
+ *         "DISPI" interface emulated by Bochs, QEMU and VirtualBox.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bga.h"
+#include "vbe.h"
+#include "display.h"
+#include "io.h"
+
+#define BGA_INDEX_PORT              0x1CE
+#define BGA_DATA_PORT               0x1CF
+
+#define BGA_INDEX_ID                0x0
+#define BGA_INDEX_XRES              0x1
+#define BGA_INDEX_YRES              0x2
+#define BGA_INDEX_BPP               0x3
+#define BGA_INDEX_ENABLE            0x4
+#define BGA_INDEX_BANK              0x5
+#define BGA_INDEX_VIRT_WIDTH        0x6
+#define BGA_INDEX_VIRT_HEIGHT       0x7
+#define BGA_INDEX_X_OFFSET          0x8
+#define BGA_INDEX_Y_OFFSET          0x9
+#define BGA_INDEX_VIDEO_MEMORY_64K  0xA   // BGA_ID_5
+
+#define BGA_ENABLED                 (1 << 0)
+#define BGA_GETCAPS                 (1 << 1)   // Read maximums from XRES, YRES, BPP
+#define BGA_8BIT_DAC                (1 << 5)
+#define BGA_LFB_ENABLED             (1 << 6)
+#define BGA_NOCLEARMEM              (1 << 7)
+
+/*
+ * If the adapter can't tell us how much memory it has, assume the
+ * smallest amount any of the emulators has shipped with.
+ */
+#define BGA_MIN_MEMORY              (4 << 20)
+
+BGAState gBGA;
+
+
+static inline void
+BGAWrite(uint16 index, uint16 value)
+{
+   IO_Out16(BGA_INDEX_PORT, index);
+   IO_Out16(BGA_DATA_PORT, value);
+}
+
+static inline uint16
+BGARead(uint16 index)
+{
+   IO_Out16(BGA_INDEX_PORT, index);
+   return IO_In16(BGA_DATA_PORT);
+}
+
+
+/*
+ * BGA_Init --
+ *
+ *    Look for a Bochs Graphics Adapter on the PCI bus, and find out
+ *    what it can do. The current video mode is left alone.
+ *
+ *    Returns TRUE and fills in gBGA if a usable adapter is present.
+ */
+
+fastcall Bool
+BGA_Init(void)
+{
+   BGAState *self = &gBGA;
+   uint16 enable;
+
+   if (!PCI_FindDevice(BGA_PCI_VENDOR, BGA_PCI_DEVICE, &self->addr) &&
+       !PCI_FindDevice(VBOX_PCI_VENDOR, VBOX_PCI_DEVICE, &self->addr)) {
+      return FALSE;
+   }
+
+   /*
+    * Writing an ID asks for that version of the interface, and
+    * reading it back tells us what we got.
+    */
+   BGAWrite(BGA_INDEX_ID, BGA_ID_5);
+   self->version = BGARead(BGA_INDEX_ID);
+   if (self->version < BGA_ID_3 || self->version > BGA_ID_5) {
+      return FALSE;
+   }
+
+   PCI_SetMemEnable(&self->addr, TRUE);
+   self->framebuffer = (uint8*) PCI_GetBARAddr(&self->addr, 0);
+
+   self->memoryBytes = 0;
+   if (self->version >= BGA_ID_5) {
+      self->memoryBytes = (uint32) BGARead(BGA_INDEX_VIDEO_MEMORY_64K) << 16;
+   }
+   if (!self->memoryBytes) {
+      self->memoryBytes = BGA_MIN_MEMORY;
+   }
+
+   /*
+    * With GETCAPS set, the mode registers read back as maximums.
+    * Setting it alongside the current bits doesn't change the mode.
+    */
+   enable = BGARead(BGA_INDEX_ENABLE);
+   BGAWrite(BGA_INDEX_ENABLE, enable | BGA_GETCAPS);
+   self->maxWidth = BGARead(BGA_INDEX_XRES);
+   self->maxHeight = BGARead(BGA_INDEX_YRES);
+   self->maxBitsPerPixel = BGARead(BGA_INDEX_BPP);
+   BGAWrite(BGA_INDEX_ENABLE, enable);
+
+   self->present = TRUE;
+   return TRUE;
+}
+
+
+/*
+ * BGASetDisplayStart --
+ *
+ *    gVBE.current.setDisplayStart hook for BGA modes. The adapter
+ *    has no way to latch a new offset at vertical blank, so to avoid
+ *    tearing we wait for retrace ourselves. If retrace can't be seen,
+ *    Display_WaitRetrace() stops polling for it after the first try.
+ */
+
+static fastcall void
+BGASetDisplayStart(int x, int y, Bool vblank)
+{
+   if (vblank) {
+      Display_WaitRetrace();
+   }
+
+   BGAWrite(BGA_INDEX_X_OFFSET, x);
+   BGAWrite(BGA_INDEX_Y_OFFSET, y);
+}
+
+
+/*
+ * BGAFillModeInfo --
+ *
+ *    Describe a BGA mode the way the VBE BIOS would have. Returns
+ *    its VBE_PIXFMT_* format.
+ */
+
+static fastcall uint32
+BGAFillModeInfo(VBEModeInfo *info, int width, int height, int bpp)
+{
+   memset(info, 0, sizeof *info);
+
+   info->attributes = VBE_MODEATTR_SUPPORTED | VBE_MODEATTR_COLOR |
+                      VBE_MODEATTR_GRAPHICS | VBE_MODEATTR_LINEAR;
+   info->width = width;
+   info->height = height;
+   info->bitsPerPixel = bpp;
+   info->bytesPerLine = width * ((bpp + 7) / 8);
+   info->numPlanes = 1;
+   info->numBanks = 1;
+   info->memType = bpp == 8 ? VBE_MEMTYPE_PACKED : VBE_MEMTYPE_DIRECT;
+   info->linearAddress = gBGA.framebuffer;
+
+   switch (bpp) {
+
+   case 8:
+      return VBE_PIXFMT_INDEXED8;
+
+   case 15:
+      info->red.maskSize = 5;
+      info->red.fieldPos = 10;
+      info->green.maskSize = 5;
+      info->green.fieldPos = 5;
+      info->blue.maskSize = 5;
+      return VBE_PIXFMT_RGB555;
+
+   case 16:
+      info->red.maskSize = 5;
+      info->red.fieldPos = 11;
+      info->green.maskSize = 6;
+      info->green.fieldPos = 5;
+      info->blue.maskSize = 5;
+      return VBE_PIXFMT_RGB565;
+
+   default:
+      info->red.maskSize = 8;
+      info->red.fieldPos = 16;
+      info->green.maskSize = 8;
+      info->green.fieldPos = 8;
+      info->blue.maskSize = 8;
+      if (bpp == 24) {
+         return VBE_PIXFMT_RGB888;
+      }
+      info->reservedChannel.maskSize = 8;
+      info->reservedChannel.fieldPos = 24;
+      return VBE_PIXFMT_XRGB8888;
+   }
+}
+
+
+/*
+ * BGA_SetMode --
+ *
+ *    Switch to a linear graphics mode of any size the adapter
+ *    supports, with video memory for 'numPages' full-screen pages
+ *    stacked vertically. 'bpp' is 8, 15, 16, 24 or 32. Returns FALSE
+ *    if the adapter can't do it. Usually we can tell beforehand and
+ *    the mode is left alone, but if the adapter only refuses once
+ *    programmed, the display is left disabled.
+ *
+ *    On success, gVBE.current describes the new mode, and
+ *    VBE_InitSurface() can divide it into up to 'numPages' pages.
+ */
+
+fastcall Bool
+BGA_SetMode(int width, int height, int bpp, int numPages)
+{
+   VBEState *vbe = &gVBE;
+   uint32 pageBytes = width * ((bpp + 7) / 8) * height;
+   uint32 virtHeight = height * numPages;
+
+   if (!gBGA.present || numPages < 1 ||
+       width <= 0 || width > gBGA.maxWidth ||
+       height <= 0 || height > gBGA.maxHeight || virtHeight > 0xFFFF ||
+       bpp > gBGA.maxBitsPerPixel || pageBytes * numPages > gBGA.memoryBytes) {
+      return FALSE;
+   }
+   if (bpp != 8 && bpp != 15 && bpp != 16 && bpp != 24 && bpp != 32) {
+      return FALSE;
+   }
+
+   /*
+    * Enabling the adapter resets the virtual size and offsets, so
+    * those come afterwards.
+    */
+   BGAWrite(BGA_INDEX_ENABLE, 0);
+   BGAWrite(BGA_INDEX_XRES, width);
+   BGAWrite(BGA_INDEX_YRES, height);
+   BGAWrite(BGA_INDEX_BPP, bpp);
+   BGAWrite(BGA_INDEX_ENABLE, BGA_ENABLED | BGA_LFB_ENABLED);
+   BGAWrite(BGA_INDEX_VIRT_WIDTH, width);
+   BGAWrite(BGA_INDEX_VIRT_HEIGHT, virtHeight);
+   BGAWrite(BGA_INDEX_X_OFFSET, 0);
+   BGAWrite(BGA_INDEX_Y_OFFSET, 0);
+
+   /*
+    * The adapter adjusts anything it doesn't like. If it changed the
+    * mode itself, the description we'd give would be wrong.
+    */
+   if (BGARead(BGA_INDEX_XRES) != width ||
+       BGARead(BGA_INDEX_YRES) != height ||
+       BGARead(BGA_INDEX_BPP) != bpp ||
+       BGARead(BGA_INDEX_VIRT_WIDTH) != width) {
+      BGAWrite(BGA_INDEX_ENABLE, 0);
+      return FALSE;
+   }
+
+   vbe->current.mode = VBE_NO_MODE;
+   vbe->current.flags = VBE_MODEFLAG_LINEAR;
+   vbe->current.startX = 0;
+   vbe->current.startY = 0;
+   vbe->current.setDisplayStart = BGASetDisplayStart;
+   vbe->current.format = BGAFillModeInfo(&vbe->current.info, width, height, bpp);
+
+   /*
+    * VBE_InitSurface() sizes video memory from the controller info.
+    * Without the BIOS that's all we fill in.
+    */
+   vbe->cInfo.totalMemory = gBGA.memoryBytes >> 16;
+
+   return TRUE;
+}
@@ -0,0 +1,75 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * bga.h - Native driver for the Bochs Graphics Adapter, the
+ *         "DISPI" interface emulated by Bochs, QEMU and VirtualBox.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __BGA_H__
+#define __BGA_H__
+
+#include "types.h"
+#include "pci.h"
+
+/*
+ * The adapter is programmed entirely through two I/O ports, so
+ * modes of any size can be set without a trip through real mode.
+ * BGA_SetMode() fills in gVBE.current the same way VBE_SetMode()
+ * does, so the rest of Metalkit (VBE_InitSurface(), VBE_Flip(),
+ * the gfx and present modules) works unchanged. The virtual screen
+ * is made tall enough for 'numPages' full-screen pages, and flips
+ * move the Y offset register. Flips that wait for vertical blank
+ * poll for retrace with the display module.
+ */
+
+#define BGA_PCI_VENDOR        0x1234
+#define BGA_PCI_DEVICE        0x1111
+#define VBOX_PCI_VENDOR       0x80EE
+#define VBOX_PCI_DEVICE       0xBEEF
+
+#define BGA_ID_3              0xB0C3   // Oldest we support: LFB, 32 bpp, GETCAPS
+#define BGA_ID_5              0xB0C5   // Newest we know about
+
+typedef struct {
+   Bool         present;
+   uint16       version;         // BGA_ID_* value
+   PCIAddress   addr;
+   uint8       *framebuffer;     // BAR0
+   uint32       memoryBytes;
+   uint16       maxWidth;
+   uint16       maxHeight;
+   uint16       maxBitsPerPixel;
+} BGAState;
+
+extern BGAState gBGA;
+
+fastcall Bool BGA_Init(void);
+fastcall Bool BGA_SetMode(int width, int height, int bpp, int numPages);
+
+#endif /* __BGA_H__ */
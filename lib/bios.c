@@ -36,6 +36,9 @@
 #include "bios.h"
 #include "boot.h"
 #include "intr.h"
+#include "trace.h"
+#include "stats.h"
+#include "cpu.h"
 
 
 /*
@@ -48,10 +51,11 @@
  *
  *    This function must not make any function calls, since we need to
  *    be able to trust the value of %esp. This is also why it must not
- *    be inlined into BIOS_Call itself.
+ *    be inlined into BIOS_Call itself, or instrumented by a
+ *    PROFILE=1 build.
  */
 
-static __attribute__((noinline)) void
+static __attribute__((noinline, no_instrument_function)) void
 BIOSCallInternal(void)
 {
    /*
@@ -205,6 +209,8 @@ extern struct {
  *    into the trampoline.
  */
 
+STAT_HISTOGRAM(gBIOSCallCycles, "bios.call_cycles");
+
 fastcall void
 BIOS_Call(uint8 vector, Regs *regs)
 {
@@ -215,8 +221,12 @@ BIOS_Call(uint8 vector, Regs *regs)
    const uint32 vectorOffset = (uint8*)BIOSTrampolineVector - (uint8*)BIOSTrampoline + 1;
 
    Bool iFlag = Intr_Save();
+   uint64 startTSC;
    Intr_Disable();
 
+   startTSC = CPU_ReadTSC();
+   Trace_Begin("BIOS_Call", "vector,ax", vector, regs->ax, 0);
+
    /*
     * Relocate the trampoline code itself.
     */
@@ -251,5 +261,8 @@ BIOS_Call(uint8 vector, Regs *regs)
     */
    asm volatile("lidt %0" :: "m" (BIOS_SHARED->idtr32));
 
+   Trace_End("BIOS_Call", "vector,ax", vector, regs->ax, 0);
+   Stat_Sample(&gBIOSCallCycles, CPU_ReadTSC() - startTSC);
+
    Intr_Restore(iFlag);
 }
@@ -0,0 +1,191 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * clock.c - Calibrated monotonic clock, based on the CPU timestamp counter.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "clock.h"
+#include "timer.h"
+#include "intr.h"
+
+/*
+ * We calibrate by timing a few short PIT channel 2 countdowns, and
+ * keeping the fastest one. Anything that steals time from us (an SMI,
+ * or a hypervisor deschedule) can only make a trial look slower.
+ */
+#define CLOCK_CALIBRATE_TRIALS   3
+#define CLOCK_CALIBRATE_COUNT    (PIT_HZ / 100)    // 10ms
+
+ClockState gClock;
+
+static fastcall uint64 ClockReadTSC(void);
+
+ClockSource gClockSourceTSC = {
+   .name = "TSC",
+   .read = ClockReadTSC,
+};
+
+
+/*
+ * ClockReadTSC --
+ *
+ *    ClockSource read function for the TSC.
+ */
+
+static fastcall uint64
+ClockReadTSC(void)
+{
+   return CPU_ReadTSC();
+}
+
+
+/*
+ * Clock_CalcMultShift --
+ *
+ *    Calculate a multiplier and shift for use with Clock_Scale(),
+ *    which converts from a clock running at 'fromHz' to one running
+ *    at 'toHz'. We use the largest shift (up to 32) which still
+ *    leaves the multiplier in 32 bits, for the best precision.
+ */
+
+fastcall void
+Clock_CalcMultShift(uint64 fromHz, uint64 toHz, uint32 *mult, uint32 *shift)
+{
+   uint32 s = 32;
+   uint64 m;
+
+   for (;;) {
+      m = (toHz << s) / fromHz;
+      if (s == 0 || ((toHz << s) >> s == toHz && m >> 32 == 0)) {
+         break;
+      }
+      s--;
+   }
+
+   *mult = m;
+   *shift = s;
+}
+
+
+/*
+ * ClockSource_SetFrequency --
+ *
+ *    Set a ClockSource's tick rate, and precompute its conversion
+ *    to nanoseconds.
+ */
+
+fastcall void
+ClockSource_SetFrequency(ClockSource *cs, uint64 hz)
+{
+   cs->hz = hz;
+   Clock_CalcMultShift(hz, NSEC_PER_SEC, &cs->nsMult, &cs->nsShift);
+}
+
+
+/*
+ * ClockCalibrateTSC --
+ *
+ *    Measure the TSC frequency against PIT channel 2.
+ */
+
+static uint64
+ClockCalibrateTSC(void)
+{
+   uint64 best = (uint64) -1;
+   Bool iFlag = Intr_Save();
+   int i;
+
+   Intr_Disable();
+
+   for (i = 0; i < CLOCK_CALIBRATE_TRIALS; i++) {
+      uint64 start, end;
+
+      Timer_BeginPIT2(CLOCK_CALIBRATE_COUNT);
+      start = CPU_ReadTSC();
+      while (!Timer_PIT2Done());
+      end = CPU_ReadTSC();
+
+      best = MIN(best, end - start);
+   }
+
+   Intr_Restore(iFlag);
+
+   return best * PIT_HZ / CLOCK_CALIBRATE_COUNT;
+}
+
+
+/*
+ * Clock_Init --
+ *
+ *    Calibrate the TSC and check whether it's invariant. This takes
+ *    a few tens of milliseconds. Afterwards, Clock_Nanos() starts
+ *    counting from zero, and gClockSourceTSC is usable.
+ *
+ *    If the TSC isn't invariant, its rate may change with the CPU's
+ *    power state, and Clock_Nanos() will only be approximate.
+ */
+
+fastcall void
+Clock_Init(void)
+{
+   ClockState *self = &gClock;
+   CPUIDRegs id;
+
+   CPU_GetID(0x80000000, &id);
+   if (id.eax >= 0x80000007) {
+      CPU_GetID(0x80000007, &id);
+      self->invariantTSC = (id.edx & CPUID_80000007_EDX_INVARIANT) != 0;
+   }
+
+   self->tscHz = ClockCalibrateTSC();
+   Clock_CalcMultShift(self->tscHz, NSEC_PER_SEC, &self->nsMult, &self->nsShift);
+   Clock_CalcMultShift(NSEC_PER_SEC, self->tscHz, &self->cycMult, &self->cycShift);
+   ClockSource_SetFrequency(&gClockSourceTSC, self->tscHz);
+
+   self->tscBase = CPU_ReadTSC();
+}
+
+
+/*
+ * Clock_Delay --
+ *
+ *    Busy-wait for at least 'ns' nanoseconds. This doesn't depend on
+ *    interrupts, so it works with interrupts disabled.
+ */
+
+fastcall void
+Clock_Delay(uint64 ns)
+{
+   uint64 start = Clock_Cycles();
+   uint64 cycles = Clock_NanosToCycles(ns);
+
+   while (Clock_Cycles() - start < cycles) {
+      CPU_Pause();
+   }
+}
@@ -0,0 +1,177 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * clock.h - Calibrated monotonic clock, based on the CPU timestamp counter.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+#include "types.h"
+#include "cpu.h"
+
+#define NSEC_PER_SEC  1000000000ULL
+
+/*
+ * Private data, used by the inline functions below. Conversions
+ * between TSC cycles and nanoseconds are done with a 32-bit
+ * fixed-point multiplier and a shift, so that the hot path never
+ * needs a 64-bit division.
+ */
+
+typedef struct ClockState {
+   uint64 tscBase;         // TSC value at Clock_Init()
+   uint64 tscHz;           // Calibrated TSC frequency
+   uint32 nsMult;          // ns = (cycles * nsMult) >> nsShift
+   uint32 nsShift;
+   uint32 cycMult;         // cycles = (ns * cycMult) >> cycShift
+   uint32 cycShift;
+   Bool   invariantTSC;    // TSC rate is constant across P/C-states
+} ClockState;
+
+extern ClockState gClock;
+
+/*
+ * A ClockSource is any free-running counter we can read as a 64-bit
+ * tick count. Code that needs to be agnostic about its time base
+ * (a scheduler or timer wheel, for example) can hold a pointer to
+ * one of these, and use the TSC, HPET, or PIT interchangeably.
+ *
+ * Each timer driver provides its own ClockSource, which is valid
+ * once that driver's initialization function has been called.
+ */
+
+typedef struct ClockSource {
+   const char *name;
+   fastcall uint64 (*read)(void);   // Current tick count
+   uint64 hz;                       // Tick rate
+   uint32 nsMult;                   // ns = (ticks * nsMult) >> nsShift
+   uint32 nsShift;
+} ClockSource;
+
+extern ClockSource gClockSourceTSC;
+
+
+/*
+ * Public Functions
+ */
+
+fastcall void Clock_Init(void);
+fastcall void Clock_CalcMultShift(uint64 fromHz, uint64 toHz, uint32 *mult, uint32 *shift);
+fastcall void Clock_Delay(uint64 ns);
+fastcall void ClockSource_SetFrequency(ClockSource *cs, uint64 hz);
+
+
+/*
+ * Clock_Scale --
+ *
+ *    Compute (value * mult) >> shift without losing the high bits
+ *    of the 96-bit intermediate product. This is two 32x32
+ *    multiplies, and it's the core of all unit conversions here.
+ */
+
+static inline uint64
+Clock_Scale(uint64 value, uint32 mult, uint32 shift)
+{
+   uint64 low = (uint64)(uint32)value * mult;
+   uint64 high = (uint64)(uint32)(value >> 32) * mult;
+
+   return (low >> shift) + (high << (32 - shift));
+}
+
+
+/*
+ * Clock_Cycles --
+ *
+ *    Return the raw TSC. This is the cheapest timestamp available,
+ *    a single unserialized RDTSC.
+ */
+
+static inline uint64
+Clock_Cycles(void)
+{
+   return CPU_ReadTSC();
+}
+
+
+/*
+ * Clock_CyclesToNanos --
+ * Clock_NanosToCycles --
+ *
+ *    Convert a duration between TSC cycles and nanoseconds.
+ */
+
+static inline uint64
+Clock_CyclesToNanos(uint64 cycles)
+{
+   return Clock_Scale(cycles, gClock.nsMult, gClock.nsShift);
+}
+
+static inline uint64
+Clock_NanosToCycles(uint64 ns)
+{
+   return Clock_Scale(ns, gClock.cycMult, gClock.cycShift);
+}
+
+
+/*
+ * Clock_Nanos --
+ *
+ *    Monotonic nanoseconds since Clock_Init(). This doesn't take any
+ *    locks or interrupts, so it's safe to call from anywhere.
+ */
+
+static inline uint64
+Clock_Nanos(void)
+{
+   return Clock_CyclesToNanos(Clock_Cycles() - gClock.tscBase);
+}
+
+
+/*
+ * ClockSource_Read --
+ * ClockSource_Nanos --
+ *
+ *    Read a ClockSource, in ticks or in nanoseconds. Note that
+ *    different sources have different zero points.
+ */
+
+static inline uint64
+ClockSource_Read(const ClockSource *cs)
+{
+   return cs->read();
+}
+
+static inline uint64
+ClockSource_Nanos(const ClockSource *cs)
+{
+   return Clock_Scale(cs->read(), cs->nsMult, cs->nsShift);
+}
+
+#endif /* __CLOCK_H__ */
@@ -37,6 +37,53 @@
 ConsoleInterface gConsole;
 
 
+/*
+ * Formatted output is rendered into a small buffer on the stack, and
+ * handed to the console backend in as few writeBuffer calls as
+ * possible. The same formatter can also render into a caller's
+ * buffer, in which case output past the end is dropped.
+ */
+
+#define CONSOLE_BUFFER_SIZE  128
+
+typedef struct {
+   char *data;
+   uint32 len;
+   uint32 size;
+   Bool toConsole;      // Write out when full, rather than truncating
+} ConsoleBuffer;
+
+ConsoleInterface gConsoleBackends[CONSOLE_MAX_BACKENDS];
+int gConsoleNumBackends;
+fastcall void (*gConsolePanicHook)(void);
+
+static const char gConsoleHexDigits[] = "0123456789ABCDEF";
+
+static const char gConsoleDecimalPairs[] =
+   "00010203040506070809101112131415161718192021222324"
+   "25262728293031323334353637383940414243444546474849"
+   "50515253545556575859606162636465666768697071727374"
+   "75767778798081828384858687888990919293949596979899";
+
+
+/*
+ * Console_WriteBuffer --
+ *
+ *    Write 'len' characters. Backends without a writeBuffer
+ *    entry point get one writeChar call per character.
+ */
+
+fastcall void
+Console_WriteBuffer(const char *buf, uint32 len)
+{
+#ifdef CONSOLE_STATIC
+   CONSOLE_STATIC_CALL(WriteBuffer, (buf, len));
+#else
+   Console_WriteTo(&gConsole, buf, len);
+#endif
+}
+
+
 /*
  * Console_WriteString --
  *
@@ -46,49 +93,346 @@ ConsoleInterface gConsole;
 fastcall void
 Console_WriteString(const char *str)
 {
-   char c;
-   while ((c = *(str++))) {
-      Console_WriteChar(c);
+   const char *end = str;
+   while (*end) {
+      end++;
+   }
+   Console_WriteBuffer(str, end - str);
+}
+
+
+/*
+ * Console_AddBackend --
+ *
+ *    Register a console backend, so that Console_WriteAll() reaches
+ *    it even when it isn't the current console. Each backend's Init
+ *    function registers itself; registering twice has no effect.
+ */
+
+fastcall void
+Console_AddBackend(const ConsoleInterface *backend)
+{
+   int i;
+
+   for (i = 0; i < gConsoleNumBackends; i++) {
+      if (gConsoleBackends[i].writeChar == backend->writeChar) {
+         return;
+      }
+   }
+
+   if (gConsoleNumBackends < CONSOLE_MAX_BACKENDS) {
+      gConsoleBackends[gConsoleNumBackends++] = *backend;
+   }
+}
+
+
+/*
+ * Console_RemoveBackend --
+ *
+ *    Unregister a console backend, for example one whose output
+ *    device is no longer visible.
+ */
+
+fastcall void
+Console_RemoveBackend(const ConsoleInterface *backend)
+{
+   int i;
+
+   for (i = 0; i < gConsoleNumBackends; i++) {
+      if (gConsoleBackends[i].writeChar == backend->writeChar) {
+         break;
+      }
+   }
+
+   if (i < gConsoleNumBackends) {
+      gConsoleNumBackends--;
+      for (; i < gConsoleNumBackends; i++) {
+         gConsoleBackends[i] = gConsoleBackends[i + 1];
+      }
+   }
+}
+
+
+/*
+ * Console_WriteTo --
+ *
+ *    Write to a specific backend, which needn't be the current
+ *    console.
+ */
+
+fastcall void
+Console_WriteTo(const ConsoleInterface *backend, const char *buf, uint32 len)
+{
+   if (backend->writeBuffer) {
+      backend->writeBuffer(buf, len);
+   } else {
+      while (len--) {
+         backend->writeChar(*(buf++));
+      }
+   }
+}
+
+
+/*
+ * Console_WriteAll --
+ * Console_FlushAll --
+ *
+ *    Write to, or flush, every registered backend.
+ */
+
+fastcall void
+Console_WriteAll(const char *buf, uint32 len)
+{
+   int i;
+
+   for (i = 0; i < gConsoleNumBackends; i++) {
+      Console_WriteTo(&gConsoleBackends[i], buf, len);
+   }
+}
+
+fastcall void
+Console_FlushAll(void)
+{
+   int i;
+
+   for (i = 0; i < gConsoleNumBackends; i++) {
+      gConsoleBackends[i].flush();
+   }
+}
+
+
+/*
+ * ConsoleBufferInit --
+ * ConsoleBufferFlush --
+ * ConsoleBufferPut --
+ * ConsoleBufferPutString --
+ *
+ *    Append to a ConsoleBuffer, writing it out whenever it fills.
+ */
+
+static inline void
+ConsoleBufferInit(ConsoleBuffer *buffer, char *data, uint32 size, Bool toConsole)
+{
+   buffer->data = data;
+   buffer->len = 0;
+   buffer->size = size;
+   buffer->toConsole = toConsole;
+}
+
+static fastcall void
+ConsoleBufferFlush(ConsoleBuffer *buffer)
+{
+   if (buffer->len && buffer->toConsole) {
+      Console_WriteBuffer(buffer->data, buffer->len);
+      buffer->len = 0;
+   }
+}
+
+static inline void
+ConsoleBufferPut(ConsoleBuffer *buffer, char c)
+{
+   if (buffer->len == buffer->size) {
+      ConsoleBufferFlush(buffer);
+      if (buffer->len == buffer->size) {
+         return;
+      }
+   }
+   buffer->data[buffer->len++] = c;
+}
+
+static fastcall void
+ConsoleBufferPutString(ConsoleBuffer *buffer, const char *str, uint32 len)
+{
+   while (len) {
+      uint32 chunk;
+
+      if (buffer->len == buffer->size) {
+         ConsoleBufferFlush(buffer);
+         if (buffer->len == buffer->size) {
+            return;
+         }
+      }
+
+      chunk = MIN(len, buffer->size - buffer->len);
+      memcpy(buffer->data + buffer->len, str, chunk);
+      buffer->len += chunk;
+      str += chunk;
+      len -= chunk;
+   }
+}
+
+
+/*
+ * ConsoleRenderDec32 --
+ *
+ *    Render a 32-bit number in decimal, backwards from 'end', two
+ *    digits at a time. Returns a pointer to the first digit.
+ */
+
+static fastcall char *
+ConsoleRenderDec32(char *end, uint32 num)
+{
+   while (num >= 100) {
+      uint32 pair = num % 100;
+      num /= 100;
+      end -= 2;
+      end[0] = gConsoleDecimalPairs[pair * 2];
+      end[1] = gConsoleDecimalPairs[pair * 2 + 1];
+   }
+
+   if (num >= 10) {
+      end -= 2;
+      end[0] = gConsoleDecimalPairs[num * 2];
+      end[1] = gConsoleDecimalPairs[num * 2 + 1];
+   } else {
+      *(--end) = '0' + num;
+   }
+
+   return end;
+}
+
+
+/*
+ * ConsoleRender --
+ *
+ *    Render a number backwards from 'end', in any base from 2 to
+ *    16. Always produces at least one digit. Returns a pointer to
+ *    the first digit.
+ *
+ *    Power-of-two bases only need shifts and masks. Decimal numbers
+ *    are split into 9-digit chunks, so we only need the (slow)
+ *    64-bit division when the number doesn't fit in 32 bits.
+ */
+
+static fastcall char *
+ConsoleRender(char *end, uint64 num, int base)
+{
+   if ((base & (base - 1)) == 0) {
+      int shift = __builtin_ctz(base);
+      uint32 mask = base - 1;
+
+      while (num >> 32) {
+         *(--end) = gConsoleHexDigits[(uint32)num & mask];
+         num >>= shift;
+      }
+
+      uint32 num32 = num;
+      do {
+         *(--end) = gConsoleHexDigits[num32 & mask];
+         num32 >>= shift;
+      } while (num32);
+
+   } else if (base == 10) {
+      while (num >> 32) {
+         uint64 upper = num / 1000000000;
+         char *chunk = end - 9;
+         char *p = ConsoleRenderDec32(end, num - upper * 1000000000);
+
+         while (p > chunk) {
+            *(--p) = '0';
+         }
+         end = chunk;
+         num = upper;
+      }
+      end = ConsoleRenderDec32(end, num);
+
+   } else {
+      do {
+         *(--end) = gConsoleHexDigits[num % base];
+         num /= base;
+      } while (num);
+   }
+
+   return end;
+}
+
+
+/*
+ * ConsoleBufferPutUInt --
+ *
+ *    Append a number to a ConsoleBuffer, exactly 'digits' characters
+ *    long. If 'padding' is non-NUL, it fills the space left of the
+ *    number. If padding is NUL, leading digits are suppressed
+ *    entirely. Numbers too long for 'digits' lose their most
+ *    significant digits.
+ */
+
+static fastcall void
+ConsoleBufferPutUInt(ConsoleBuffer *buffer, uint64 num, int digits,
+                     char padding, int base)
+{
+   char str[64];
+   char *end = str + sizeof str;
+   char *begin = ConsoleRender(end, num, base);
+   int len = end - begin;
+
+   if (len > digits) {
+      begin += len - digits;
+      len = digits;
+   }
+
+   if (padding) {
+      while (digits-- > len) {
+         ConsoleBufferPut(buffer, padding);
+      }
    }
+
+   ConsoleBufferPutString(buffer, begin, len);
 }
 
 
 /*
  * Console_WriteUInt32 --
+ * Console_WriteUInt64 --
+ *
+ *    Write a positive integer with arbitrary base from 2 to 16, up
+ *    to 'digits' characters long. If 'padding' is non-NUL, this
+ *    character is used for leading digits that would be zero.  If
+ *    padding is NUL, leading digits are suppressed entierly.
  *
- *    Write a positive 32-bit integer with arbitrary base from 2 to
- *    16, up to 'digits' characters long. If 'padding' is non-NUL,
- *    this character is used for leading digits that would be zero.
- *    If padding is NUL, leading digits are suppressed entierly.
+ *    If 'suppressZero' is set, a value of zero is written as
+ *    padding only.
  */
 
 fastcall void
 Console_WriteUInt32(uint32 num, int digits, char padding, int base, Bool suppressZero)
 {
-   if (digits == 0) {
-      return;
-   }
+   ConsoleBuffer buffer;
+   char data[CONSOLE_BUFFER_SIZE];
 
-   Console_WriteUInt32(num / base, digits - 1, padding, base, TRUE);
+   ConsoleBufferInit(&buffer, data, sizeof data, TRUE);
 
    if (num == 0 && suppressZero) {
-      if (padding) {
-	 Console_WriteChar(padding);
+      while (padding && digits-- > 0) {
+         ConsoleBufferPut(&buffer, padding);
       }
    } else {
-      uint8 digit = num % base;
-      Console_WriteChar(digit >= 10 ? digit - 10 + 'A' : digit + '0');
+      ConsoleBufferPutUInt(&buffer, num, digits, padding, base);
    }
+
+   ConsoleBufferFlush(&buffer);
+}
+
+fastcall void
+Console_WriteUInt64(uint64 num, int digits, char padding, int base)
+{
+   ConsoleBuffer buffer;
+   char data[CONSOLE_BUFFER_SIZE];
+
+   ConsoleBufferInit(&buffer, data, sizeof data, TRUE);
+   ConsoleBufferPutUInt(&buffer, num, digits, padding, base);
+   ConsoleBufferFlush(&buffer);
 }
 
 
 /*
+ * ConsoleBufferFormatV --
  * Console_Format --
  * Console_FormatV --
  *
  *    Write a formatted string. This is for the most part a tiny
  *    subset of printf(). Supports the standard %c, %s, %d, %u,
- *    and %X specifiers.
+ *    and %X specifiers, and the 'll' modifier for 64-bit integers.
  *
  *    Deviates from a standard printf() in a few ways, in the interest
  *    of low-level utility and small code size:
@@ -98,25 +442,20 @@ Console_WriteUInt32(uint32 num, int digits, char padding, int base, Bool suppres
  *     - %x is treated as %X.
  */
 
-void
-Console_Format(const char *fmt, ...)
-{
-   Console_FormatV(&fmt);
-}
-
-fastcall void
-Console_FormatV(const char **args)
+static fastcall void
+ConsoleBufferFormatV(ConsoleBuffer *buffer, const char **args)
 {
    char c;
    const char *fmt = *(args++);
 
    while ((c = *(fmt++))) {
       int width = 0;
+      int longs = 0;
       Bool isSigned = FALSE;
       char padding = '\0';
 
       if (c != '%') {
-         Console_WriteChar(c);
+         ConsoleBufferPut(buffer, c);
          continue;
       }
 
@@ -134,13 +473,18 @@ Console_FormatV(const char **args)
             }
             continue;
          }
+         if (c == 'l') {
+            /* 'l' is a no-op on this platform, 'll' selects a 64-bit argument */
+            longs++;
+            continue;
+         }
 
          /*
           * Any other character means the width specifier has
           * ended. If it's still zero, set the defaults.
           */
          if (width == 0) {
-            width = 32;
+            width = longs >= 2 ? 64 : 32;
          }
 
          /*
@@ -148,11 +492,16 @@ Console_FormatV(const char **args)
           */
 
          if (c == 's') {
-            Console_WriteString((char*) *(args++));
+            const char *str = (const char*) *(args++);
+            const char *end = str;
+            while (*end) {
+               end++;
+            }
+            ConsoleBufferPutString(buffer, str, end - str);
             break;
          }
          if (c == 'c') {
-            Console_WriteChar((char)(uint32) *(args++));
+            ConsoleBufferPut(buffer, (char)(uint32) *(args++));
             break;
          }
 
@@ -173,28 +522,75 @@ Console_FormatV(const char **args)
          }
 
          if (base) {
-            uint32 value = (uint32)*(args++);
+            uint64 value;
+
+            if (longs >= 2) {
+               uint32 low = (uint32)*(args++);
+               uint32 high = (uint32)*(args++);
+               value = ((uint64)high << 32) | low;
+            } else if (isSigned) {
+               value = (int64)(int32)*(args++);
+            } else {
+               value = (uint32)*(args++);
+            }
 
             /*
              * Print the sign for negative numbers.
              */
-            if (isSigned && 0 > (int32)value) {
-               Console_WriteChar('-');
+            if (isSigned && 0 > (int64)value) {
+               ConsoleBufferPut(buffer, '-');
                width--;
                value = -value;
             }
 
-            Console_WriteUInt32(value, width, padding, base, FALSE);
+            ConsoleBufferPutUInt(buffer, value, width, padding, base);
             break;
          }
 
          /* Unrecognized */
-         Console_WriteChar(c);
+         ConsoleBufferPut(buffer, c);
          break;
       }
    }
 }
 
+void
+Console_Format(const char *fmt, ...)
+{
+   Console_FormatV(&fmt);
+}
+
+fastcall void
+Console_FormatV(const char **args)
+{
+   ConsoleBuffer buffer;
+   char data[CONSOLE_BUFFER_SIZE];
+
+   ConsoleBufferInit(&buffer, data, sizeof data, TRUE);
+   ConsoleBufferFormatV(&buffer, args);
+   ConsoleBufferFlush(&buffer);
+}
+
+
+/*
+ * Console_FormatToBuffer --
+ *
+ *    Format into a caller-supplied buffer instead of the console.
+ *    Takes the same arguments as Console_FormatV. Output that doesn't
+ *    fit is dropped. Returns the number of characters written; the
+ *    result is not NUL-terminated.
+ */
+
+fastcall uint32
+Console_FormatToBuffer(char *buf, uint32 size, const char **args)
+{
+   ConsoleBuffer buffer;
+
+   ConsoleBufferInit(&buffer, buf, size, FALSE);
+   ConsoleBufferFormatV(&buffer, args);
+   return buffer.len;
+}
+
 
 /*
  * Console_HexDump --
@@ -248,6 +644,9 @@ Console_UnhandledFault(int vector)
       "\n";
 
    Console_BeginPanic();
+   if (gConsolePanicHook) {
+      gConsolePanicHook();
+   }
 
    /*
     * IntrContext's stack pointer includes the three values that were
@@ -283,6 +682,9 @@ void
 Console_Panic(const char *fmt, ...)
 {
    Console_BeginPanic();
+   if (gConsolePanicHook) {
+      gConsolePanicHook();
+   }
    Console_WriteString("Panic:\n");
    Console_FormatV(&fmt);
    Console_Flush();
@@ -40,24 +40,113 @@ typedef struct {
    fastcall void (*clear)(void);            // Clear the screen, home the cursor
    fastcall void (*moveTo)(int x, int y);   // Move the cursor
    fastcall void (*writeChar)(char c);      // Write one character, with support for control codes
+   fastcall void (*writeBuffer)(const char *buf, uint32 len);  // Write many characters (optional)
    fastcall void (*flush)(void);            // Finish writing a string of characters
 } ConsoleInterface;
 
 extern ConsoleInterface gConsole;
 
+/*
+ * Every backend that has been initialized, whether or not it's the
+ * current console. Used for output that should go everywhere, like
+ * the log ring.
+ */
+#define CONSOLE_MAX_BACKENDS  4
+
+extern ConsoleInterface gConsoleBackends[CONSOLE_MAX_BACKENDS];
+extern int gConsoleNumBackends;
+
+/*
+ * Optional hook, run by Console_Panic() and Console_UnhandledFault()
+ * after the console has been prepared for a panic but before the
+ * panic message itself.
+ */
+extern fastcall void (*gConsolePanicHook)(void);
+
+#ifdef CONSOLE_STATIC
+
+/*
+ * Built with CONSOLE_BACKENDS set (see Makefile.rules): the current
+ * console is a fixed list of backends, called directly rather than
+ * through gConsole. VGA comes first, then the framebuffer, then
+ * serial. Backends still fill in gConsole when initialized, so
+ * Console_WriteTo(&gConsole) and the other runtime interfaces keep
+ * working, but switching gConsole no longer changes where Console_*
+ * output goes. ConsoleFB_Init() exists only to make that switch, so
+ * linking console_fb without "fb" in the list is a build error.
+ *
+ * Every listed backend is called from the first Console_* call on,
+ * so initialize them all before writing anything. Until then the
+ * framebuffer and serial backends drop their output.
+ */
+
+#ifdef CONSOLE_STATIC_VGA
+#define CONSOLE_STATIC_VGA_CALL(fn, args)     ConsoleVGA_##fn args;
+#else
+#define CONSOLE_STATIC_VGA_CALL(fn, args)
+#endif
+
+#ifdef CONSOLE_STATIC_FB
+#define CONSOLE_STATIC_FB_CALL(fn, args)      ConsoleFB_##fn args;
+#else
+#define CONSOLE_STATIC_FB_CALL(fn, args)
+#endif
+
+#ifdef CONSOLE_STATIC_SERIAL
+#define CONSOLE_STATIC_SERIAL_CALL(fn, args)  ConsoleSerial_##fn args;
+#else
+#define CONSOLE_STATIC_SERIAL_CALL(fn, args)
+#endif
+
+#define CONSOLE_STATIC_CALL(fn, args)        \
+   do {                                      \
+      CONSOLE_STATIC_VGA_CALL(fn, args)      \
+      CONSOLE_STATIC_FB_CALL(fn, args)       \
+      CONSOLE_STATIC_SERIAL_CALL(fn, args)   \
+   } while (0)
+
+#define Console_BeginPanic()   CONSOLE_STATIC_CALL(BeginPanic, ())
+#define Console_Clear()        CONSOLE_STATIC_CALL(Clear, ())
+#define Console_MoveTo(x, y)   CONSOLE_STATIC_CALL(MoveTo, (x, y))
+#define Console_WriteChar(c)   CONSOLE_STATIC_CALL(WriteChar, (c))
+#define Console_Flush()        CONSOLE_STATIC_CALL(Flush, ())
+
+#else /* !CONSOLE_STATIC */
+
 #define Console_BeginPanic()   gConsole.beginPanic()
 #define Console_Clear()        gConsole.clear()
 #define Console_MoveTo(x, y)   gConsole.moveTo(x, y)
 #define Console_WriteChar(c)   gConsole.writeChar(c)
 #define Console_Flush()        gConsole.flush()
 
+#endif /* CONSOLE_STATIC */
+
+fastcall void Console_AddBackend(const ConsoleInterface *backend);
+fastcall void Console_RemoveBackend(const ConsoleInterface *backend);
+fastcall void Console_WriteTo(const ConsoleInterface *backend, const char *buf, uint32 len);
+fastcall void Console_WriteAll(const char *buf, uint32 len);
+fastcall void Console_FlushAll(void);
+
+fastcall void Console_WriteBuffer(const char *buf, uint32 len);
 fastcall void Console_WriteString(const char *str);
 fastcall void Console_WriteUInt32(uint32 num, int digits, char padding, int base, Bool suppressZero);
+fastcall void Console_WriteUInt64(uint64 num, int digits, char padding, int base);
 fastcall void Console_FormatV(const char **args);
+fastcall uint32 Console_FormatToBuffer(char *buf, uint32 size, const char **args);
 fastcall void Console_HexDump(uint32 *data, uint32 startAddr, uint32 numWords);
 
 void Console_Format(const char *fmt, ...);
 void Console_Panic(const char *str, ...);
 void Console_UnhandledFault(int number);
 
+#ifdef CONSOLE_STATIC_VGA
+#include "console_vga.h"
+#endif
+#ifdef CONSOLE_STATIC_FB
+#include "console_fb.h"
+#endif
+#ifdef CONSOLE_STATIC_SERIAL
+#include "console_serial.h"
+#endif
+
 #endif /* __CONSOLE_H__ */
@@ -0,0 +1,755 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * console_fb.c - Text console on a VBE linear framebuffer
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "console_fb.h"
+#include "console_vga.h"
+#include "vbe.h"
+#include "bios.h"
+
+#define FB_GLYPH_BYTES   (CONSOLE_FB_GLYPH_HEIGHT)   // One byte per row
+#define FB_NUM_GLYPHS    256
+#define FB_FIRST_GLYPH   0x20     // First character in the built-in font
+#define FB_LAST_GLYPH    0x7F     // Box, drawn for characters we have no glyph for
+#define FB_MAX_ROW_WORDS (CONSOLE_FB_GLYPH_WIDTH * 4 / sizeof(uint32))
+#define FB_GLYPH_VALID   0x100
+
+typedef struct {
+   uint8 *fb;
+   uint32 pitch;
+   uint32 bytesPerPixel;
+   uint32 rowWords;           // 32-bit words in one row of one glyph
+   int columns, rows;         // Screen size, in characters
+   int maxTop;                // Highest 'top' that keeps the screen in video memory
+   int top;                   // Ring row at the top of the screen
+   int hwTop;                 // Value of 'top' last given to the BIOS
+   int shadowTop;             // Shadow row at the top of the screen
+   struct {
+      int x, y;
+   } cursor;
+   uint8 attr;
+   Bool pan;
+   int extraLines;            // Scanlines below the last text row
+   uint32 pixels[16];         // VGA colors, in the framebuffer's format
+   const uint8 *biosFont;     // With CONSOLE_FB_BIOS_FONT, all 256 glyphs
+   uint16 glyphAttr[FB_NUM_GLYPHS];  // Colors each cached glyph is in, plus FB_GLYPH_VALID
+   uint16 shadow[CONSOLE_FB_MAX_ROWS * CONSOLE_FB_MAX_COLUMNS];
+   uint32 glyphs[FB_NUM_GLYPHS * CONSOLE_FB_GLYPH_HEIGHT * FB_MAX_ROW_WORDS];
+} ConsoleFBObject;
+
+ConsoleFBObject gConsoleFB;
+
+/*
+ * Only used to unregister the VGA text console, so don't make apps
+ * that never link it pull it in.
+ */
+extern const ConsoleInterface gConsoleVGAInterface __attribute__ ((weak));
+
+#if defined(CONSOLE_STATIC) && !defined(CONSOLE_STATIC_FB)
+#error "ConsoleFB_Init() can't switch a static console. Add fb to CONSOLE_BACKENDS."
+#endif
+
+/*
+ * The 16 VGA text colors, as 24-bit RGB.
+ */
+static const uint32 gConsoleFBColors[16] = {
+   0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+   0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF,
+};
+
+
+/*
+ * The built-in font: printable ASCII in 8x16, one byte per scanline
+ * with the leftmost pixel in the high bit. Control characters are
+ * drawn as spaces, and everything above 0x7F as the box at 0x7F.
+ */
+static const uint8 gConsoleFBFont[FB_LAST_GLYPH - FB_FIRST_GLYPH + 1][FB_GLYPH_BYTES] = {
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // ' '
+   { 0x00, 0x00, 0x18, 0x3C, 0x3C, 0x3C, 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00 },   // '!'
+   { 0x00, 0x00, 0x66, 0x66, 0x66, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '"'
+   { 0x00, 0x00, 0x00, 0x6C, 0x6C, 0xFE, 0x6C, 0x6C, 0x6C, 0xFE, 0x6C, 0x6C, 0x00, 0x00, 0x00, 0x00 },   // '#'
+   { 0x00, 0x00, 0x18, 0x7C, 0xC6, 0xC2, 0xC0, 0x7C, 0x06, 0x86, 0xC6, 0x7C, 0x18, 0x18, 0x00, 0x00 },   // '$'
+   { 0x00, 0x00, 0x00, 0x00, 0xC2, 0xC6, 0x0C, 0x18, 0x30, 0x60, 0xC6, 0x86, 0x00, 0x00, 0x00, 0x00 },   // '%'
+   { 0x00, 0x00, 0x38, 0x6C, 0x6C, 0x38, 0x76, 0xDC, 0xCC, 0xCC, 0xCC, 0x76, 0x00, 0x00, 0x00, 0x00 },   // '&'
+   { 0x00, 0x00, 0x30, 0x30, 0x30, 0x60, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '''
+   { 0x00, 0x00, 0x0C, 0x18, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x18, 0x0C, 0x00, 0x00, 0x00, 0x00 },   // '('
+   { 0x00, 0x00, 0x60, 0x30, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x30, 0x60, 0x00, 0x00, 0x00, 0x00 },   // ')'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x3C, 0xFE, 0x3C, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '*'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x7E, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '+'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x30, 0x00, 0x00, 0x00 },   // ','
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '-'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00 },   // '.'
+   { 0x00, 0x00, 0x00, 0x00, 0x02, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x80, 0x00, 0x00, 0x00, 0x00 },   // '/'
+   { 0x00, 0x00, 0x38, 0x6C, 0xC6, 0xC6, 0xD6, 0xD6, 0xC6, 0xC6, 0x6C, 0x38, 0x00, 0x00, 0x00, 0x00 },   // '0'
+   { 0x00, 0x00, 0x18, 0x38, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7E, 0x00, 0x00, 0x00, 0x00 },   // '1'
+   { 0x00, 0x00, 0x7C, 0xC6, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0xC6, 0xFE, 0x00, 0x00, 0x00, 0x00 },   // '2'
+   { 0x00, 0x00, 0x7C, 0xC6, 0x06, 0x06, 0x3C, 0x06, 0x06, 0x06, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // '3'
+   { 0x00, 0x00, 0x0C, 0x1C, 0x3C, 0x6C, 0xCC, 0xFE, 0x0C, 0x0C, 0x0C, 0x1E, 0x00, 0x00, 0x00, 0x00 },   // '4'
+   { 0x00, 0x00, 0xFE, 0xC0, 0xC0, 0xC0, 0xFC, 0x06, 0x06, 0x06, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // '5'
+   { 0x00, 0x00, 0x38, 0x60, 0xC0, 0xC0, 0xFC, 0xC6, 0xC6, 0xC6, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // '6'
+   { 0x00, 0x00, 0xFE, 0xC6, 0x06, 0x0C, 0x18, 0x30, 0x30, 0x30, 0x30, 0x30, 0x00, 0x00, 0x00, 0x00 },   // '7'
+   { 0x00, 0x00, 0x7C, 0xC6, 0xC6, 0xC6, 0x7C, 0xC6, 0xC6, 0xC6, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // '8'
+   { 0x00, 0x00, 0x7C, 0xC6, 0xC6, 0xC6, 0x7E, 0x06, 0x06, 0x06, 0x0C, 0x78, 0x00, 0x00, 0x00, 0x00 },   // '9'
+   { 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },   // ':'
+   { 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x30, 0x00, 0x00, 0x00, 0x00 },   // ';'
+   { 0x00, 0x00, 0x00, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x30, 0x18, 0x0C, 0x06, 0x00, 0x00, 0x00, 0x00 },   // '<'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x00, 0x00, 0x7E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '='
+   { 0x00, 0x00, 0x00, 0x60, 0x30, 0x18, 0x0C, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x00, 0x00, 0x00, 0x00 },   // '>'
+   { 0x00, 0x00, 0x7C, 0xC6, 0xC6, 0x0C, 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00 },   // '?'
+   { 0x00, 0x00, 0x7C, 0xC6, 0xC6, 0xDE, 0xDE, 0xDE, 0xDC, 0xC0, 0xC0, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // '@'
+   { 0x00, 0x00, 0x10, 0x38, 0x6C, 0xC6, 0xC6, 0xFE, 0xC6, 0xC6, 0xC6, 0xC6, 0x00, 0x00, 0x00, 0x00 },   // 'A'
+   { 0x00, 0x00, 0xFC, 0x66, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x66, 0x66, 0xFC, 0x00, 0x00, 0x00, 0x00 },   // 'B'
+   { 0x00, 0x00, 0x3C, 0x66, 0xC2, 0xC0, 0xC0, 0xC0, 0xC0, 0xC2, 0x66, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'C'
+   { 0x00, 0x00, 0xF8, 0x6C, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x6C, 0xF8, 0x00, 0x00, 0x00, 0x00 },   // 'D'
+   { 0x00, 0x00, 0xFE, 0x66, 0x62, 0x68, 0x78, 0x68, 0x60, 0x62, 0x66, 0xFE, 0x00, 0x00, 0x00, 0x00 },   // 'E'
+   { 0x00, 0x00, 0xFE, 0x66, 0x62, 0x68, 0x78, 0x68, 0x60, 0x60, 0x60, 0xF0, 0x00, 0x00, 0x00, 0x00 },   // 'F'
+   { 0x00, 0x00, 0x3C, 0x66, 0xC2, 0xC0, 0xC0, 0xDE, 0xC6, 0xC6, 0x66, 0x3A, 0x00, 0x00, 0x00, 0x00 },   // 'G'
+   { 0x00, 0x00, 0xC6, 0xC6, 0xC6, 0xC6, 0xFE, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x00, 0x00, 0x00, 0x00 },   // 'H'
+   { 0x00, 0x00, 0x3C, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'I'
+   { 0x00, 0x00, 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0xCC, 0xCC, 0x78, 0x00, 0x00, 0x00, 0x00 },   // 'J'
+   { 0x00, 0x00, 0xE6, 0x66, 0x6C, 0x6C, 0x78, 0x78, 0x6C, 0x66, 0x66, 0xE6, 0x00, 0x00, 0x00, 0x00 },   // 'K'
+   { 0x00, 0x00, 0xF0, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x62, 0x66, 0xFE, 0x00, 0x00, 0x00, 0x00 },   // 'L'
+   { 0x00, 0x00, 0xC6, 0xEE, 0xFE, 0xFE, 0xD6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x00, 0x00, 0x00, 0x00 },   // 'M'
+   { 0x00, 0x00, 0xC6, 0xE6, 0xF6, 0xFE, 0xDE, 0xCE, 0xC6, 0xC6, 0xC6, 0xC6, 0x00, 0x00, 0x00, 0x00 },   // 'N'
+   { 0x00, 0x00, 0x7C, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'O'
+   { 0x00, 0x00, 0xFC, 0x66, 0x66, 0x66, 0x7C, 0x60, 0x60, 0x60, 0x60, 0xF0, 0x00, 0x00, 0x00, 0x00 },   // 'P'
+   { 0x00, 0x00, 0x7C, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xD6, 0xDE, 0x7C, 0x0C, 0x06, 0x00, 0x00 },   // 'Q'
+   { 0x00, 0x00, 0xFC, 0x66, 0x66, 0x66, 0x7C, 0x6C, 0x66, 0x66, 0x66, 0xE6, 0x00, 0x00, 0x00, 0x00 },   // 'R'
+   { 0x00, 0x00, 0x7C, 0xC6, 0xC6, 0x60, 0x38, 0x0C, 0x06, 0xC6, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'S'
+   { 0x00, 0x00, 0x7E, 0x5A, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'T'
+   { 0x00, 0x00, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'U'
+   { 0x00, 0x00, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x6C, 0x38, 0x10, 0x00, 0x00, 0x00, 0x00 },   // 'V'
+   { 0x00, 0x00, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xD6, 0xD6, 0xFE, 0xEE, 0x6C, 0x00, 0x00, 0x00, 0x00 },   // 'W'
+   { 0x00, 0x00, 0xC6, 0xC6, 0x6C, 0x38, 0x10, 0x38, 0x6C, 0xC6, 0xC6, 0xC6, 0x00, 0x00, 0x00, 0x00 },   // 'X'
+   { 0x00, 0x00, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'Y'
+   { 0x00, 0x00, 0xFE, 0xC6, 0x86, 0x0C, 0x18, 0x30, 0x60, 0xC2, 0xC6, 0xFE, 0x00, 0x00, 0x00, 0x00 },   // 'Z'
+   { 0x00, 0x00, 0x3C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // '['
+   { 0x00, 0x00, 0x00, 0x00, 0x80, 0xC0, 0x60, 0x30, 0x18, 0x0C, 0x06, 0x02, 0x00, 0x00, 0x00, 0x00 },   // '\\'
+   { 0x00, 0x00, 0x3C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // ']'
+   { 0x00, 0x00, 0x10, 0x38, 0x6C, 0xC6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '^'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00 },   // '_'
+   { 0x00, 0x00, 0x30, 0x30, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '`'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x0C, 0x7C, 0xCC, 0xCC, 0xCC, 0x76, 0x00, 0x00, 0x00, 0x00 },   // 'a'
+   { 0x00, 0x00, 0xE0, 0x60, 0x60, 0x78, 0x6C, 0x66, 0x66, 0x66, 0x66, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'b'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0xC6, 0xC0, 0xC0, 0xC0, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'c'
+   { 0x00, 0x00, 0x1C, 0x0C, 0x0C, 0x3C, 0x6C, 0xCC, 0xCC, 0xCC, 0xCC, 0x76, 0x00, 0x00, 0x00, 0x00 },   // 'd'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0xC6, 0xFE, 0xC0, 0xC0, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'e'
+   { 0x00, 0x00, 0x38, 0x6C, 0x64, 0x60, 0xF0, 0x60, 0x60, 0x60, 0x60, 0xF0, 0x00, 0x00, 0x00, 0x00 },   // 'f'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x76, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0x7C, 0x0C, 0xCC, 0x78, 0x00 },   // 'g'
+   { 0x00, 0x00, 0xE0, 0x60, 0x60, 0x6C, 0x76, 0x66, 0x66, 0x66, 0x66, 0xE6, 0x00, 0x00, 0x00, 0x00 },   // 'h'
+   { 0x00, 0x00, 0x18, 0x18, 0x00, 0x38, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'i'
+   { 0x00, 0x00, 0x06, 0x06, 0x00, 0x0E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x66, 0x66, 0x3C, 0x00 },   // 'j'
+   { 0x00, 0x00, 0xE0, 0x60, 0x60, 0x66, 0x6C, 0x78, 0x78, 0x6C, 0x66, 0xE6, 0x00, 0x00, 0x00, 0x00 },   // 'k'
+   { 0x00, 0x00, 0x38, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'l'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xEC, 0xFE, 0xD6, 0xD6, 0xD6, 0xD6, 0xC6, 0x00, 0x00, 0x00, 0x00 },   // 'm'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xDC, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x00, 0x00, 0x00, 0x00 },   // 'n'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'o'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xDC, 0x66, 0x66, 0x66, 0x66, 0x66, 0x7C, 0x60, 0x60, 0xF0, 0x00 },   // 'p'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x76, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0x7C, 0x0C, 0x0C, 0x1E, 0x00 },   // 'q'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xDC, 0x76, 0x66, 0x60, 0x60, 0x60, 0xF0, 0x00, 0x00, 0x00, 0x00 },   // 'r'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0xC6, 0x60, 0x38, 0x0C, 0xC6, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 's'
+   { 0x00, 0x00, 0x10, 0x30, 0x30, 0xFC, 0x30, 0x30, 0x30, 0x30, 0x36, 0x1C, 0x00, 0x00, 0x00, 0x00 },   // 't'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0x76, 0x00, 0x00, 0x00, 0x00 },   // 'u'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xC6, 0xC6, 0xC6, 0xC6, 0x6C, 0x38, 0x10, 0x00, 0x00, 0x00, 0x00 },   // 'v'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xC6, 0xC6, 0xD6, 0xD6, 0xD6, 0xFE, 0x6C, 0x00, 0x00, 0x00, 0x00 },   // 'w'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xC6, 0x6C, 0x38, 0x38, 0x38, 0x6C, 0xC6, 0x00, 0x00, 0x00, 0x00 },   // 'x'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0xC6, 0x7E, 0x06, 0x0C, 0xF8, 0x00 },   // 'y'
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0xFE, 0xCC, 0x18, 0x30, 0x60, 0xC6, 0xFE, 0x00, 0x00, 0x00, 0x00 },   // 'z'
+   { 0x00, 0x00, 0x0E, 0x18, 0x18, 0x18, 0x70, 0x18, 0x18, 0x18, 0x18, 0x0E, 0x00, 0x00, 0x00, 0x00 },   // '{'
+   { 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00 },   // '|'
+   { 0x00, 0x00, 0xE0, 0x30, 0x30, 0x30, 0x1C, 0x30, 0x30, 0x30, 0x30, 0xE0, 0x00, 0x00, 0x00, 0x00 },   // '}'
+   { 0x00, 0x00, 0x76, 0xDC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '~'
+   { 0x00, 0x00, 0x00, 0xFE, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0xFE, 0x00, 0x00, 0x00, 0x00 },   // DEL, drawn for glyphs we don't have
+};
+
+
+/*
+ * ConsoleFBGlyph --
+ *
+ *    Return the font bits for a character.
+ */
+
+static inline const uint8 *
+ConsoleFBGlyph(uint8 c)
+{
+   if (gConsoleFB.biosFont) {
+      return gConsoleFB.biosFont + c * FB_GLYPH_BYTES;
+   }
+   if (c < FB_FIRST_GLYPH) {
+      c = ' ';
+   } else if (c > FB_LAST_GLYPH) {
+      c = FB_LAST_GLYPH;
+   }
+   return gConsoleFBFont[c - FB_FIRST_GLYPH];
+}
+
+
+/*
+ * ConsoleFBRingRow --
+ *
+ *    Return a pointer to the first pixel of a text row in video
+ *    memory. Without panning, ring row N is just screen row N.
+ */
+
+static inline uint8 *
+ConsoleFBRingRow(int row)
+{
+   return gConsoleFB.fb + row * CONSOLE_FB_GLYPH_HEIGHT * gConsoleFB.pitch;
+}
+
+
+/*
+ * ConsoleFBShadowRow --
+ *
+ *    Return the shadow buffer's copy of a visible row.
+ */
+
+static inline uint16 *
+ConsoleFBShadowRow(int y)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+   int row = self->shadowTop + y;
+
+   if (row >= self->rows) {
+      row -= self->rows;
+   }
+   return &self->shadow[row * self->columns];
+}
+
+
+/*
+ * ConsoleFBExpandRow --
+ *
+ *    Expand one row of font bits into pixels.
+ */
+
+static fastcall void
+ConsoleFBExpandRow(uint32 *out, uint8 bits, uint8 attr)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+   uint32 fg = self->pixels[attr & 0x0F];
+   uint32 bg = self->pixels[attr >> 4];
+   int i;
+
+   for (i = 0; i < CONSOLE_FB_GLYPH_WIDTH; i++) {
+      uint32 pixel = (bits & (0x80 >> i)) ? fg : bg;
+
+      switch (self->bytesPerPixel) {
+      case 1:
+         ((uint8*) out)[i] = pixel;
+         break;
+      case 2:
+         ((uint16*) out)[i] = pixel;
+         break;
+      default:
+         out[i] = pixel;
+         break;
+      }
+   }
+}
+
+
+/*
+ * ConsoleFBDrawCell --
+ *
+ *    Draw one character cell on the screen, by copying its glyph out
+ *    of the cache. Each cached glyph is expanded for one set of
+ *    colors; if it was last used in different colors, we expand it
+ *    again first.
+ */
+
+static fastcall void
+ConsoleFBDrawCell(int x, int y, uint16 cell)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+   uint8 *dest = ConsoleFBRingRow(self->top + y) +
+                 x * CONSOLE_FB_GLYPH_WIDTH * self->bytesPerPixel;
+   uint8 c = cell & 0xFF;
+   uint8 attr = cell >> 8;
+   uint32 words = self->rowWords;
+   uint32 *glyph = &self->glyphs[c * CONSOLE_FB_GLYPH_HEIGHT * FB_MAX_ROW_WORDS];
+   const uint32 *src = glyph;
+   int row;
+
+   if (self->glyphAttr[c] != (attr | FB_GLYPH_VALID)) {
+      const uint8 *bits = ConsoleFBGlyph(c);
+
+      for (row = 0; row < CONSOLE_FB_GLYPH_HEIGHT; row++) {
+         ConsoleFBExpandRow(glyph + row * words, bits[row], attr);
+      }
+      self->glyphAttr[c] = attr | FB_GLYPH_VALID;
+   }
+
+   for (row = 0; row < CONSOLE_FB_GLYPH_HEIGHT; row++) {
+      uint32 *d = (uint32*) dest;
+      uint32 i;
+
+      for (i = 0; i < words; i++) {
+         d[i] = src[i];
+      }
+      src += words;
+      dest += self->pitch;
+   }
+}
+
+
+/*
+ * ConsoleFBRedraw --
+ *
+ *    Draw the whole screen from the shadow buffer.
+ */
+
+static fastcall void
+ConsoleFBRedraw(void)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+   int x, y;
+
+   for (y = 0; y < self->rows; y++) {
+      uint16 *cells = ConsoleFBShadowRow(y);
+
+      for (x = 0; x < self->columns; x++) {
+         ConsoleFBDrawCell(x, y, cells[x]);
+      }
+   }
+}
+
+
+/*
+ * ConsoleFBFillLines --
+ *
+ *    Fill scanlines, as wide as the text, with the background color.
+ */
+
+static fastcall void
+ConsoleFBFillLines(uint8 *dest, int lines)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+   uint32 pixel = self->pixels[self->attr >> 4];
+   uint32 width = self->columns * CONSOLE_FB_GLYPH_WIDTH;
+
+   while (lines--) {
+      switch (self->bytesPerPixel) {
+      case 1:
+         memset(dest, pixel, width);
+         break;
+      case 2:
+         memset16(dest, pixel, width);
+         break;
+      default:
+         memset32(dest, pixel, width);
+         break;
+      }
+      dest += self->pitch;
+   }
+}
+
+
+/*
+ * ConsoleFBClearRow --
+ *
+ *    Fill a visible row with blanks in the current color, both in the
+ *    shadow buffer and on the screen.
+ */
+
+static fastcall void
+ConsoleFBClearRow(int y)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+
+   memset16(ConsoleFBShadowRow(y), ' ' | (self->attr << 8), self->columns);
+   ConsoleFBFillLines(ConsoleFBRingRow(self->top + y), CONSOLE_FB_GLYPH_HEIGHT);
+}
+
+
+/*
+ * ConsoleFBClearExtraLines --
+ *
+ *    If the screen height isn't a multiple of the glyph height, clear
+ *    the scanlines on the screen below the last text row.
+ */
+
+static fastcall void
+ConsoleFBClearExtraLines(void)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+
+   ConsoleFBFillLines(ConsoleFBRingRow(self->top + self->rows), self->extraLines);
+}
+
+
+/*
+ * ConsoleFBScroll --
+ *
+ *    Scroll up by one line. The shadow buffer is a ring, so that only
+ *    takes a pointer update. When panning, the display moves down one
+ *    text row of video memory at the next flush, and we only redraw
+ *    when we reach the end of it, back at the start of video memory.
+ *    Otherwise, we redraw every time, wherever the display is.
+ */
+
+static fastcall void
+ConsoleFBScroll(void)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+
+   if (++self->shadowTop == self->rows) {
+      self->shadowTop = 0;
+   }
+
+   if (self->pan && self->top < self->maxTop) {
+      self->top++;
+   } else {
+      /*
+       * Only wrap back to the start of video memory when panning.
+       * Otherwise the display start stays where it is, which after
+       * a panic may not be row 0, so redraw in place.
+       */
+      if (self->pan) {
+         self->top = 0;
+      }
+      memset16(ConsoleFBShadowRow(self->rows - 1), ' ' | (self->attr << 8), self->columns);
+      ConsoleFBRedraw();
+      ConsoleFBClearExtraLines();
+      return;
+   }
+
+   ConsoleFBClearRow(self->rows - 1);
+   ConsoleFBClearExtraLines();
+}
+
+
+/*
+ * ConsoleFB_MoveTo --
+ *
+ *    Set the text insertion point.
+ */
+
+fastcall void
+ConsoleFB_MoveTo(int x, int y)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+
+   self->cursor.x = x;
+   self->cursor.y = y;
+}
+
+
+/*
+ * ConsoleFB_Clear --
+ *
+ *    Clear the screen and move the cursor to the home position.
+ */
+
+fastcall void
+ConsoleFB_Clear(void)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+   int y;
+
+   if (!self->fb) {
+      return;
+   }
+
+   ConsoleFB_MoveTo(0, 0);
+
+   self->shadowTop = 0;
+   for (y = 0; y < self->rows; y++) {
+      ConsoleFBClearRow(y);
+   }
+   ConsoleFBClearExtraLines();
+}
+
+
+/*
+ * ConsoleFB_SetColor --
+ * ConsoleFB_SetBgColor --
+ *
+ *    Set the text foreground or background color.
+ */
+
+fastcall void
+ConsoleFB_SetColor(int8 fgColor)
+{
+   gConsoleFB.attr = (gConsoleFB.attr & 0xF0) | fgColor;
+}
+
+fastcall void
+ConsoleFB_SetBgColor(int8 bgColor)
+{
+   gConsoleFB.attr = (gConsoleFB.attr & 0x0F) | (bgColor << 4);
+}
+
+
+/*
+ * ConsoleFB_WriteChar --
+ *
+ *    Write one character, TTY-style. Interprets \n characters.
+ *    Until ConsoleFB_Init() has found a framebuffer, this and the
+ *    other entry points do nothing, which only matters when a static
+ *    console (see console.h) calls them from the start.
+ */
+
+fastcall void
+ConsoleFB_WriteChar(char c)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+
+   if (!self->fb) {
+      return;
+   }
+
+   if (c == '\n') {
+      self->cursor.y++;
+      self->cursor.x = 0;
+
+   } else if (c == '\t') {
+      while (self->cursor.x & 7) {
+         ConsoleFB_WriteChar(' ');
+      }
+
+   } else if (c == '\b') {
+      if (self->cursor.x > 0) {
+         self->cursor.x--;
+         ConsoleFB_WriteChar(' ');
+         self->cursor.x--;
+      }
+
+   } else {
+      uint16 cell = (uint8)c | (self->attr << 8);
+
+      ConsoleFBShadowRow(self->cursor.y)[self->cursor.x] = cell;
+      ConsoleFBDrawCell(self->cursor.x, self->cursor.y, cell);
+      self->cursor.x++;
+   }
+
+   if (self->cursor.x >= self->columns) {
+      self->cursor.x = 0;
+      self->cursor.y++;
+   }
+
+   if (self->cursor.y >= self->rows) {
+      self->cursor.y = self->rows - 1;
+      ConsoleFBScroll();
+   }
+}
+
+
+/*
+ * ConsoleFB_WriteBuffer --
+ *
+ *    Write a run of characters.
+ */
+
+fastcall void
+ConsoleFB_WriteBuffer(const char *buf, uint32 len)
+{
+   while (len--) {
+      ConsoleFB_WriteChar(*(buf++));
+   }
+}
+
+
+/*
+ * ConsoleFB_Flush --
+ *
+ *    If we've panned since the last flush, move the display.
+ */
+
+fastcall void
+ConsoleFB_Flush(void)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+
+   if (self->pan && self->hwTop != self->top) {
+      self->hwTop = self->top;
+      VBE_SetStartAddress(0, self->top * CONSOLE_FB_GLYPH_HEIGHT);
+   }
+}
+
+
+/*
+ * ConsoleFB_BeginPanic --
+ *
+ *    Prepare for a panic: stop panning, so that we don't need the
+ *    BIOS again, and clear whatever part of video memory is on the
+ *    screen right now in the panic colors.
+ */
+
+fastcall void
+ConsoleFB_BeginPanic(void)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+
+   if (!self->fb) {
+      return;
+   }
+
+   self->pan = FALSE;
+   self->top = self->hwTop;
+
+   ConsoleFB_SetColor(VGA_COLOR_WHITE);
+   ConsoleFB_SetBgColor(VGA_COLOR_RED);
+   ConsoleFB_Clear();
+}
+
+
+const ConsoleInterface gConsoleFBInterface = {
+   .beginPanic  = ConsoleFB_BeginPanic,
+   .clear       = ConsoleFB_Clear,
+   .moveTo      = ConsoleFB_MoveTo,
+   .writeChar   = ConsoleFB_WriteChar,
+   .writeBuffer = ConsoleFB_WriteBuffer,
+   .flush       = ConsoleFB_Flush,
+};
+
+
+/*
+ * ConsoleFBFindBIOSFont --
+ *
+ *    Find the VGA BIOS's 8x16 font. INT 10h AX=1130h BH=06h returns
+ *    a real-mode pointer to it, in the video BIOS ROM.
+ */
+
+static fastcall const uint8 *
+ConsoleFBFindBIOSFont(void)
+{
+   Regs reg = {};
+
+   reg.ax = 0x1130;
+   reg.bh = 0x06;
+   BIOS_Call(0x10, &reg);
+
+   return PTR_NEAR_TO_32(reg.es, reg.bp);
+}
+
+
+/*
+ * ConsoleFBColorPixel --
+ *
+ *    Convert a 24-bit RGB color into the current mode's pixel format.
+ *    In 8-bit modes, the first 16 entries of the default palette are
+ *    the VGA text colors, so we just use the color's index.
+ */
+
+static fastcall uint32
+ConsoleFBColorPixel(const VBEModeInfo *info, int index)
+{
+   uint32 rgb = gConsoleFBColors[index];
+
+   if (info->bitsPerPixel == 8) {
+      return index;
+   }
+
+   return ((((rgb >> 16) & 0xFF) >> (8 - info->red.maskSize)) << info->red.fieldPos) |
+          ((((rgb >> 8) & 0xFF) >> (8 - info->green.maskSize)) << info->green.fieldPos) |
+          (((rgb & 0xFF) >> (8 - info->blue.maskSize)) << info->blue.fieldPos);
+}
+
+
+/*
+ * ConsoleFB_Init --
+ *
+ *    Make the framebuffer text console the current console, on the
+ *    VBE mode that's already been set, and clear the screen. Returns
+ *    FALSE, leaving the current console alone, if the mode isn't one
+ *    we can draw on.
+ *
+ *    With CONSOLE_FB_PAN, we scroll by moving the display start
+ *    address through all of video memory past the visible screen.
+ *    Don't use it if something else lives there, like a back buffer.
+ *    With CONSOLE_FB_BIOS_FONT, we draw with the VGA BIOS's font
+ *    instead of our own; that needs a VGA BIOS, and real mode once.
+ *
+ *    The VGA text console, if it's linked in, is unregistered, since
+ *    its memory is no longer on the screen.
+ */
+
+fastcall Bool
+ConsoleFB_Init(uint32 flags)
+{
+   ConsoleFBObject *self = &gConsoleFB;
+   const VBEModeInfo *info = &gVBE.current.info;
+   int i;
+
+   if (!(info->attributes & VBE_MODEATTR_GRAPHICS) || !info->linearAddress ||
+       (info->bitsPerPixel != 8 && info->bitsPerPixel != 15 &&
+        info->bitsPerPixel != 16 && info->bitsPerPixel != 32)) {
+      return FALSE;
+   }
+
+   self->fb = info->linearAddress;
+   self->pitch = info->bytesPerLine;
+   self->bytesPerPixel = (info->bitsPerPixel + 7) / 8;
+   self->rowWords = CONSOLE_FB_GLYPH_WIDTH * self->bytesPerPixel / sizeof(uint32);
+   self->columns = MIN(info->width / CONSOLE_FB_GLYPH_WIDTH, CONSOLE_FB_MAX_COLUMNS);
+   self->rows = MIN(info->height / CONSOLE_FB_GLYPH_HEIGHT, CONSOLE_FB_MAX_ROWS);
+   self->top = 0;
+   self->hwTop = 0;
+   memset(self->glyphAttr, 0, sizeof self->glyphAttr);
+
+   self->extraLines = info->height - self->rows * CONSOLE_FB_GLYPH_HEIGHT;
+
+   /*
+    * The display start moves in whole text rows, and the whole
+    * screen, including any extra scanlines, must stay inside video
+    * memory.
+    */
+   self->maxTop = 0;
+   self->pan = FALSE;
+   if (flags & CONSOLE_FB_PAN) {
+      uint32 memoryLines = ((uint32)gVBE.cInfo.totalMemory << 16) / self->pitch;
+
+      if (memoryLines > info->height) {
+         self->maxTop = MIN((memoryLines - info->height) / CONSOLE_FB_GLYPH_HEIGHT, 0x7FFF);
+      }
+      self->pan = self->maxTop > 0;
+   }
+
+   for (i = 0; i < arraysize(self->pixels); i++) {
+      self->pixels[i] = ConsoleFBColorPixel(info, i);
+   }
+
+   self->biosFont = (flags & CONSOLE_FB_BIOS_FONT) ? ConsoleFBFindBIOSFont() : NULL;
+
+   if (&gConsoleVGAInterface) {
+      Console_RemoveBackend(&gConsoleVGAInterface);
+   }
+   gConsole = gConsoleFBInterface;
+   Console_AddBackend(&gConsole);
+
+   ConsoleFB_SetColor(VGA_COLOR_WHITE);
+   ConsoleFB_SetBgColor(VGA_COLOR_BLUE);
+   ConsoleFB_Clear();
+
+   return TRUE;
+}
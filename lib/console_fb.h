@@ -0,0 +1,78 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * console_fb.h - Text console on a VBE linear framebuffer
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CONSOLE_FB_H__
+#define __CONSOLE_FB_H__
+
+#include "types.h"
+#include "console.h"
+
+/*
+ * A text console for VBE graphics modes, so logging and panics stay
+ * visible after VBE_SetMode() or BGA_SetMode(). It draws 8x16 glyphs
+ * from a built-in ASCII font onto gVBE.current's linear framebuffer,
+ * in 8, 16 or 32 bits per pixel, with no BIOS calls. Colors are the
+ * 16 VGA text colors (VGA_COLOR_* in console_vga.h).
+ *
+ * Glyphs are cached pre-expanded into the framebuffer's pixel format,
+ * each in the colors it was last drawn in, so drawing a character is
+ * usually just 16 rows of two to eight 32-bit stores. The framebuffer
+ * is never read: the screen's characters are also kept in a shadow
+ * buffer, and scrolling either redraws from that, or with
+ * CONSOLE_FB_PAN, pans the display down through spare video memory
+ * and only redraws when it runs out.
+ *
+ * There's no cursor.
+ */
+
+#define CONSOLE_FB_GLYPH_WIDTH   8
+#define CONSOLE_FB_GLYPH_HEIGHT  16
+#define CONSOLE_FB_MAX_COLUMNS   256     // Up to 2048 pixels wide
+#define CONSOLE_FB_MAX_ROWS      96      // Up to 1536 pixels tall
+
+#define CONSOLE_FB_PAN           (1 << 0)  // Scroll with VBE_SetStartAddress()
+#define CONSOLE_FB_BIOS_FONT     (1 << 1)  // Use the VGA BIOS's 256-glyph font
+
+extern const ConsoleInterface gConsoleFBInterface;
+
+fastcall Bool ConsoleFB_Init(uint32 flags);
+fastcall void ConsoleFB_SetColor(int8 fgColor);
+fastcall void ConsoleFB_SetBgColor(int8 bgColor);
+
+fastcall void ConsoleFB_BeginPanic(void);
+fastcall void ConsoleFB_Clear(void);
+fastcall void ConsoleFB_MoveTo(int x, int y);
+fastcall void ConsoleFB_WriteChar(char c);
+fastcall void ConsoleFB_WriteBuffer(const char *buf, uint32 len);
+fastcall void ConsoleFB_Flush(void);
+
+#endif /* __CONSOLE_FB_H__ */
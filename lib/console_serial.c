@@ -0,0 +1,506 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * console_serial.c - Console driver for 16550-compatible serial ports.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "console_serial.h"
+#include "io.h"
+#include "intr.h"
+
+/*
+ * UART registers, as offsets from the I/O base.
+ */
+
+#define UART_THR         0     // Transmit holding register (write)
+#define UART_IER         1     // Interrupt enable
+#define UART_IIR         2     // Interrupt identification (read)
+#define UART_FCR         2     // FIFO control (write)
+#define UART_LCR         3     // Line control
+#define UART_MCR         4     // Modem control
+#define UART_LSR         5     // Line status
+#define UART_DLL         0     // Divisor latch, when DLAB is set
+#define UART_DLM         1
+
+#define UART_IER_THRI    (1 << 1)
+#define UART_IIR_NO_INT  (1 << 0)
+#define UART_IIR_FIFO    0xC0
+#define UART_FCR_ENABLE  0x07  // Enable and reset both FIFOs
+#define UART_FCR_TRIG14  0xC0
+#define UART_LCR_8N1     0x03
+#define UART_LCR_DLAB    0x80
+#define UART_MCR_DTR     (1 << 0)
+#define UART_MCR_RTS     (1 << 1)
+#define UART_MCR_OUT2    (1 << 3)  // Gates the UART's IRQ line on PCs
+#define UART_LSR_THRE    (1 << 5)
+
+#define UART_FIFO_SIZE   16
+
+typedef struct {
+   uint16 iobase;
+   uint8 fifoSize;
+   Bool polled;                  // Write directly to the UART, bypassing the ring
+   Bool txActive;                // THRE interrupt is enabled
+   volatile uint32 head;         // Next byte to write (producer)
+   volatile uint32 tail;         // Next byte to transmit (consumer)
+   uint8 ring[SERIAL_TX_RING_SIZE];
+} ConsoleSerialObject;
+
+ConsoleSerialObject gConsoleSerial[1];
+
+
+/*
+ * ConsoleSerialPutPolled --
+ *
+ *    Spin until the transmitter is ready, and send one byte.
+ */
+
+static fastcall void
+ConsoleSerialPutPolled(uint8 byte)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+
+   while (!(IO_In8(self->iobase + UART_LSR) & UART_LSR_THRE));
+   IO_Out8(self->iobase + UART_THR, byte);
+}
+
+
+/*
+ * ConsoleSerialFillFIFO --
+ *
+ *    Move bytes from the ring into the UART's transmit FIFO. Must
+ *    only be called when THRE is set, meaning the FIFO is empty.
+ *    Returns FALSE if the ring is now empty.
+ */
+
+static fastcall Bool
+ConsoleSerialFillFIFO(void)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+   uint32 tail = self->tail;
+   int n = self->fifoSize;
+
+   while (n-- && tail != self->head) {
+      IO_Out8(self->iobase + UART_THR, self->ring[tail & (SERIAL_TX_RING_SIZE - 1)]);
+      tail++;
+   }
+   self->tail = tail;
+
+   return tail != self->head;
+}
+
+
+/*
+ * ConsoleSerialDrainPolled --
+ *
+ *    Synchronously transmit everything in the ring. Used when we
+ *    can't wait for an interrupt.
+ */
+
+static fastcall void
+ConsoleSerialDrainPolled(void)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+
+   while (self->tail != self->head) {
+      while (!(IO_In8(self->iobase + UART_LSR) & UART_LSR_THRE));
+      ConsoleSerialFillFIFO();
+   }
+}
+
+
+/*
+ * ConsoleSerialIRQ --
+ *
+ *    THRE interrupt handler. Refill the FIFO from the ring, and turn
+ *    the interrupt off once there's nothing left to send.
+ */
+
+static void
+ConsoleSerialIRQ(int vector)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+
+   /* Reading IIR acknowledges the THRE interrupt. */
+   if (IO_In8(self->iobase + UART_IIR) & UART_IIR_NO_INT) {
+      return;
+   }
+
+   if (!ConsoleSerialFillFIFO()) {
+      IO_Out8(self->iobase + UART_IER, 0);
+      self->txActive = FALSE;
+   }
+}
+
+
+/*
+ * ConsoleSerialWaitForSpace --
+ *
+ *    Wait until the ring has room for the byte at 'head'.
+ *
+ *    If the ring is full and interrupts are off (we might be in an
+ *    interrupt handler, or in a critical section) nothing would ever
+ *    drain it, so we drain it ourselves by polling.
+ */
+
+static fastcall void
+ConsoleSerialWaitForSpace(uint32 head)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+
+   while (head - self->tail >= SERIAL_TX_RING_SIZE) {
+      if (Intr_Save()) {
+         Intr_Halt();
+      } else {
+         ConsoleSerialDrainPolled();
+      }
+   }
+}
+
+
+/*
+ * ConsoleSerialPublish --
+ *
+ *    Make every byte stored in the ring up to 'head' visible to the
+ *    transmitter. We only touch the UART when the transmitter goes
+ *    from idle to busy.
+ *
+ *    Publishing and checking txActive must be atomic with respect to
+ *    the IRQ handler, or it could turn the interrupt off just after
+ *    we decided it was still on.
+ */
+
+static fastcall void
+ConsoleSerialPublish(uint32 head)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+   Bool iFlag;
+
+   iFlag = Intr_Save();
+   Intr_Disable();
+   self->head = head;
+   if (!self->txActive) {
+      self->txActive = TRUE;
+      IO_Out8(self->iobase + UART_IER, UART_IER_THRI);
+   }
+   Intr_Restore(iFlag);
+}
+
+
+/*
+ * ConsoleSerialPut --
+ *
+ *    Queue one raw byte for transmission. In the common case this is
+ *    just a store into the ring.
+ *
+ *    Until ConsoleSerial_Init() runs, there's no UART to drain the
+ *    ring, so output is dropped. That can happen when the backend is
+ *    built in with CONSOLE_BACKENDS.
+ */
+
+static fastcall void
+ConsoleSerialPut(uint8 byte)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+   uint32 head = self->head;
+
+   if (!self->iobase) {
+      return;
+   }
+   if (self->polled) {
+      ConsoleSerialPutPolled(byte);
+      return;
+   }
+
+   ConsoleSerialWaitForSpace(head);
+   self->ring[head & (SERIAL_TX_RING_SIZE - 1)] = byte;
+   ConsoleSerialPublish(head + 1);
+}
+
+
+/*
+ * ConsoleSerialPutString --
+ *
+ *    Queue a NUL-terminated string of raw bytes.
+ */
+
+static fastcall void
+ConsoleSerialPutString(const char *str)
+{
+   char c;
+   while ((c = *(str++))) {
+      ConsoleSerialPut(c);
+   }
+}
+
+
+/*
+ * ConsoleSerialPutDec --
+ *
+ *    Queue a small decimal number, for ANSI escape sequences.
+ */
+
+static fastcall void
+ConsoleSerialPutDec(uint32 num)
+{
+   if (num >= 10) {
+      ConsoleSerialPutDec(num / 10);
+   }
+   ConsoleSerialPut('0' + num % 10);
+}
+
+
+/*
+ * ConsoleSerial_WriteChar --
+ *
+ *    Write one character, translating newlines for the terminal.
+ */
+
+fastcall void
+ConsoleSerial_WriteChar(char c)
+{
+   if (c == '\n') {
+      ConsoleSerialPut('\r');
+   }
+   ConsoleSerialPut(c);
+}
+
+
+/*
+ * ConsoleSerialStore --
+ *
+ *    Store one byte at 'head' without publishing it. If the ring is
+ *    full, publish what we have so far and wait for room. Returns
+ *    the new head.
+ */
+
+static inline uint32
+ConsoleSerialStore(uint32 head, uint8 byte)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+
+   if (head - self->tail >= SERIAL_TX_RING_SIZE) {
+      ConsoleSerialPublish(head);
+      ConsoleSerialWaitForSpace(head);
+   }
+
+   self->ring[head & (SERIAL_TX_RING_SIZE - 1)] = byte;
+   return head + 1;
+}
+
+
+/*
+ * ConsoleSerial_WriteBuffer --
+ *
+ *    Write a run of characters. Bytes are stored into the ring
+ *    privately and published once at the end, so a whole string
+ *    costs one critical section instead of one per byte.
+ */
+
+fastcall void
+ConsoleSerial_WriteBuffer(const char *buf, uint32 len)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+   uint32 head = self->head;
+
+   if (!self->iobase) {
+      return;
+   }
+   if (self->polled) {
+      while (len--) {
+         if (*buf == '\n') {
+            ConsoleSerialPutPolled('\r');
+         }
+         ConsoleSerialPutPolled(*(buf++));
+      }
+      return;
+   }
+
+   while (len--) {
+      char c = *(buf++);
+      if (c == '\n') {
+         head = ConsoleSerialStore(head, '\r');
+      }
+      head = ConsoleSerialStore(head, c);
+   }
+
+   if (head != self->head) {
+      ConsoleSerialPublish(head);
+   }
+}
+
+
+/*
+ * ConsoleSerial_MoveTo --
+ * ConsoleSerial_Clear --
+ *
+ *    Cursor positioning and screen clearing, via ANSI escape codes.
+ */
+
+fastcall void
+ConsoleSerial_MoveTo(int x, int y)
+{
+   ConsoleSerialPutString("\033[");
+   ConsoleSerialPutDec(y + 1);
+   ConsoleSerialPut(';');
+   ConsoleSerialPutDec(x + 1);
+   ConsoleSerialPut('H');
+}
+
+fastcall void
+ConsoleSerial_Clear(void)
+{
+   ConsoleSerialPutString("\033[2J\033[H");
+}
+
+
+/*
+ * ConsoleSerial_Flush --
+ *
+ *    Nothing to do; the ring drains by itself as long as interrupts
+ *    are enabled. Anything still queued when a panic begins is sent
+ *    by ConsoleSerial_BeginPanic.
+ */
+
+fastcall void
+ConsoleSerial_Flush(void)
+{
+}
+
+
+/*
+ * ConsoleSerial_BeginPanic --
+ *
+ *    Interrupts are about to go away for good. Push out everything
+ *    that's already queued, then switch to polled output. Does
+ *    nothing before ConsoleSerial_Init().
+ */
+
+fastcall void
+ConsoleSerial_BeginPanic(void)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+
+   if (!self->iobase) {
+      return;
+   }
+
+   Intr_Disable();
+   IO_Out8(self->iobase + UART_IER, 0);
+   self->txActive = FALSE;
+
+   ConsoleSerialDrainPolled();
+   self->polled = TRUE;
+
+   ConsoleSerialPutString("\r\n\r\n");
+}
+
+
+/*
+ * ConsoleSerial_SetBaud --
+ *
+ *    Change the line rate. The UART's divisor is relative to its
+ *    maximum rate of 115200 baud. Rates the divisor can't express
+ *    (zero, above the maximum, or below 2 baud) are ignored.
+ */
+
+fastcall void
+ConsoleSerial_SetBaud(uint32 baud)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+   uint32 divisor;
+
+   if (!self->iobase || baud == 0 || baud > SERIAL_MAX_BAUD) {
+      return;
+   }
+   divisor = SERIAL_MAX_BAUD / baud;
+   if (divisor > 0xFFFF) {
+      return;
+   }
+
+   IO_Out8(self->iobase + UART_LCR, UART_LCR_8N1 | UART_LCR_DLAB);
+   IO_Out8(self->iobase + UART_DLL, divisor & 0xFF);
+   IO_Out8(self->iobase + UART_DLM, divisor >> 8);
+   IO_Out8(self->iobase + UART_LCR, UART_LCR_8N1);
+}
+
+
+const ConsoleInterface gConsoleSerialInterface = {
+   .beginPanic  = ConsoleSerial_BeginPanic,
+   .clear       = ConsoleSerial_Clear,
+   .moveTo      = ConsoleSerial_MoveTo,
+   .writeChar   = ConsoleSerial_WriteChar,
+   .writeBuffer = ConsoleSerial_WriteBuffer,
+   .flush       = ConsoleSerial_Flush,
+};
+
+
+/*
+ * ConsoleSerial_Init --
+ *
+ *    Set up a 16550 UART at 'ioBase' for 8N1 output at 'baud', and
+ *    make it the current console driver. Output is queued in a ring
+ *    and transmitted from the UART's THRE interrupt on 'irq', so this
+ *    must be called after Intr_Init.
+ */
+
+fastcall void
+ConsoleSerial_Init(uint16 ioBase, uint8 irq, uint32 baud)
+{
+   ConsoleSerialObject *self = gConsoleSerial;
+
+   self->iobase = ioBase;
+   self->head = self->tail = 0;
+   self->polled = FALSE;
+   self->txActive = FALSE;
+
+   IO_Out8(ioBase + UART_IER, 0);
+   ConsoleSerial_SetBaud(baud);
+   IO_Out8(ioBase + UART_FCR, UART_FCR_ENABLE | UART_FCR_TRIG14);
+   IO_Out8(ioBase + UART_MCR, UART_MCR_DTR | UART_MCR_RTS | UART_MCR_OUT2);
+
+   /*
+    * An 8250 or 16450 has no FIFO, so we can only write one byte per
+    * THRE interrupt.
+    */
+   if ((IO_In8(ioBase + UART_IIR) & UART_IIR_FIFO) == UART_IIR_FIFO) {
+      self->fifoSize = UART_FIFO_SIZE;
+   } else {
+      self->fifoSize = 1;
+   }
+
+   Intr_SetHandler(IRQ_VECTOR(irq), ConsoleSerialIRQ);
+   Intr_SetMask(irq, TRUE);
+
+   gConsole = gConsoleSerialInterface;
+   Console_AddBackend(&gConsole);
+
+   ConsoleSerial_Clear();
+}
@@ -0,0 +1,63 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * console_serial.h - Console driver for 16550-compatible serial ports.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CONSOLE_SERIAL_H__
+#define __CONSOLE_SERIAL_H__
+
+#include "types.h"
+#include "console.h"
+
+#define SERIAL_COM1_IOBASE     0x3F8
+#define SERIAL_COM1_IRQ        4
+#define SERIAL_COM2_IOBASE     0x2F8
+#define SERIAL_COM2_IRQ        3
+
+#define SERIAL_MAX_BAUD        115200
+
+/*
+ * Size of the transmit ring, in bytes. Must be a power of two.
+ * When the ring fills up, writers wait for the UART to catch up.
+ */
+#define SERIAL_TX_RING_SIZE    4096
+
+extern const ConsoleInterface gConsoleSerialInterface;
+
+fastcall void ConsoleSerial_Init(uint16 ioBase, uint8 irq, uint32 baud);
+fastcall void ConsoleSerial_SetBaud(uint32 baud);
+fastcall void ConsoleSerial_BeginPanic(void);
+fastcall void ConsoleSerial_Clear(void);
+fastcall void ConsoleSerial_MoveTo(int x, int y);
+fastcall void ConsoleSerial_WriteChar(char c);
+fastcall void ConsoleSerial_WriteBuffer(const char *buf, uint32 len);
+fastcall void ConsoleSerial_Flush(void);
+
+#endif /* __CONSOLE_SERIAL_H__ */
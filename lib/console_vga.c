@@ -36,7 +36,23 @@
 #include "intr.h"
 
 #define VGA_TEXT_FRAMEBUFFER     ((uint8*)0xB8000)
+#define VGA_TEXT_MEMORY_SIZE     0x8000
+#define VGA_TEXT_PITCH           (VGA_TEXT_WIDTH * 2)
 
+/*
+ * We scroll in hardware, by treating text memory as a ring of rows
+ * and moving the CRTC's start address down by one row per scroll.
+ * The last screenful of text memory is held back as an overlay page,
+ * which the console never writes to; everything before it is the
+ * ring.
+ */
+#define VGA_TEXT_RING_ROWS       (VGA_TEXT_MEMORY_SIZE / VGA_TEXT_PITCH - \
+                                  VGA_TEXT_HEIGHT)
+#define VGA_TEXT_OVERLAY         (VGA_TEXT_FRAMEBUFFER + \
+                                  VGA_TEXT_RING_ROWS * VGA_TEXT_PITCH)
+
+#define VGA_CRTCREG_START_HIGH       0x0C
+#define VGA_CRTCREG_START_LOW        0x0D
 #define VGA_CRTCREG_CURSOR_LOC_HIGH  0x0E
 #define VGA_CRTCREG_CURSOR_LOC_LOW   0x0F
 
@@ -46,6 +62,9 @@ typedef struct {
       int8 x, y;
    } cursor;
    int8 attr;
+   int16 top;         // Ring row currently at the top of the screen
+   int16 hwTop;       // Value of 'top' last written to the CRTC
+   Bool overlay;      // Showing the overlay page instead of the console
 } ConsoleVGAObject;
 
 ConsoleVGAObject gConsoleVGA[1];
@@ -54,29 +73,84 @@ ConsoleVGAObject gConsoleVGA[1];
 /*
  * ConsoleVGAWriteCRTC --
  *
- *    Write to a VGA CRT Control register.
+ *    Write to a VGA CRT Control register. The index/data pair is
+ *    written with interrupts off, since the overlay page may be
+ *    switched from an IRQ handler.
  */
 
 static fastcall void
 ConsoleVGAWriteCRTC(uint8 addr, uint8 value)
 {
    ConsoleVGAObject *self = gConsoleVGA;
+   Bool iFlag = Intr_Save();
+
+   Intr_Disable();
    IO_Out8(self->crtc_iobase, addr);
    IO_Out8(self->crtc_iobase + 1, value);
+   Intr_Restore(iFlag);
+}
+
+
+/*
+ * ConsoleVGASetStart --
+ *
+ *    Point the CRTC's start address at a text memory cell.
+ */
+
+static fastcall void
+ConsoleVGASetStart(uint16 start)
+{
+   ConsoleVGAWriteCRTC(VGA_CRTCREG_START_LOW, start & 0xFF);
+   ConsoleVGAWriteCRTC(VGA_CRTCREG_START_HIGH, start >> 8);
+}
+
+
+/*
+ * ConsoleVGARow --
+ *
+ *    Return a pointer to the first cell of a visible row.
+ */
+
+static inline uint8 *
+ConsoleVGARow(int y)
+{
+   return VGA_TEXT_FRAMEBUFFER + (gConsoleVGA->top + y) * VGA_TEXT_PITCH;
 }
 
 
 /*
- * ConsoleVGAMoveHardwareCursor --
+ * ConsoleVGAClearRow --
  *
- *    Set the hardware cursor to the current cursor position.
+ *    Fill a visible row with blanks in the current color.
  */
 
 static fastcall void
-ConsoleVGAMoveHardwareCursor(void)
+ConsoleVGAClearRow(int y)
+{
+   memset16(ConsoleVGARow(y), ' ' | ((uint8)gConsoleVGA->attr << 8), VGA_TEXT_WIDTH);
+}
+
+
+/*
+ * ConsoleVGA_Flush --
+ *
+ *    Set the hardware cursor to the current cursor position, and
+ *    update the CRTC start address if we've scrolled since the
+ *    last time. While the overlay page is shown the start address
+ *    is left alone; the cursor then lies outside the displayed
+ *    page and is invisible.
+ */
+
+fastcall void
+ConsoleVGA_Flush(void)
 {
    ConsoleVGAObject *self = gConsoleVGA;
-   uint16 loc = self->cursor.x + self->cursor.y * VGA_TEXT_WIDTH;
+   uint16 loc = self->cursor.x + (self->cursor.y + self->top) * VGA_TEXT_WIDTH;
+
+   if (self->hwTop != self->top && !self->overlay) {
+      self->hwTop = self->top;
+      ConsoleVGASetStart(self->top * VGA_TEXT_WIDTH);
+   }
 
    ConsoleVGAWriteCRTC(VGA_CRTCREG_CURSOR_LOC_LOW, loc & 0xFF);
    ConsoleVGAWriteCRTC(VGA_CRTCREG_CURSOR_LOC_HIGH, loc >> 8);
@@ -84,14 +158,41 @@ ConsoleVGAMoveHardwareCursor(void)
 
 
 /*
- * ConsoleVGAMoveTo --
+ * ConsoleVGAScroll --
+ *
+ *    Scroll up by one line. Normally this just advances 'top' and
+ *    clears the newly exposed line; the new start address goes to
+ *    the CRTC at the next flush. Only when we reach the end of text
+ *    memory do we copy the screen back to the beginning, once every
+ *    VGA_TEXT_RING_ROWS - VGA_TEXT_HEIGHT lines.
+ */
+
+static fastcall void
+ConsoleVGAScroll(void)
+{
+   ConsoleVGAObject *self = gConsoleVGA;
+
+   self->top++;
+
+   if (self->top + VGA_TEXT_HEIGHT > VGA_TEXT_RING_ROWS) {
+      memcpy32(VGA_TEXT_FRAMEBUFFER, ConsoleVGARow(0),
+               VGA_TEXT_PITCH * (VGA_TEXT_HEIGHT - 1) / sizeof(uint32));
+      self->top = 0;
+   }
+
+   ConsoleVGAClearRow(VGA_TEXT_HEIGHT - 1);
+}
+
+
+/*
+ * ConsoleVGA_MoveTo --
  *
  *    Set the text insertion point. This will move the hardware cursor
  *    at the next Console_Flush(). 
  */
 
-static fastcall void
-ConsoleVGAMoveTo(int x, int y)
+fastcall void
+ConsoleVGA_MoveTo(int x, int y)
 {
    ConsoleVGAObject *self = gConsoleVGA;
 
@@ -106,22 +207,16 @@ ConsoleVGAMoveTo(int x, int y)
  *    Clear the screen and move the cursor to the home position.
  */
 
-static fastcall void
-ConsoleVGAClear(void)
+fastcall void
+ConsoleVGA_Clear(void)
 {
    ConsoleVGAObject *self = gConsoleVGA;
-   uint8 *fb = VGA_TEXT_FRAMEBUFFER;
-   int i, j;
 
-   ConsoleVGAMoveTo(0, 0);
+   ConsoleVGA_MoveTo(0, 0);
 
-   for (j = 0; j < VGA_TEXT_HEIGHT; j++) {
-      for (i = 0; i < VGA_TEXT_WIDTH; i++) {
-         fb[0] = ' ';
-         fb[1] = self->attr;
-         fb += 2;
-      }
-   }
+   self->top = 0;
+   memset16(VGA_TEXT_FRAMEBUFFER, ' ' | ((uint8)self->attr << 8),
+            VGA_TEXT_WIDTH * VGA_TEXT_HEIGHT);
 }
 
 
@@ -158,16 +253,15 @@ ConsoleVGA_SetBgColor(int8 bgColor)
 
 
 /*
- * ConsoleVGAWriteChar --
+ * ConsoleVGA_WriteChar --
  *
  *    Write one character, TTY-style. Interprets \n characters.
  */
 
-static fastcall void
-ConsoleVGAWriteChar(char c)
+fastcall void
+ConsoleVGA_WriteChar(char c)
 {
    ConsoleVGAObject *self = gConsoleVGA;
-   uint8 *fb = VGA_TEXT_FRAMEBUFFER;
 
    if (c == '\n') {
       self->cursor.y++;
@@ -175,18 +269,18 @@ ConsoleVGAWriteChar(char c)
 
    } else if (c == '\t') {
       while (self->cursor.x & 7) {
-         ConsoleVGAWriteChar(' ');
+         ConsoleVGA_WriteChar(' ');
       }
 
    } else if (c == '\b') {
       if (self->cursor.x > 0) {
          self->cursor.x--;
-         ConsoleVGAWriteChar(' ');
+         ConsoleVGA_WriteChar(' ');
          self->cursor.x--;
       }
 
    } else {
-      fb += self->cursor.x * 2 + self->cursor.y * VGA_TEXT_WIDTH * 2;
+      uint8 *fb = ConsoleVGARow(self->cursor.y) + self->cursor.x * 2;
       fb[0] = c;
       fb[1] = self->attr;
       self->cursor.x++;
@@ -198,40 +292,116 @@ ConsoleVGAWriteChar(char c)
    }
 
    if (self->cursor.y >= VGA_TEXT_HEIGHT) {
-      int i;
-      uint8 *fb = VGA_TEXT_FRAMEBUFFER;
-      const uint32 scrollSize = VGA_TEXT_WIDTH * 2 * (VGA_TEXT_HEIGHT - 1);
-
       self->cursor.y = VGA_TEXT_HEIGHT - 1;
+      ConsoleVGAScroll();
+   }
+}
+
+
+/*
+ * ConsoleVGA_WriteBuffer --
+ *
+ *    Write a run of characters. Printable characters go straight
+ *    into the current row; anything that moves the cursor to a new
+ *    line goes through ConsoleVGA_WriteChar.
+ */
+
+fastcall void
+ConsoleVGA_WriteBuffer(const char *buf, uint32 len)
+{
+   ConsoleVGAObject *self = gConsoleVGA;
+
+   while (len) {
+      uint8 *fb = ConsoleVGARow(self->cursor.y) + self->cursor.x * 2;
+      int x = self->cursor.x;
+      uint8 attr = self->attr;
+      char c;
 
-      memcpy(fb, fb + VGA_TEXT_WIDTH * 2, scrollSize);
-      fb += scrollSize;
-      for (i = 0; i < VGA_TEXT_WIDTH; i++) {
-         fb[0] = ' ';
-         fb[1] = self->attr;
+      while (len && x < VGA_TEXT_WIDTH - 1 && (c = *buf) >= ' ') {
+         fb[0] = c;
+         fb[1] = attr;
          fb += 2;
+         x++;
+         buf++;
+         len--;
+      }
+      self->cursor.x = x;
+
+      if (len) {
+         ConsoleVGA_WriteChar(*(buf++));
+         len--;
       }
    }
 }
 
 
 /*
- * ConsoleVGABeginPanic --
+ * ConsoleVGA_BeginPanic --
  *
  *    Prepare for a panic in VGA mode: Set up the panic colors,
  *    and clear the screen.
  */
 
-static fastcall void
-ConsoleVGABeginPanic(void)
+fastcall void
+ConsoleVGA_BeginPanic(void)
 {
    ConsoleVGA_SetColor(VGA_COLOR_WHITE);
    ConsoleVGA_SetBgColor(VGA_COLOR_RED);
-   ConsoleVGAClear();
-   ConsoleVGAMoveHardwareCursor();
+   ConsoleVGA_Clear();
+   ConsoleVGA_Flush();
 }
 
 
+/*
+ * ConsoleVGA_GetOverlay --
+ *
+ *    Return the overlay page: VGA_TEXT_WIDTH x VGA_TEXT_HEIGHT cells
+ *    of character/attribute pairs that the console never touches.
+ *    Callers may draw into it at any time, shown or not.
+ */
+
+fastcall uint16 *
+ConsoleVGA_GetOverlay(void)
+{
+   return (uint16*) VGA_TEXT_OVERLAY;
+}
+
+
+/*
+ * ConsoleVGA_ShowOverlay --
+ *
+ *    Switch the display between the console and the overlay page.
+ *    The console keeps running underneath, and reappears exactly as
+ *    it was when the overlay is hidden. Safe to call from an IRQ
+ *    handler.
+ */
+
+fastcall void
+ConsoleVGA_ShowOverlay(Bool show)
+{
+   ConsoleVGAObject *self = gConsoleVGA;
+
+   self->overlay = show;
+   self->hwTop = -1;
+
+   if (show) {
+      ConsoleVGASetStart(VGA_TEXT_RING_ROWS * VGA_TEXT_WIDTH);
+   } else {
+      ConsoleVGA_Flush();
+   }
+}
+
+
+const ConsoleInterface gConsoleVGAInterface = {
+   .beginPanic  = ConsoleVGA_BeginPanic,
+   .clear       = ConsoleVGA_Clear,
+   .moveTo      = ConsoleVGA_MoveTo,
+   .writeChar   = ConsoleVGA_WriteChar,
+   .writeBuffer = ConsoleVGA_WriteBuffer,
+   .flush       = ConsoleVGA_Flush,
+};
+
+
 /*
  * ConsoleVGA_Init --
  *
@@ -255,15 +425,13 @@ ConsoleVGA_Init(void)
       self->crtc_iobase = 0x3B4;
    }
 
-   gConsole.beginPanic = ConsoleVGABeginPanic;
-   gConsole.clear = ConsoleVGAClear;
-   gConsole.moveTo = ConsoleVGAMoveTo;
-   gConsole.writeChar = ConsoleVGAWriteChar;
-   gConsole.flush = ConsoleVGAMoveHardwareCursor;
+   gConsole = gConsoleVGAInterface;
+   Console_AddBackend(&gConsole);
 
    ConsoleVGA_SetColor(VGA_COLOR_WHITE);
    ConsoleVGA_SetBgColor(VGA_COLOR_BLUE);
 
-   ConsoleVGAClear();
-   ConsoleVGAMoveHardwareCursor();
+   self->hwTop = -1;
+   ConsoleVGA_Clear();
+   ConsoleVGA_Flush();
 }
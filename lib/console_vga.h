@@ -56,8 +56,18 @@
 #define VGA_TEXT_WIDTH           80
 #define VGA_TEXT_HEIGHT          25
 
+extern const ConsoleInterface gConsoleVGAInterface;
+
 fastcall void ConsoleVGA_Init(void);
+fastcall void ConsoleVGA_BeginPanic(void);
+fastcall void ConsoleVGA_Clear(void);
+fastcall void ConsoleVGA_MoveTo(int x, int y);
+fastcall void ConsoleVGA_WriteChar(char c);
+fastcall void ConsoleVGA_WriteBuffer(const char *buf, uint32 len);
+fastcall void ConsoleVGA_Flush(void);
 fastcall void ConsoleVGA_SetColor(int8 fgColor);
 fastcall void ConsoleVGA_SetBgColor(int8 bgColor);
+fastcall uint16 *ConsoleVGA_GetOverlay(void);
+fastcall void ConsoleVGA_ShowOverlay(Bool show);
 
 #endif /* __CONSOLE_VGA_H__ */
@@ -0,0 +1,161 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * cpu.h - CPU identification, timestamp counter, and MSR access.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CPU_H__
+#define __CPU_H__
+
+#include "types.h"
+
+/*
+ * CPUID feature bits that the rest of the library cares about.
+ */
+
+#define CPUID_1_EDX_TSC               (1 << 4)
+#define CPUID_1_EDX_MSR               (1 << 5)
+#define CPUID_1_EDX_APIC              (1 << 9)
+#define CPUID_1_EDX_FXSR              (1 << 24)
+#define CPUID_1_EDX_SSE               (1 << 25)
+#define CPUID_1_EDX_SSE2              (1 << 26)
+#define CPUID_1_ECX_TSC_DEADLINE      (1 << 24)
+#define CPUID_80000001_EDX_RDTSCP     (1 << 27)
+#define CPUID_80000007_EDX_INVARIANT  (1 << 8)
+
+typedef struct CPUIDRegs {
+   uint32 eax, ebx, ecx, edx;
+} CPUIDRegs;
+
+
+/*
+ * CPU_GetID --
+ *
+ *    Execute CPUID for one leaf (with a sub-leaf of zero). As a side
+ *    effect, this is also a fully serializing instruction.
+ */
+
+static inline void
+CPU_GetID(uint32 leaf, CPUIDRegs *regs)
+{
+   asm volatile ("cpuid"
+                 : "=a" (regs->eax), "=b" (regs->ebx), "=c" (regs->ecx), "=d" (regs->edx)
+                 : "a" (leaf), "c" (0));
+}
+
+
+/*
+ * CPU_ReadTSC --
+ *
+ *    Read the 64-bit timestamp counter. This is not a serializing
+ *    instruction; the CPU may execute it out of order with respect
+ *    to nearby code.
+ */
+
+static inline uint64
+CPU_ReadTSC(void)
+{
+   uint64 tsc;
+   asm volatile ("rdtsc" : "=A" (tsc));
+   return tsc;
+}
+
+
+/*
+ * CPU_ReadMSR --
+ * CPU_WriteMSR --
+ *
+ *    Access a 64-bit model-specific register.
+ */
+
+static inline uint64
+CPU_ReadMSR(uint32 msr)
+{
+   uint64 value;
+   asm volatile ("rdmsr" : "=A" (value) : "c" (msr));
+   return value;
+}
+
+static inline void
+CPU_WriteMSR(uint32 msr, uint64 value)
+{
+   asm volatile ("wrmsr" :: "A" (value), "c" (msr));
+}
+
+
+/*
+ * CPU_Pause --
+ *
+ *    Spin-loop hint. This is a no-op on CPUs older than the P4.
+ */
+
+static inline void
+CPU_Pause(void)
+{
+   asm volatile ("pause");
+}
+
+
+/*
+ * CPU_EnableSSE --
+ *
+ *    Let SSE instructions use the XMM registers. The boot code leaves
+ *    CR4.OSFXSR clear, so until this is called they fault with #UD.
+ *    Returns FALSE if the CPU has no SSE2.
+ *
+ *    Nothing saves XMM state across interrupts or thread switches,
+ *    and the library is compiled without SSE code generation. Only
+ *    hand-written code that owns the XMM registers should use them.
+ */
+
+static inline Bool
+CPU_EnableSSE(void)
+{
+   const uint32 required = CPUID_1_EDX_FXSR | CPUID_1_EDX_SSE | CPUID_1_EDX_SSE2;
+   CPUIDRegs id;
+   uint32 cr;
+
+   CPU_GetID(1, &id);
+   if ((id.edx & required) != required) {
+      return FALSE;
+   }
+
+   asm volatile ("movl %%cr0, %0" : "=r" (cr));
+   cr &= ~(1 << 2);             // CR0.EM: No x87/SSE emulation
+   cr |= 1 << 1;                // CR0.MP
+   asm volatile ("movl %0, %%cr0" :: "r" (cr));
+
+   asm volatile ("movl %%cr4, %0" : "=r" (cr));
+   cr |= (1 << 9) | (1 << 10);  // CR4.OSFXSR, CR4.OSXMMEXCPT
+   asm volatile ("movl %0, %%cr4" :: "r" (cr));
+
+   return TRUE;
+}
+
+#endif /* __CPU_H__ */
@@ -0,0 +1,121 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * debugport.c - Raw output to the emulator debug port.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "debugport.h"
+#include "io.h"
+
+
+/*
+ * DebugPort_Present --
+ *
+ *    Emulators that implement the debug port return 0xE9 when it's
+ *    read. Anything else means writes will be discarded.
+ */
+
+fastcall Bool
+DebugPort_Present(void)
+{
+   return IO_In8(DEBUGPORT_IO) == DEBUGPORT_IO;
+}
+
+
+/*
+ * DebugPort_Write --
+ *
+ *    Write a buffer of raw bytes, with one string I/O instruction.
+ */
+
+fastcall void
+DebugPort_Write(const void *buf, uint32 len)
+{
+   asm volatile ("cld; rep outsb"
+                 : "+c" (len), "+S" (buf)
+                 : "d" (DEBUGPORT_IO)
+                 : "memory");
+}
+
+
+/*
+ * DebugPort_WriteString --
+ *
+ *    Write a NUL-terminated string.
+ */
+
+fastcall void
+DebugPort_WriteString(const char *str)
+{
+   const char *end = str;
+
+   while (*end) {
+      end++;
+   }
+   DebugPort_Write(str, end - str);
+}
+
+
+/*
+ * DebugPort_WriteDec --
+ * DebugPort_WriteHex --
+ *
+ *    Write an unsigned integer in decimal (with no padding), or in
+ *    lowercase hexadecimal with exactly 'digits' digits (up to 8).
+ */
+
+fastcall void
+DebugPort_WriteDec(uint32 num)
+{
+   char buf[10];
+   char *p = buf + sizeof buf;
+
+   do {
+      *(--p) = '0' + num % 10;
+      num /= 10;
+   } while (num);
+
+   DebugPort_Write(p, buf + sizeof buf - p);
+}
+
+fastcall void
+DebugPort_WriteHex(uint32 num, int digits)
+{
+   static const char hexDigits[] = "0123456789abcdef";
+   char buf[8];
+   int i;
+
+   digits = MIN(digits, sizeof buf);
+   for (i = digits - 1; i >= 0; i--) {
+      buf[i] = hexDigits[num & 0xF];
+      num >>= 4;
+   }
+
+   DebugPort_Write(buf, digits);
+}
@@ -0,0 +1,57 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * debugport.h - Raw output to the emulator debug port.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DEBUGPORT_H__
+#define __DEBUGPORT_H__
+
+#include "types.h"
+
+/*
+ * Bochs and QEMU both have a "port E9 hack": every byte written to
+ * I/O port 0xE9 is copied to the emulator's console or to a file. In
+ * QEMU, enable it with "-debugcon file:debug.txt" or "-debugcon stdio".
+ *
+ * This is a convenient channel for machine-readable output (benchmark
+ * results, trace and profile dumps) that a host script can collect,
+ * independent of whatever console the app is using. On real hardware
+ * the writes go nowhere.
+ */
+
+#define DEBUGPORT_IO   0xE9
+
+fastcall Bool DebugPort_Present(void);
+fastcall void DebugPort_Write(const void *buf, uint32 len);
+fastcall void DebugPort_WriteString(const char *str);
+fastcall void DebugPort_WriteDec(uint32 num);
+fastcall void DebugPort_WriteHex(uint32 num, int digits);
+
+#endif /* __DEBUGPORT_H__ */
@@ -0,0 +1,311 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * display.c - Vertical retrace synchronization and frame pacing.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "display.h"
+#include "vbe.h"
+#include "lapic.h"
+#include "clock.h"
+#include "io.h"
+#include "stats.h"
+
+/*
+ * Don't bother halting for less than this; spin instead. It also
+ * keeps us from arming a one-shot timer with a zero count, which
+ * would never fire.
+ */
+#define DISPLAY_MIN_SLEEP_NS   50000
+
+STAT_HISTOGRAM(gDisplayFrameStat, "display.frame_us");
+STAT_COUNTER(gDisplayMissedStat, "display.missed_frames");
+
+static Bool gDisplayNoRetrace;
+
+
+/*
+ * Display_WaitRetrace --
+ *
+ *    Poll the VGA input status register for the start of the next
+ *    vertical retrace. We wait for any retrace in progress to end
+ *    first, so that the caller gets the whole blanking interval.
+ *    Returns FALSE if we can't tell when that is.
+ *
+ *    If the status register doesn't toggle within
+ *    DISPLAY_VBLANK_MAX_POLLS reads, we give up on it for good, and
+ *    later calls return FALSE immediately. Native display drivers
+ *    use this too, so they share that latch.
+ */
+
+fastcall Bool
+Display_WaitRetrace(void)
+{
+   uint32 polls = 0;
+
+   if (gDisplayNoRetrace) {
+      return FALSE;
+   }
+
+   while (IO_In8(VGA_INPUT_STATUS_1) & VGA_INPUT_STATUS_1_VRETRACE) {
+      if (++polls == DISPLAY_VBLANK_MAX_POLLS) {
+         goto timeout;
+      }
+   }
+   while (!(IO_In8(VGA_INPUT_STATUS_1) & VGA_INPUT_STATUS_1_VRETRACE)) {
+      if (++polls == DISPLAY_VBLANK_MAX_POLLS) {
+         goto timeout;
+      }
+   }
+   return TRUE;
+
+timeout:
+   gDisplayNoRetrace = TRUE;
+   return FALSE;
+}
+
+
+/*
+ * Display_WaitVBlank --
+ *
+ *    Wait for the start of the next vertical retrace. Returns FALSE
+ *    if we can't tell when that is.
+ *
+ *    In VGA-compatible modes, including text modes, we poll the VGA
+ *    input status register with Display_WaitRetrace(). In other VBE
+ *    modes the register may never change, so we ask the BIOS to wait
+ *    for us instead (VBE 2.0 and later).
+ */
+
+fastcall Bool
+Display_WaitVBlank(void)
+{
+   if (gVBE.current.mode && (gVBE.current.info.attributes & VBE_MODEATTR_NONVGA)) {
+      if (gVBE.cInfo.verMajor < 2) {
+         return FALSE;
+      }
+      VBE_WaitVBlank();
+      return TRUE;
+   }
+
+   return Display_WaitRetrace();
+}
+
+
+/*
+ * DisplayWakeHandler --
+ *
+ *    The pacer's timer interrupt. Its only job is to end a hlt.
+ */
+
+static void
+DisplayWakeHandler(int vector)
+{
+   LAPIC_EOI();
+}
+
+
+/*
+ * DisplaySleepUntil --
+ *
+ *    Wait until the TSC reaches 'tsc'. With a local APIC we halt
+ *    until a timer deadline; other interrupts may wake us early, so
+ *    we check the time and go back to sleep. Interrupts are disabled
+ *    while the timer is armed, and "sti; hlt" can't be interrupted
+ *    in between, so a wakeup can't slip past us.
+ */
+
+static fastcall void
+DisplaySleepUntil(uint64 tsc)
+{
+   const uint64 minSleep = Clock_NanosToCycles(DISPLAY_MIN_SLEEP_NS);
+   Bool iFlag = Intr_Save();
+
+   while (1) {
+      uint64 now;
+
+      Intr_Disable();
+      now = Clock_Cycles();
+      if (now >= tsc) {
+         break;
+      }
+
+      if (gLAPIC.regs && tsc - now >= minSleep) {
+         LAPIC_TimerDeadline(DISPLAY_WAKE_VECTOR, tsc);
+         asm volatile ("sti; hlt");
+      } else {
+         Intr_Restore(iFlag);
+         CPU_Pause();
+      }
+   }
+
+   Intr_Restore(iFlag);
+}
+
+
+/*
+ * Display_InitPacer --
+ *
+ *    Set up a pacer for 'hz' frames per second. The first deadline
+ *    is one period from now. Requires Clock_Init(), and Intr_Init()
+ *    if the local APIC is to be used.
+ */
+
+fastcall void
+Display_InitPacer(DisplayPacer *pacer, uint32 hz, uint32 flags)
+{
+   memset(pacer, 0, sizeof *pacer);
+
+   pacer->period = gClock.tscHz / hz;
+   pacer->flags = flags;
+   pacer->lastFrame = Clock_Cycles();
+   pacer->deadline = pacer->lastFrame + pacer->period;
+
+   if (gLAPIC.regs) {
+      Intr_SetHandler(DISPLAY_WAKE_VECTOR, DisplayWakeHandler);
+   }
+}
+
+
+/*
+ * DisplayRecordFrame --
+ *
+ *    Add one frame time to the pacer's statistics.
+ */
+
+static fastcall void
+DisplayRecordFrame(DisplayPacer *pacer, uint64 cycles)
+{
+   uint32 micros = Clock_CyclesToNanos(cycles) / 1000;
+
+   pacer->frames++;
+   pacer->totalCycles += cycles;
+   pacer->maxCycles = MAX(pacer->maxCycles, cycles);
+   pacer->bins[MIN(micros / DISPLAY_PACER_BIN_US, DISPLAY_PACER_BINS - 1)]++;
+
+   Stat_Sample(&gDisplayFrameStat, micros);
+}
+
+
+/*
+ * Display_PaceFrame --
+ *
+ *    Call once per frame, when it has been drawn and is ready to be
+ *    shown. Returns at the frame's deadline (or, with
+ *    DISPLAY_PACER_VBLANK, at the start of vertical retrace near
+ *    it), and the caller should show the frame right away.
+ *
+ *    If the frame took so long that one or more deadlines already
+ *    passed, those count as missed, and we return as soon as the
+ *    next deadline comes. The timestep stays fixed; we don't try to
+ *    catch up.
+ */
+
+fastcall void
+Display_PaceFrame(DisplayPacer *pacer)
+{
+   uint64 now = Clock_Cycles();
+
+   if (now > pacer->deadline) {
+      uint32 missed = (now - pacer->deadline) / pacer->period + 1;
+
+      pacer->missed += missed;
+      pacer->deadline += (uint64) missed * pacer->period;
+      Stat_Add(&gDisplayMissedStat, missed);
+   }
+
+   if (pacer->flags & DISPLAY_PACER_VBLANK) {
+      uint64 margin = Clock_NanosToCycles(DISPLAY_PACER_VBLANK_MARGIN);
+
+      DisplaySleepUntil(pacer->deadline - MIN(margin, pacer->period / 2));
+      if (Display_WaitVBlank()) {
+         pacer->deadline = Clock_Cycles();
+      } else {
+         DisplaySleepUntil(pacer->deadline);
+      }
+   } else {
+      DisplaySleepUntil(pacer->deadline);
+   }
+
+   now = Clock_Cycles();
+   DisplayRecordFrame(pacer, now - pacer->lastFrame);
+   pacer->lastFrame = now;
+   pacer->deadline += pacer->period;
+}
+
+
+/*
+ * Display_GetPacerStats --
+ *
+ *    Summarize frame times since the pacer was set up or its stats
+ *    were reset.
+ */
+
+fastcall void
+Display_GetPacerStats(const DisplayPacer *pacer, DisplayPacerStats *stats)
+{
+   uint32 threshold = pacer->frames - pacer->frames / 100;
+   uint32 count = 0;
+   int i;
+
+   memset(stats, 0, sizeof *stats);
+   stats->frames = pacer->frames;
+   stats->missed = pacer->missed;
+   if (!pacer->frames) {
+      return;
+   }
+
+   stats->avgMicros = Clock_CyclesToNanos(pacer->totalCycles / pacer->frames) / 1000;
+   stats->maxMicros = Clock_CyclesToNanos(pacer->maxCycles) / 1000;
+
+   for (i = 0; i < DISPLAY_PACER_BINS; i++) {
+      count += pacer->bins[i];
+      if (count >= threshold) {
+         break;
+      }
+   }
+   stats->p99Micros = MIN((i + 1) * DISPLAY_PACER_BIN_US, stats->maxMicros);
+}
+
+
+/*
+ * Display_ResetPacerStats --
+ *
+ *    Start a new measurement interval. Deadlines are unaffected.
+ */
+
+fastcall void
+Display_ResetPacerStats(DisplayPacer *pacer)
+{
+   pacer->frames = 0;
+   pacer->missed = 0;
+   pacer->totalCycles = 0;
+   pacer->maxCycles = 0;
+   memset32(pacer->bins, 0, DISPLAY_PACER_BINS);
+}
@@ -0,0 +1,105 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * display.h - Vertical retrace synchronization and frame pacing.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DISPLAY_H__
+#define __DISPLAY_H__
+
+#include "types.h"
+#include "intr.h"
+
+#define VGA_INPUT_STATUS_1            0x3DA
+#define VGA_INPUT_STATUS_1_VRETRACE   (1 << 3)
+
+/*
+ * How many times to read the VGA status register before deciding
+ * that retrace will never come. That's a few hundred milliseconds
+ * on real hardware, where each read is an ISA bus cycle.
+ */
+#define DISPLAY_VBLANK_MAX_POLLS      (1 << 20)
+
+/*
+ * A frame pacer runs a render loop at a fixed rate. Each call to
+ * Display_PaceFrame() waits for the next frame's deadline, halting
+ * the CPU instead of spinning when it can.
+ *
+ * To sleep, the pacer needs to wake itself: it sets a local APIC
+ * timer deadline on DISPLAY_WAKE_VECTOR, and takes over the local
+ * APIC timer. Without a local APIC (LAPIC_Init() not called, or
+ * failed) it busy-waits.
+ *
+ * With DISPLAY_PACER_VBLANK, the pacer sleeps until just before the
+ * deadline, then waits for vertical retrace, and the deadlines after
+ * that follow the display's own timing.
+ *
+ * Frame times, from one return of Display_PaceFrame() to the next,
+ * go into a histogram with DISPLAY_PACER_BIN_US bins. A deadline we
+ * were already past when the frame was done counts as missed.
+ */
+
+#define DISPLAY_WAKE_VECTOR           USER_VECTOR(15)
+
+#define DISPLAY_PACER_VBLANK          (1 << 0)
+#define DISPLAY_PACER_VBLANK_MARGIN   2000000      // ns before the deadline
+#define DISPLAY_PACER_BINS            256
+#define DISPLAY_PACER_BIN_US          250          // Covers 0 to 64 ms
+
+typedef struct {
+   uint64       period;          // TSC cycles per frame
+   uint64       deadline;        // TSC value when the next frame is due
+   uint64       lastFrame;       // TSC value at the last return
+   uint32       flags;
+
+   /* Statistics */
+   uint32       frames;
+   uint32       missed;
+   uint64       totalCycles;
+   uint64       maxCycles;
+   uint32       bins[DISPLAY_PACER_BINS];
+} DisplayPacer;
+
+typedef struct {
+   uint32       frames;
+   uint32       missed;
+   uint32       avgMicros;
+   uint32       p99Micros;       // Rounded up to the histogram's resolution
+   uint32       maxMicros;
+} DisplayPacerStats;
+
+fastcall Bool Display_WaitVBlank(void);
+fastcall Bool Display_WaitRetrace(void);
+
+fastcall void Display_InitPacer(DisplayPacer *pacer, uint32 hz, uint32 flags);
+fastcall void Display_PaceFrame(DisplayPacer *pacer);
+fastcall void Display_GetPacerStats(const DisplayPacer *pacer, DisplayPacerStats *stats);
+fastcall void Display_ResetPacerStats(DisplayPacer *pacer);
+
+#endif /* __DISPLAY_H__ */
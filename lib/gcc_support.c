@@ -46,3 +46,70 @@ memset(void *dest, unsigned char value, unsigned long size)
 {
    asm volatile ("cld; rep stosb" : "+c" (size), "+D" (dest) : "a" (value) : "memory");
 }
+
+/*
+ * 64-bit division --
+ *
+ *    GCC doesn't have an inline expansion for 64-bit division on
+ *    IA32; it always calls these libgcc helpers. We don't link with
+ *    libgcc, so provide simple versions here. When the divisor fits
+ *    in 32 bits (the common case) this is two hardware divides,
+ *    otherwise it falls back to binary long division.
+ *
+ *    These are slow compared to multiplication, so keep them out of
+ *    hot paths.
+ */
+
+unsigned long long
+__udivmoddi4(unsigned long long num, unsigned long long den,
+             unsigned long long *remOut)
+{
+   unsigned long long quot = 0;
+
+   if ((den >> 32) == 0) {
+      unsigned long numHigh = num >> 32;
+      unsigned long numLow = num;
+      unsigned long quotHigh = numHigh / (unsigned long)den;
+      unsigned long quotLow, rem = numHigh % (unsigned long)den;
+
+      asm ("divl %4" : "=a" (quotLow), "=d" (rem)
+           : "a" (numLow), "d" (rem), "rm" ((unsigned long)den));
+
+      quot = ((unsigned long long)quotHigh << 32) | quotLow;
+      num = rem;
+
+   } else {
+      if (num >= den) {
+         int shift = __builtin_clzll(den) - __builtin_clzll(num);
+
+         den <<= shift;
+         while (shift-- >= 0) {
+            quot <<= 1;
+            if (num >= den) {
+               num -= den;
+               quot |= 1;
+            }
+            den >>= 1;
+         }
+      }
+   }
+
+   if (remOut) {
+      *remOut = num;
+   }
+   return quot;
+}
+
+unsigned long long
+__udivdi3(unsigned long long num, unsigned long long den)
+{
+   return __udivmoddi4(num, den, 0);
+}
+
+unsigned long long
+__umoddi3(unsigned long long num, unsigned long long den)
+{
+   unsigned long long rem;
+   __udivmoddi4(num, den, &rem);
+   return rem;
+}
@@ -0,0 +1,772 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * gfx.c - Software 2D rasterization for linear framebuffers.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "gfx.h"
+#include "vbe.h"
+#include "cpu.h"
+
+GfxState gGfx;
+
+/*
+ * A blit, after clipping: the destination rectangle and the source
+ * pixel that lands on its top-left corner.
+ */
+
+typedef struct {
+   int x, y;
+   int srcX, srcY;
+   int width, height;
+} GfxBlitRect;
+
+
+/*
+ * Gfx_Init --
+ *
+ *    Enable the SSE2 fast paths, if the CPU has SSE2. Surfaces can be
+ *    drawn to without calling this; they just use the slow paths.
+ */
+
+fastcall void
+Gfx_Init(void)
+{
+   gGfx.sse2 = CPU_EnableSSE();
+}
+
+
+/*
+ * Gfx_InitSurface --
+ *
+ *    Describe a block of pixels in memory. The clip rectangle starts
+ *    out as the whole surface. Returns FALSE if the pixel format
+ *    isn't supported, or the pixels or pitch aren't pixel-aligned.
+ */
+
+fastcall Bool
+Gfx_InitSurface(GfxSurface *surface, void *pixels, int width, int height,
+                uint32 pitch, uint32 bitsPerPixel)
+{
+   uint32 bytesPerPixel;
+
+   switch (bitsPerPixel) {
+   case 8:
+      bytesPerPixel = 1;
+      break;
+   case 15:
+   case 16:
+      bytesPerPixel = 2;
+      break;
+   case 32:
+      bytesPerPixel = 4;
+      break;
+   default:
+      return FALSE;
+   }
+
+   if ((((uint32) pixels) | pitch) & (bytesPerPixel - 1)) {
+      return FALSE;
+   }
+
+   surface->pixels = pixels;
+   surface->pitch = pitch;
+   surface->width = width;
+   surface->height = height;
+   surface->bitsPerPixel = bitsPerPixel;
+   surface->bytesPerPixel = bytesPerPixel;
+   Gfx_SetClip(surface, 0, 0, width, height);
+
+   return TRUE;
+}
+
+
+/*
+ * Gfx_InitVBESurface --
+ *
+ *    Describe a full-screen buffer in the current VBE mode's format:
+ *    the visible framebuffer if 'pixels' is NULL, or a page from a
+ *    VBESurface.
+ */
+
+fastcall Bool
+Gfx_InitVBESurface(GfxSurface *surface, void *pixels)
+{
+   VBEModeInfo *info = &gVBE.current.info;
+
+   return Gfx_InitSurface(surface, pixels ? pixels : info->linearAddress,
+                          info->width, info->height,
+                          info->bytesPerLine, info->bitsPerPixel);
+}
+
+
+/*
+ * Gfx_SetClip --
+ *
+ *    Restrict drawing to a rectangle within the surface.
+ */
+
+fastcall void
+Gfx_SetClip(GfxSurface *surface, int x, int y, int width, int height)
+{
+   surface->clip.x0 = MAX(x, 0);
+   surface->clip.y0 = MAX(y, 0);
+   surface->clip.x1 = MAX(surface->clip.x0, MIN(x + width, surface->width));
+   surface->clip.y1 = MAX(surface->clip.y0, MIN(y + height, surface->height));
+}
+
+
+/*
+ * GfxClipBlit --
+ *
+ *    Clip a blit to the source surface's bounds and the destination's
+ *    clip rectangle. Returns FALSE if nothing is left.
+ */
+
+static fastcall Bool
+GfxClipBlit(const GfxSurface *dest, const GfxSurface *src, GfxBlitRect *r)
+{
+   int d;
+
+   if (r->srcX < 0) {
+      r->x -= r->srcX;
+      r->width += r->srcX;
+      r->srcX = 0;
+   }
+   if (r->srcY < 0) {
+      r->y -= r->srcY;
+      r->height += r->srcY;
+      r->srcY = 0;
+   }
+   r->width = MIN(r->width, src->width - r->srcX);
+   r->height = MIN(r->height, src->height - r->srcY);
+
+   d = dest->clip.x0 - r->x;
+   if (d > 0) {
+      r->x += d;
+      r->srcX += d;
+      r->width -= d;
+   }
+   d = dest->clip.y0 - r->y;
+   if (d > 0) {
+      r->y += d;
+      r->srcY += d;
+      r->height -= d;
+   }
+   r->width = MIN(r->width, dest->clip.x1 - r->x);
+   r->height = MIN(r->height, dest->clip.y1 - r->y);
+
+   return r->width > 0 && r->height > 0;
+}
+
+
+/*
+ * GfxPattern --
+ *
+ *    Replicate a pixel value to fill 32 bits.
+ */
+
+static inline uint32
+GfxPattern(const GfxSurface *surface, uint32 color)
+{
+   switch (surface->bytesPerPixel) {
+   case 1:
+      return (color & 0xFF) * 0x01010101;
+   case 2:
+      return (color & 0xFFFF) * 0x00010001;
+   default:
+      return color;
+   }
+}
+
+
+/*
+ * GfxFillSpan --
+ *
+ *    Fill bytes with a replicated pixel pattern. 'dest' must be
+ *    pixel-aligned, which makes any byte's value depend only on its
+ *    address modulo 4.
+ */
+
+static fastcall void
+GfxFillSpan(uint8 *dest, uint32 bytes, uint32 pattern)
+{
+   uint32 blocks;
+
+   while ((((uint32) dest) & 3) && bytes) {
+      *dest = pattern >> (8 * (((uint32) dest) & 3));
+      dest++;
+      bytes--;
+   }
+
+   if (gGfx.sse2 && bytes >= 128) {
+      while (((uint32) dest) & 15) {
+         *(uint32*) dest = pattern;
+         dest += 4;
+         bytes -= 4;
+      }
+
+      blocks = bytes / 64;
+      asm volatile ("movd %2, %%xmm0 \n"
+                    "pshufd $0, %%xmm0, %%xmm0 \n"
+                    "1: \n"
+                    "movdqa %%xmm0,   (%0) \n"
+                    "movdqa %%xmm0, 16(%0) \n"
+                    "movdqa %%xmm0, 32(%0) \n"
+                    "movdqa %%xmm0, 48(%0) \n"
+                    "addl $64, %0 \n"
+                    "decl %1 \n"
+                    "jnz 1b \n"
+                    : "+r" (dest), "+r" (blocks) : "r" (pattern) : "memory");
+      bytes &= 63;
+   }
+
+   memset32(dest, pattern, bytes >> 2);
+   dest += bytes & ~3;
+   bytes &= 3;
+
+   while (bytes--) {
+      *dest = pattern >> (8 * (((uint32) dest) & 3));
+      dest++;
+   }
+}
+
+
+/*
+ * GfxCopySpan --
+ *
+ *    Copy bytes, front to back.
+ */
+
+static fastcall void
+GfxCopySpan(uint8 *dest, const uint8 *src, uint32 bytes)
+{
+   uint32 blocks;
+
+   if (gGfx.sse2 && bytes >= 128) {
+      uint32 head = -(uint32) dest & 15;
+
+      memcpy(dest, src, head);
+      dest += head;
+      src += head;
+      bytes -= head;
+
+      blocks = bytes / 64;
+      asm volatile ("1: \n"
+                    "movdqu   (%1), %%xmm0 \n"
+                    "movdqu 16(%1), %%xmm1 \n"
+                    "movdqu 32(%1), %%xmm2 \n"
+                    "movdqu 48(%1), %%xmm3 \n"
+                    "movdqa %%xmm0,   (%0) \n"
+                    "movdqa %%xmm1, 16(%0) \n"
+                    "movdqa %%xmm2, 32(%0) \n"
+                    "movdqa %%xmm3, 48(%0) \n"
+                    "addl $64, %1 \n"
+                    "addl $64, %0 \n"
+                    "decl %2 \n"
+                    "jnz 1b \n"
+                    : "+r" (dest), "+r" (src), "+r" (blocks) :: "memory");
+      bytes &= 63;
+   }
+
+   memcpy32(dest, src, bytes >> 2);
+   memcpy(dest + (bytes & ~3), src + (bytes & ~3), bytes & 3);
+}
+
+
+/*
+ * GfxCopySpanBackward --
+ *
+ *    Copy bytes, back to front, for a blit that overlaps itself on
+ *    the same scanline with the destination to the right. Each dword
+ *    is read before anything below it is written, so this is safe
+ *    for any overlap. We don't use "std; rep movsb": an interrupt
+ *    handler would run with the direction flag set.
+ */
+
+static fastcall void
+GfxCopySpanBackward(uint8 *dest, const uint8 *src, uint32 bytes)
+{
+   uint32 head = bytes & 3;
+
+   while (bytes > head) {
+      bytes -= 4;
+      *(uint32*) (dest + bytes) = *(const uint32*) (src + bytes);
+   }
+   while (bytes--) {
+      dest[bytes] = src[bytes];
+   }
+}
+
+
+/*
+ * Gfx_FillRect --
+ *
+ *    Fill a rectangle with a solid color.
+ */
+
+fastcall void
+Gfx_FillRect(GfxSurface *surface, int x, int y, int width, int height, uint32 color)
+{
+   const uint32 pattern = GfxPattern(surface, color);
+   int x1 = MIN(x + width, surface->clip.x1);
+   int y1 = MIN(y + height, surface->clip.y1);
+   uint8 *row;
+   uint32 bytes;
+
+   x = MAX(x, surface->clip.x0);
+   y = MAX(y, surface->clip.y0);
+   if (x >= x1 || y >= y1) {
+      return;
+   }
+
+   row = Gfx_PixelAddress(surface, x, y);
+   bytes = (x1 - x) * surface->bytesPerPixel;
+
+   while (y++ < y1) {
+      GfxFillSpan(row, bytes, pattern);
+      row += surface->pitch;
+   }
+}
+
+
+/*
+ * Gfx_Line --
+ *
+ *    Draw a line between two points, both inclusive, with
+ *    Bresenham's algorithm. Horizontal and vertical lines are
+ *    rectangle fills. Pixels are only clip-tested when an endpoint
+ *    lies outside the clip rectangle.
+ */
+
+fastcall void
+Gfx_Line(GfxSurface *surface, int x0, int y0, int x1, int y1, uint32 color)
+{
+   const GfxRect *clip = &surface->clip;
+   const int bpp = surface->bytesPerPixel;
+   int dx = x1 - x0, dy = y1 - y0;
+   int sx = 1, sy = 1;
+   int stepX, stepY, err, e2;
+   Bool inside;
+   uint8 *p;
+
+   if (dx < 0) {
+      dx = -dx;
+      sx = -1;
+   }
+   if (dy < 0) {
+      dy = -dy;
+      sy = -1;
+   }
+
+   if (dy == 0) {
+      Gfx_FillRect(surface, MIN(x0, x1), y0, dx + 1, 1, color);
+      return;
+   }
+   if (dx == 0) {
+      Gfx_FillRect(surface, x0, MIN(y0, y1), 1, dy + 1, color);
+      return;
+   }
+
+   inside = (x0 >= clip->x0 && x0 < clip->x1 && y0 >= clip->y0 && y0 < clip->y1 &&
+             x1 >= clip->x0 && x1 < clip->x1 && y1 >= clip->y0 && y1 < clip->y1);
+
+   p = Gfx_PixelAddress(surface, x0, y0);
+   stepX = sx * bpp;
+   stepY = sy * (int) surface->pitch;
+   err = dx - dy;
+
+   while (1) {
+      if (inside || (x0 >= clip->x0 && x0 < clip->x1 &&
+                     y0 >= clip->y0 && y0 < clip->y1)) {
+         switch (bpp) {
+         case 1:
+            *p = color;
+            break;
+         case 2:
+            *(uint16*) p = color;
+            break;
+         default:
+            *(uint32*) p = color;
+            break;
+         }
+      }
+
+      if (x0 == x1 && y0 == y1) {
+         break;
+      }
+
+      e2 = 2 * err;
+      if (e2 > -dy) {
+         err -= dy;
+         x0 += sx;
+         p += stepX;
+      }
+      if (e2 < dx) {
+         err += dx;
+         y0 += sy;
+         p += stepY;
+      }
+   }
+}
+
+
+/*
+ * Gfx_Blit --
+ *
+ *    Copy a rectangle between two surfaces with the same pixel size.
+ *    The source and destination may be the same surface, or share a
+ *    buffer with the same pitch, and may overlap, as when scrolling.
+ */
+
+fastcall void
+Gfx_Blit(GfxSurface *dest, int x, int y,
+         const GfxSurface *src, int srcX, int srcY, int width, int height)
+{
+   GfxBlitRect r = { x, y, srcX, srcY, width, height };
+   int destPitch = dest->pitch, srcPitch = src->pitch;
+   uint8 *destRow;
+   const uint8 *srcRow;
+   uint32 bytes;
+   Bool overlap;
+
+   if (dest->bytesPerPixel != src->bytesPerPixel || !GfxClipBlit(dest, src, &r)) {
+      return;
+   }
+
+   destRow = Gfx_PixelAddress(dest, r.x, r.y);
+   srcRow = Gfx_PixelAddress(src, r.srcX, r.srcY);
+   bytes = r.width * dest->bytesPerPixel;
+
+   /*
+    * If the two rectangles' memory overlaps and the destination is
+    * higher, copy bottom to top, so no source row is overwritten
+    * before it's read. Rows that overlap themselves copy backwards.
+    */
+   overlap = destRow < srcRow + (r.height - 1) * srcPitch + bytes &&
+             srcRow < destRow + (r.height - 1) * destPitch + bytes &&
+             destRow > srcRow;
+
+   if (overlap) {
+      destRow += (r.height - 1) * destPitch;
+      srcRow += (r.height - 1) * srcPitch;
+      destPitch = -destPitch;
+      srcPitch = -srcPitch;
+   }
+
+   if (overlap && destRow < srcRow + bytes) {
+      while (r.height--) {
+         GfxCopySpanBackward(destRow, srcRow, bytes);
+         destRow += destPitch;
+         srcRow += srcPitch;
+      }
+   } else {
+      while (r.height--) {
+         GfxCopySpan(destRow, srcRow, bytes);
+         destRow += destPitch;
+         srcRow += srcPitch;
+      }
+   }
+}
+
+
+/*
+ * GfxKeyedSpan --
+ *
+ *    Copy every pixel in a span except those equal to the color key.
+ *    With SSE2, 16 bytes at a time are compared with the replicated
+ *    key, and the result is used as a mask to merge source and
+ *    destination.
+ */
+
+#define GFX_KEYED_LOOP(pcmpeq)                          \
+   asm volatile ("movd %3, %%xmm7 \n"                   \
+                 "pshufd $0, %%xmm7, %%xmm7 \n"         \
+                 "1: \n"                                \
+                 "movdqu (%1), %%xmm0 \n"               \
+                 "movdqu (%0), %%xmm1 \n"               \
+                 "movdqa %%xmm0, %%xmm2 \n"             \
+                 pcmpeq " %%xmm7, %%xmm2 \n"            \
+                 "pand %%xmm2, %%xmm1 \n"               \
+                 "pandn %%xmm0, %%xmm2 \n"              \
+                 "por %%xmm2, %%xmm1 \n"                \
+                 "movdqu %%xmm1, (%0) \n"               \
+                 "addl $16, %1 \n"                      \
+                 "addl $16, %0 \n"                      \
+                 "decl %2 \n"                           \
+                 "jnz 1b \n"                            \
+                 : "+r" (dest), "+r" (src), "+r" (blocks)  \
+                 : "r" (keyPattern) : "memory")
+
+static fastcall void
+GfxKeyedSpan(uint8 *dest, const uint8 *src, uint32 bytes, uint32 bpp, uint32 keyPattern)
+{
+   if (gGfx.sse2 && bytes >= 16) {
+      uint32 blocks = bytes / 16;
+
+      switch (bpp) {
+      case 1:
+         GFX_KEYED_LOOP("pcmpeqb");
+         break;
+      case 2:
+         GFX_KEYED_LOOP("pcmpeqw");
+         break;
+      default:
+         GFX_KEYED_LOOP("pcmpeqd");
+         break;
+      }
+      bytes &= 15;
+   }
+
+   switch (bpp) {
+   case 1:
+      for (; bytes; bytes--, dest++, src++) {
+         if (*src != (uint8) keyPattern) {
+            *dest = *src;
+         }
+      }
+      break;
+   case 2:
+      for (; bytes; bytes -= 2, dest += 2, src += 2) {
+         if (*(uint16*) src != (uint16) keyPattern) {
+            *(uint16*) dest = *(uint16*) src;
+         }
+      }
+      break;
+   default:
+      for (; bytes; bytes -= 4, dest += 4, src += 4) {
+         if (*(uint32*) src != keyPattern) {
+            *(uint32*) dest = *(uint32*) src;
+         }
+      }
+      break;
+   }
+}
+
+
+/*
+ * Gfx_BlitKeyed --
+ *
+ *    Copy a rectangle between two surfaces with the same pixel size,
+ *    skipping source pixels equal to 'key'. The rectangles must not
+ *    overlap.
+ */
+
+fastcall void
+Gfx_BlitKeyed(GfxSurface *dest, int x, int y,
+              const GfxSurface *src, int srcX, int srcY, int width, int height,
+              uint32 key)
+{
+   GfxBlitRect r = { x, y, srcX, srcY, width, height };
+   const uint32 keyPattern = GfxPattern(src, key);
+   uint8 *destRow;
+   const uint8 *srcRow;
+   uint32 bytes;
+
+   if (dest->bytesPerPixel != src->bytesPerPixel || !GfxClipBlit(dest, src, &r)) {
+      return;
+   }
+
+   destRow = Gfx_PixelAddress(dest, r.x, r.y);
+   srcRow = Gfx_PixelAddress(src, r.srcX, r.srcY);
+   bytes = r.width * dest->bytesPerPixel;
+
+   while (r.height--) {
+      GfxKeyedSpan(destRow, srcRow, bytes, dest->bytesPerPixel, keyPattern);
+      destRow += dest->pitch;
+      srcRow += src->pitch;
+   }
+}
+
+
+/*
+ * GfxBlend32 --
+ *
+ *    Blend one ARGB pixel over another. All four channels are
+ *    computed as (s * a + d * (256 - a)) >> 8, with the alpha scaled
+ *    from 0-255 to 0-256 so that 255 is fully opaque. Red and blue
+ *    are done in one multiply, alpha and green in another.
+ */
+
+static inline uint32
+GfxBlend32(uint32 s, uint32 d)
+{
+   uint32 a = s >> 24;
+   uint32 rb, ag;
+
+   a += a >> 7;
+   rb = ((s & 0x00FF00FF) * a + (d & 0x00FF00FF) * (256 - a)) >> 8;
+   ag = ((s >> 8) & 0x00FF00FF) * a + ((d >> 8) & 0x00FF00FF) * (256 - a);
+
+   return (rb & 0x00FF00FF) | (ag & 0xFF00FF00);
+}
+
+
+/*
+ * GfxBlend16 --
+ *
+ *    Blend one ARGB pixel over a 5:6:5 or 5:5:5 pixel.
+ */
+
+static inline uint16
+GfxBlend16(uint32 s, uint16 d, uint32 greenBits)
+{
+   const uint32 greenMask = (1 << greenBits) - 1;
+   uint32 r5 = d >> (5 + greenBits), g = (d >> 5) & greenMask, b5 = d & 0x1F;
+   uint32 expanded = (((r5 << 3) | (r5 >> 2)) << 16) | (((b5 << 3) | (b5 >> 2)));
+
+   if (greenBits == 6) {
+      expanded |= ((g << 2) | (g >> 4)) << 8;
+   } else {
+      expanded |= ((g << 3) | (g >> 2)) << 8;
+   }
+
+   expanded = GfxBlend32(s, expanded);
+
+   return (((expanded >> 19) & 0x1F) << (5 + greenBits)) |
+          (((expanded >> (16 - greenBits)) & greenMask) << 5) |
+          ((expanded >> 3) & 0x1F);
+}
+
+
+/*
+ * GfxAlphaSpan32 --
+ *
+ *    Blend a span of ARGB pixels over a 32-bit span. The SSE2 loop
+ *    does four pixels at a time, with the same arithmetic as
+ *    GfxBlend32: bytes are widened to words, each pixel's alpha is
+ *    broadcast across its channels with pshuflw/pshufhw, and the
+ *    products are narrowed back with packuswb.
+ */
+
+static fastcall void
+GfxAlphaSpan32(uint32 *dest, const uint32 *src, uint32 count)
+{
+   if (gGfx.sse2 && count >= 4) {
+      uint32 blocks = count / 4;
+
+      asm volatile ("pxor %%xmm7, %%xmm7 \n"
+                    "pcmpeqw %%xmm6, %%xmm6 \n"
+                    "psrlw $15, %%xmm6 \n"
+                    "psllw $8, %%xmm6 \n"               // 256 in each word
+                    "1: \n"
+                    "movdqu (%1), %%xmm0 \n"
+                    "movdqu (%0), %%xmm1 \n"
+                    "movdqa %%xmm0, %%xmm2 \n"
+                    "movdqa %%xmm1, %%xmm3 \n"
+                    "punpcklbw %%xmm7, %%xmm0 \n"       // Source, pixels 0-1
+                    "punpckhbw %%xmm7, %%xmm2 \n"       // Source, pixels 2-3
+                    "punpcklbw %%xmm7, %%xmm1 \n"       // Dest, pixels 0-1
+                    "punpckhbw %%xmm7, %%xmm3 \n"       // Dest, pixels 2-3
+
+                    "pshuflw $0xFF, %%xmm0, %%xmm4 \n"
+                    "pshufhw $0xFF, %%xmm4, %%xmm4 \n"
+                    "movdqa %%xmm4, %%xmm5 \n"
+                    "psrlw $7, %%xmm5 \n"
+                    "paddw %%xmm5, %%xmm4 \n"           // a
+                    "movdqa %%xmm6, %%xmm5 \n"
+                    "psubw %%xmm4, %%xmm5 \n"           // 256 - a
+                    "pmullw %%xmm4, %%xmm0 \n"
+                    "pmullw %%xmm5, %%xmm1 \n"
+                    "paddw %%xmm1, %%xmm0 \n"
+                    "psrlw $8, %%xmm0 \n"
+
+                    "pshuflw $0xFF, %%xmm2, %%xmm4 \n"
+                    "pshufhw $0xFF, %%xmm4, %%xmm4 \n"
+                    "movdqa %%xmm4, %%xmm5 \n"
+                    "psrlw $7, %%xmm5 \n"
+                    "paddw %%xmm5, %%xmm4 \n"
+                    "movdqa %%xmm6, %%xmm5 \n"
+                    "psubw %%xmm4, %%xmm5 \n"
+                    "pmullw %%xmm4, %%xmm2 \n"
+                    "pmullw %%xmm5, %%xmm3 \n"
+                    "paddw %%xmm3, %%xmm2 \n"
+                    "psrlw $8, %%xmm2 \n"
+
+                    "packuswb %%xmm2, %%xmm0 \n"
+                    "movdqu %%xmm0, (%0) \n"
+                    "addl $16, %1 \n"
+                    "addl $16, %0 \n"
+                    "decl %2 \n"
+                    "jnz 1b \n"
+                    : "+r" (dest), "+r" (src), "+r" (blocks) :: "memory");
+      count &= 3;
+   }
+
+   while (count--) {
+      *dest = GfxBlend32(*src, *dest);
+      dest++;
+      src++;
+   }
+}
+
+
+/*
+ * Gfx_BlitAlpha --
+ *
+ *    Blend a rectangle of a 32-bit ARGB surface over a 15, 16 or
+ *    32-bit surface. Nothing is drawn on 8-bit surfaces. The
+ *    rectangles must not overlap.
+ */
+
+fastcall void
+Gfx_BlitAlpha(GfxSurface *dest, int x, int y,
+              const GfxSurface *src, int srcX, int srcY, int width, int height)
+{
+   GfxBlitRect r = { x, y, srcX, srcY, width, height };
+   uint8 *destRow;
+   const uint8 *srcRow;
+   int i;
+
+   if (src->bytesPerPixel != 4 || dest->bytesPerPixel == 1 ||
+       !GfxClipBlit(dest, src, &r)) {
+      return;
+   }
+
+   destRow = Gfx_PixelAddress(dest, r.x, r.y);
+   srcRow = Gfx_PixelAddress(src, r.srcX, r.srcY);
+
+   while (r.height--) {
+      const uint32 *s = (const uint32*) srcRow;
+
+      if (dest->bytesPerPixel == 4) {
+         GfxAlphaSpan32((uint32*) destRow, s, r.width);
+      } else {
+         uint16 *d = (uint16*) destRow;
+         uint32 greenBits = dest->bitsPerPixel == 16 ? 6 : 5;
+
+         for (i = 0; i < r.width; i++) {
+            d[i] = GfxBlend16(s[i], d[i], greenBits);
+         }
+      }
+
+      destRow += dest->pitch;
+      srcRow += src->pitch;
+   }
+}
@@ -0,0 +1,135 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * gfx.h - Software 2D rasterization for linear framebuffers.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GFX_H__
+#define __GFX_H__
+
+#include "types.h"
+
+/*
+ * Rectangle fills, lines and blits into any linear framebuffer or
+ * off-screen buffer with 8, 15, 16 or 32 bits per pixel. Rows are
+ * addressed through the surface's pitch, so a VBE mode whose
+ * bytesPerLine is wider than the visible screen works the same as a
+ * tightly packed buffer.
+ *
+ * Every operation is clipped to the surface's clip rectangle, then
+ * broken into horizontal spans. Spans are filled or copied with SSE2
+ * if Gfx_Init() found it, otherwise with rep stosl / rep movsl.
+ *
+ * Colors are raw pixel values in the surface's format. Alpha blits
+ * take a 32-bit ARGB source with straight (not premultiplied) alpha.
+ */
+
+typedef struct {
+   int          x0, y0;         // Inclusive
+   int          x1, y1;         // Exclusive
+} GfxRect;
+
+typedef struct {
+   uint8       *pixels;
+   uint32       pitch;          // Bytes per scanline
+   int          width, height;
+   uint32       bitsPerPixel;
+   uint32       bytesPerPixel;
+   GfxRect      clip;
+} GfxSurface;
+
+typedef struct {
+   Bool         sse2;           // Use SSE2 spans. May be cleared.
+} GfxState;
+
+extern GfxState gGfx;
+
+fastcall void Gfx_Init(void);
+
+fastcall Bool Gfx_InitSurface(GfxSurface *surface, void *pixels, int width, int height,
+                              uint32 pitch, uint32 bitsPerPixel);
+fastcall Bool Gfx_InitVBESurface(GfxSurface *surface, void *pixels);
+fastcall void Gfx_SetClip(GfxSurface *surface, int x, int y, int width, int height);
+
+fastcall void Gfx_FillRect(GfxSurface *surface, int x, int y, int width, int height,
+                           uint32 color);
+fastcall void Gfx_Line(GfxSurface *surface, int x0, int y0, int x1, int y1, uint32 color);
+
+fastcall void Gfx_Blit(GfxSurface *dest, int x, int y,
+                       const GfxSurface *src, int srcX, int srcY, int width, int height);
+fastcall void Gfx_BlitKeyed(GfxSurface *dest, int x, int y,
+                            const GfxSurface *src, int srcX, int srcY, int width, int height,
+                            uint32 key);
+fastcall void Gfx_BlitAlpha(GfxSurface *dest, int x, int y,
+                            const GfxSurface *src, int srcX, int srcY, int width, int height);
+
+
+/*
+ * Gfx_PixelAddress --
+ *
+ *    Return the address of one pixel. No clipping.
+ */
+
+static inline void *
+Gfx_PixelAddress(const GfxSurface *surface, int x, int y)
+{
+   return surface->pixels + y * surface->pitch + x * surface->bytesPerPixel;
+}
+
+
+/*
+ * Gfx_PutPixel --
+ *
+ *    Plot one pixel, if it's inside the clip rectangle.
+ */
+
+static inline void
+Gfx_PutPixel(GfxSurface *surface, int x, int y, uint32 color)
+{
+   void *p = Gfx_PixelAddress(surface, x, y);
+
+   if (x < surface->clip.x0 || x >= surface->clip.x1 ||
+       y < surface->clip.y0 || y >= surface->clip.y1) {
+      return;
+   }
+
+   switch (surface->bytesPerPixel) {
+   case 1:
+      *(uint8*) p = color;
+      break;
+   case 2:
+      *(uint16*) p = color;
+      break;
+   default:
+      *(uint32*) p = color;
+      break;
+   }
+}
+
+#endif /* __GFX_H__ */
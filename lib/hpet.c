@@ -0,0 +1,261 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * hpet.c - Driver for the High Precision Event Timer.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "hpet.h"
+#include "acpi.h"
+#include "intr.h"
+
+#define FSEC_PER_SEC  1000000000000000ULL
+
+HPETState gHPET;
+
+ClockSource gClockSourceHPET = {
+   .name = "HPET",
+   .read = HPET_ReadCounter,
+};
+
+
+/*
+ * HPETRead32 --
+ * HPETWrite32 --
+ *
+ *    Access the low or high half of a 64-bit HPET register.
+ */
+
+static inline uint32
+HPETRead32(uint32 reg)
+{
+   return gHPET.regs[reg / sizeof(uint32)];
+}
+
+static inline void
+HPETWrite32(uint32 reg, uint32 value)
+{
+   gHPET.regs[reg / sizeof(uint32)] = value;
+}
+
+
+/*
+ * HPET_ReadCounter --
+ *
+ *    Read the 64-bit main counter. This is a plain memory read, with
+ *    no port I/O. We read the halves separately, and retry if the
+ *    high word changed underneath us.
+ */
+
+fastcall uint64
+HPET_ReadCounter(void)
+{
+   uint32 high, low;
+
+   do {
+      high = HPETRead32(HPET_REG_COUNTER + 4);
+      low = HPETRead32(HPET_REG_COUNTER);
+   } while (high != HPETRead32(HPET_REG_COUNTER + 4));
+
+   return ((uint64)high << 32) | low;
+}
+
+
+/*
+ * HPETWriteComparator --
+ *
+ *    Write a 64-bit comparator value, high word first, so we can't
+ *    get a spurious match on a half-written value.
+ */
+
+static fastcall void
+HPETWriteComparator(int timer, uint64 value)
+{
+   HPETWrite32(HPET_REG_TIMER_CMP(timer) + 4, value >> 32);
+   HPETWrite32(HPET_REG_TIMER_CMP(timer), value);
+}
+
+
+/*
+ * HPETSetTimer --
+ *
+ *    Common implementation for HPET_SetOneShot and HPET_SetPeriodic.
+ */
+
+static fastcall void
+HPETSetTimer(int timer, uint64 ns, Bool periodic)
+{
+   uint64 ticks = Clock_Scale(ns, gHPET.cycMult, gHPET.cycShift);
+   uint32 config;
+
+   if (!gHPET.legacyRoute || timer >= HPET_NUM_IRQ_TIMERS || timer >= gHPET.numTimers) {
+      return;
+   }
+
+   config = HPETRead32(HPET_REG_TIMER_CONFIG(timer));
+   if (periodic && !(config & HPET_TIMER_PERIODIC_CAP)) {
+      return;
+   }
+
+   /*
+    * Edge triggered, since the PIC is in edge mode. One-shot timers
+    * use 64-bit comparators if the timer supports them.
+    */
+   config &= ~(HPET_TIMER_INT_LEVEL | HPET_TIMER_PERIODIC |
+               HPET_TIMER_VAL_SET | HPET_TIMER_32BIT_MODE);
+   config |= HPET_TIMER_INT_ENABLE;
+
+   if (periodic) {
+      /*
+       * In periodic mode, the first comparator write after setting
+       * VAL_SET is the next match time, and the write after that is
+       * the period. The hardware clears VAL_SET on any 32-bit write,
+       * so a 64-bit value written in halves would be split between
+       * the two. Like Linux, we run periodic timers in 32-bit mode
+       * and write the low words only.
+       */
+      if (ticks > 0xFFFFFFFF) {
+         return;
+      }
+      config |= HPET_TIMER_PERIODIC | HPET_TIMER_VAL_SET | HPET_TIMER_32BIT_MODE;
+      HPETWrite32(HPET_REG_TIMER_CONFIG(timer), config);
+      HPETWrite32(HPET_REG_TIMER_CMP(timer), HPET_ReadCounter() + ticks);
+      HPETWrite32(HPET_REG_TIMER_CMP(timer), ticks);
+   } else {
+      HPETWrite32(HPET_REG_TIMER_CONFIG(timer), config);
+      HPETWriteComparator(timer, HPET_ReadCounter() + ticks);
+   }
+}
+
+
+/*
+ * HPET_SetOneShot --
+ * HPET_SetPeriodic --
+ *
+ *    Program one of the comparators (0 or 1) to interrupt once after
+ *    'ns' nanoseconds, or repeatedly every 'ns' nanoseconds. The
+ *    interrupt arrives at HPET_TIMER0_IRQ or HPET_TIMER1_IRQ, which
+ *    the caller must unmask. Periodic mode is optional in hardware;
+ *    if this timer doesn't support it, nothing happens. Likewise if
+ *    the HPET can't do legacy replacement routing, or if a period
+ *    doesn't fit in 32 bits of HPET ticks.
+ */
+
+fastcall void
+HPET_SetOneShot(int timer, uint64 ns)
+{
+   HPETSetTimer(timer, ns, FALSE);
+}
+
+fastcall void
+HPET_SetPeriodic(int timer, uint64 ns)
+{
+   HPETSetTimer(timer, ns, TRUE);
+}
+
+
+/*
+ * HPET_StopTimer --
+ *
+ *    Disable interrupts from one comparator.
+ */
+
+fastcall void
+HPET_StopTimer(int timer)
+{
+   uint32 config = HPETRead32(HPET_REG_TIMER_CONFIG(timer));
+   HPETWrite32(HPET_REG_TIMER_CONFIG(timer), config & ~HPET_TIMER_INT_ENABLE);
+}
+
+
+/*
+ * HPET_Init --
+ *
+ *    Find the HPET using ACPI, start its main counter, and make
+ *    gClockSourceHPET usable. All comparators start out disabled.
+ *
+ *    If the HPET supports legacy replacement routing, this turns it
+ *    on. From then on the PIT and RTC no longer interrupt on IRQ 0
+ *    and IRQ 8; HPET timers 0 and 1 do instead.
+ *
+ *    Returns FALSE if there is no usable HPET.
+ *
+ *    Note that the main counter may be only 32 bits wide on some
+ *    hardware (see HPET_CAPS_64BIT), in which case gClockSourceHPET
+ *    wraps after a few minutes.
+ */
+
+fastcall Bool
+HPET_Init(void)
+{
+   HPETState *self = &gHPET;
+   const ACPITableHPET *table = (const void*) ACPI_FindTable(ACPI_SIG_HPET);
+   uint32 caps, config;
+   int i;
+
+   if (!table ||
+       table->address.addressSpace != ACPI_ADDRSPACE_MEMORY ||
+       (table->address.address >> 32) != 0) {
+      return FALSE;
+   }
+
+   self->regs = (volatile uint32*)(uint32) table->address.address;
+
+   caps = HPETRead32(HPET_REG_CAPS);
+   self->periodFs = HPETRead32(HPET_REG_CAPS + 4);
+   self->numTimers = HPET_CAPS_NUM_TIMERS(caps);
+
+   if (self->periodFs == 0 || self->periodFs > 100000000) {
+      /* The spec caps the period at 100ns. Anything else is bogus. */
+      return FALSE;
+   }
+
+   /*
+    * Halt and reset the main counter, and quiesce all comparators.
+    */
+
+   config = HPETRead32(HPET_REG_CONFIG) & ~(HPET_CONFIG_ENABLE | HPET_CONFIG_LEGACY_ROUTE);
+   HPETWrite32(HPET_REG_CONFIG, config);
+   HPETWrite32(HPET_REG_COUNTER, 0);
+   HPETWrite32(HPET_REG_COUNTER + 4, 0);
+
+   for (i = 0; i < self->numTimers; i++) {
+      HPET_StopTimer(i);
+   }
+
+   ClockSource_SetFrequency(&gClockSourceHPET, FSEC_PER_SEC / self->periodFs);
+   Clock_CalcMultShift(NSEC_PER_SEC, gClockSourceHPET.hz, &self->cycMult, &self->cycShift);
+
+   self->legacyRoute = (caps & HPET_CAPS_LEGACY_ROUTE) != 0;
+   if (self->legacyRoute) {
+      config |= HPET_CONFIG_LEGACY_ROUTE;
+   }
+   HPETWrite32(HPET_REG_CONFIG, config | HPET_CONFIG_ENABLE);
+
+   return TRUE;
+}
@@ -0,0 +1,95 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * hpet.h - Driver for the High Precision Event Timer.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __HPET_H__
+#define __HPET_H__
+
+#include "types.h"
+#include "clock.h"
+
+/*
+ * HPET register offsets. All registers are 64 bits wide, but we
+ * access them as pairs of 32-bit words.
+ */
+
+#define HPET_REG_CAPS              0x000
+#define HPET_REG_CONFIG            0x010
+#define HPET_REG_INTR_STATUS       0x020
+#define HPET_REG_COUNTER           0x0F0
+#define HPET_REG_TIMER_CONFIG(n)   (0x100 + 0x20 * (n))
+#define HPET_REG_TIMER_CMP(n)      (0x108 + 0x20 * (n))
+
+#define HPET_CAPS_NUM_TIMERS(c)    ((((c) >> 8) & 0x1F) + 1)
+#define HPET_CAPS_64BIT            (1 << 13)
+#define HPET_CAPS_LEGACY_ROUTE     (1 << 15)
+
+#define HPET_CONFIG_ENABLE         (1 << 0)
+#define HPET_CONFIG_LEGACY_ROUTE   (1 << 1)
+
+#define HPET_TIMER_INT_LEVEL       (1 << 1)
+#define HPET_TIMER_INT_ENABLE      (1 << 2)
+#define HPET_TIMER_PERIODIC        (1 << 3)
+#define HPET_TIMER_PERIODIC_CAP    (1 << 4)
+#define HPET_TIMER_64BIT_CAP       (1 << 5)
+#define HPET_TIMER_VAL_SET         (1 << 6)
+#define HPET_TIMER_32BIT_MODE      (1 << 8)
+
+/*
+ * We route comparator interrupts using the HPET's legacy replacement
+ * mode, so they arrive at the PIC without an I/O APIC driver. In this
+ * mode, timer 0 replaces the PIT on IRQ 0 and timer 1 replaces the
+ * RTC on IRQ 8. Other timers aren't usable for interrupts.
+ */
+
+#define HPET_NUM_IRQ_TIMERS        2
+#define HPET_TIMER0_IRQ            0
+#define HPET_TIMER1_IRQ            8
+
+typedef struct HPETState {
+   volatile uint32 *regs;
+   uint32 periodFs;        // Main counter period, in femtoseconds
+   uint32 numTimers;
+   Bool legacyRoute;       // Timers 0 and 1 can interrupt via the PIC
+   uint32 cycMult;         // ticks = (ns * cycMult) >> cycShift
+   uint32 cycShift;
+} HPETState;
+
+extern HPETState gHPET;
+extern ClockSource gClockSourceHPET;
+
+fastcall Bool HPET_Init(void);
+fastcall uint64 HPET_ReadCounter(void);
+fastcall void HPET_SetOneShot(int timer, uint64 ns);
+fastcall void HPET_SetPeriodic(int timer, uint64 ns);
+fastcall void HPET_StopTimer(int timer);
+
+#endif /* __HPET_H__ */
@@ -0,0 +1,327 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * instrument.c - Function-level profiler, using -finstrument-functions
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "instrument.h"
+#include "console.h"
+#include "intr.h"
+
+/*
+ * Nothing in this file may be instrumented, or the hooks would call
+ * themselves. Makefile.rules excludes this file, and every function
+ * here is also marked, including the helpers that would otherwise
+ * come from headers.
+ */
+
+#define NO_INSTRUMENT  __attribute__ ((no_instrument_function))
+
+InstrumentState gInstrument;
+
+void __cyg_profile_func_enter(void *fn, void *callSite) NO_INSTRUMENT;
+void __cyg_profile_func_exit(void *fn, void *callSite) NO_INSTRUMENT;
+
+
+static inline NO_INSTRUMENT uint64
+InstrumentReadTSC(void)
+{
+   uint64 tsc;
+   asm volatile ("rdtsc" : "=A" (tsc));
+   return tsc;
+}
+
+static inline NO_INSTRUMENT uint32
+InstrumentDisable(void)
+{
+   uint32 eflags;
+   asm volatile ("pushf; pop %0; cli" : "=r" (eflags) :: "memory");
+   return eflags;
+}
+
+static inline NO_INSTRUMENT void
+InstrumentRestore(uint32 eflags)
+{
+   asm volatile ("push %0; popf" :: "r" (eflags) : "memory", "cc");
+}
+
+
+/*
+ * InstrumentLookup --
+ *
+ *    Find or create the hash table entry for 'fn'.
+ */
+
+static NO_INSTRUMENT fastcall InstrumentFunction *
+InstrumentLookup(void *fn)
+{
+   uint32 index = ((uint32)fn * 2654435761U) >> (32 - INSTRUMENT_HASH_BITS);
+   int probes;
+
+   for (probes = INSTRUMENT_HASH_SIZE; probes; probes--) {
+      InstrumentFunction *func = &gInstrument.functions[index];
+
+      if (func->fn == fn) {
+         return func;
+      }
+      if (func->fn == NULL) {
+         func->fn = fn;
+         return func;
+      }
+
+      index = (index + 1) & (INSTRUMENT_HASH_SIZE - 1);
+   }
+
+   gInstrument.dropped++;
+   return NULL;
+}
+
+
+/*
+ * __cyg_profile_func_enter --
+ *
+ *    Push a frame onto the shadow stack. Past INSTRUMENT_MAX_DEPTH
+ *    we only count depth, so entries and exits still pair up.
+ */
+
+void
+__cyg_profile_func_enter(void *fn, void *callSite)
+{
+   uint32 eflags;
+
+   if (!gInstrument.enabled) {
+      return;
+   }
+
+   eflags = InstrumentDisable();
+
+   if (gInstrument.depth < INSTRUMENT_MAX_DEPTH) {
+      InstrumentFrame *frame = &gInstrument.stack[gInstrument.depth];
+      frame->fn = fn;
+      frame->func = InstrumentLookup(fn);
+      frame->children = 0;
+      frame->start = InstrumentReadTSC();
+   }
+   gInstrument.depth++;
+
+   InstrumentRestore(eflags);
+}
+
+
+/*
+ * __cyg_profile_func_exit --
+ *
+ *    Pop a frame, and charge its time to the function and to its
+ *    caller's children.
+ */
+
+void
+__cyg_profile_func_exit(void *fn, void *callSite)
+{
+   uint64 now = InstrumentReadTSC();
+   InstrumentFrame *frame;
+   uint64 elapsed;
+   uint32 eflags;
+   int i;
+
+   if (!gInstrument.enabled) {
+      return;
+   }
+
+   eflags = InstrumentDisable();
+
+   if (gInstrument.depth == 0) {
+      goto done;
+   }
+   if (gInstrument.depth > INSTRUMENT_MAX_DEPTH) {
+      gInstrument.depth--;
+      goto done;
+   }
+
+   /*
+    * If this isn't the function on top of the shadow stack, we
+    * switched threads or returned from something we never saw
+    * enter. Unwind to the matching frame, or ignore the exit.
+    */
+   for (i = gInstrument.depth - 1; i >= 0; i--) {
+      if (gInstrument.stack[i].fn == fn) {
+         break;
+      }
+   }
+   if (i < 0) {
+      goto done;
+   }
+
+   frame = &gInstrument.stack[i];
+   gInstrument.depth = i;
+   elapsed = now - frame->start;
+
+   if (frame->func) {
+      frame->func->calls++;
+      frame->func->inclusive += elapsed;
+      frame->func->exclusive += elapsed - frame->children;
+   }
+   if (i > 0) {
+      frame[-1].children += elapsed;
+   }
+
+ done:
+   InstrumentRestore(eflags);
+}
+
+
+/*
+ * Instrument_Reset --
+ * Instrument_Init --
+ *
+ *    Discard all measurements, and start measuring. Functions that
+ *    are already running when we start have no shadow frame, so
+ *    their exits are ignored.
+ */
+
+NO_INSTRUMENT fastcall void
+Instrument_Reset(void)
+{
+   uint32 eflags = InstrumentDisable();
+
+   memset(gInstrument.functions, 0, sizeof gInstrument.functions);
+   gInstrument.depth = 0;
+   gInstrument.dropped = 0;
+
+   InstrumentRestore(eflags);
+}
+
+NO_INSTRUMENT fastcall void
+Instrument_Init(void)
+{
+   Instrument_Reset();
+   gInstrument.enabled = TRUE;
+}
+
+
+/*
+ * Instrument_Report --
+ *
+ *    Print the 'topN' functions with the most exclusive time on
+ *    the console. Measurement is paused while we print, so the
+ *    report doesn't measure itself.
+ */
+
+NO_INSTRUMENT fastcall void
+Instrument_Report(int topN)
+{
+   uint64 lastExclusive = ~0ULL;
+   int lastIndex = -1;
+   Bool enabled = gInstrument.enabled;
+
+   gInstrument.enabled = FALSE;
+
+   Console_Format("%u functions dropped\n"
+                  "     Calls  Exclusive cycles  Inclusive cycles  Function\n",
+                  gInstrument.dropped);
+
+   /*
+    * Selection by (exclusive descending, index ascending).
+    */
+   while (topN--) {
+      InstrumentFunction *best = NULL;
+      int i, bestIndex = -1;
+
+      for (i = 0; i < INSTRUMENT_HASH_SIZE; i++) {
+         InstrumentFunction *func = &gInstrument.functions[i];
+
+         if (func->calls == 0 || func->exclusive > lastExclusive ||
+             (func->exclusive == lastExclusive && i <= lastIndex)) {
+            continue;
+         }
+         if (!best || func->exclusive > best->exclusive) {
+            best = func;
+            bestIndex = i;
+         }
+      }
+
+      if (!best) {
+         break;
+      }
+
+      lastExclusive = best->exclusive;
+      lastIndex = bestIndex;
+
+      Console_Format("%10u %17llu %17llu  %08x\n", best->calls,
+                     best->exclusive, best->inclusive, best->fn);
+   }
+
+   gInstrument.enabled = enabled;
+}
+
+
+/*
+ * InstrumentDumpLine --
+ *
+ *    Console_Format() to a specific console.
+ */
+
+static NO_INSTRUMENT void
+InstrumentDumpLine(const ConsoleInterface *console, const char *fmt, ...)
+{
+   char line[80];
+
+   Console_WriteTo(console, line, Console_FormatToBuffer(line, sizeof line, &fmt));
+}
+
+
+/*
+ * Instrument_Dump --
+ *
+ *    Write every function's totals to 'console', one line each, for
+ *    lib/instrument2txt.py to symbolize:
+ *
+ *       INSTRUMENT<tab><fn><tab><calls><tab><exclusive><tab><inclusive>
+ */
+
+NO_INSTRUMENT fastcall void
+Instrument_Dump(const ConsoleInterface *console)
+{
+   Bool enabled = gInstrument.enabled;
+   int i;
+
+   gInstrument.enabled = FALSE;
+
+   for (i = 0; i < INSTRUMENT_HASH_SIZE; i++) {
+      InstrumentFunction *func = &gInstrument.functions[i];
+      if (func->calls) {
+         InstrumentDumpLine(console, "INSTRUMENT\t%08x\t%u\t%llu\t%llu\n", func->fn,
+                            func->calls, func->exclusive, func->inclusive);
+      }
+   }
+   console->flush();
+
+   gInstrument.enabled = enabled;
+}
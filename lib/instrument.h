@@ -0,0 +1,89 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * instrument.h - Function-level profiler, using -finstrument-functions
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __INSTRUMENT_H__
+#define __INSTRUMENT_H__
+
+#include "types.h"
+#include "console.h"
+
+/*
+ * Build with "make PROFILE=1" to compile everything with
+ * -finstrument-functions and link this module. GCC then calls our
+ * hooks on entry to and exit from every function, which we use to
+ * count calls and measure each function's inclusive time (including
+ * callees) and exclusive time (excluding them), in TSC cycles.
+ *
+ * This catches short functions that sampling misses, at the cost of
+ * a few dozen cycles per call. Nothing is recorded until
+ * Instrument_Init().
+ *
+ * Timing follows one shadow call stack, so it understands interrupt
+ * handlers (they nest) but not thread switches. After a switch, the
+ * stack is resynchronized on the next matching exit, and the time
+ * spent in the other thread is charged to whatever was interrupted.
+ */
+
+#define INSTRUMENT_HASH_BITS   10
+#define INSTRUMENT_HASH_SIZE   (1 << INSTRUMENT_HASH_BITS)
+#define INSTRUMENT_MAX_DEPTH   64
+
+typedef struct {
+   void *fn;
+   uint32 calls;
+   uint64 inclusive;
+   uint64 exclusive;
+} InstrumentFunction;
+
+typedef struct {
+   void *fn;
+   InstrumentFunction *func;     // NULL if the hash table was full
+   uint64 start;
+   uint64 children;              // Inclusive cycles of completed callees
+} InstrumentFrame;
+
+typedef struct {
+   Bool enabled;
+   uint32 depth;
+   uint32 dropped;               // Functions that didn't fit in the hash table
+   InstrumentFunction functions[INSTRUMENT_HASH_SIZE];
+   InstrumentFrame stack[INSTRUMENT_MAX_DEPTH];
+} InstrumentState;
+
+extern InstrumentState gInstrument;
+
+fastcall void Instrument_Init(void);
+fastcall void Instrument_Reset(void);
+fastcall void Instrument_Report(int topN);
+fastcall void Instrument_Dump(const ConsoleInterface *console);
+
+#endif /* __INSTRUMENT_H__ */
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+#
+# Symbolize a Metalkit instrumentation dump (see Instrument_Dump in
+# instrument.c) and print a table sorted by exclusive time.
+#
+#   python3 instrument2txt.py app.elf < serial.txt
+#
+# Symbols come from 'nm', like the 'sizeprof' make target.
+#
+
+import sys
+
+from profile2folded import loadSymbols, symbolize
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: %s app.elf < dump" % sys.argv[0])
+
+    symbols = loadSymbols(sys.argv[1])
+    rows = []
+
+    for line in sys.stdin:
+        fields = line.strip().split("\t")
+        if len(fields) != 5 or fields[0] != "INSTRUMENT":
+            continue
+        fn = int(fields[1], 16)
+        calls, exclusive, inclusive = (int(f) for f in fields[2:])
+        rows.append((exclusive, inclusive, calls, symbolize(symbols, fn)))
+
+    total = sum(r[0] for r in rows) or 1
+    print("%10s %18s %6s %18s  %s" % ("Calls", "Exclusive", "%", "Inclusive", "Function"))
+    for exclusive, inclusive, calls, name in sorted(rows, reverse=True):
+        print("%10d %18d %5.1f%% %18d  %s" % (calls, exclusive, 100.0 * exclusive / total,
+                                             inclusive, name))
+
+
+if __name__ == "__main__":
+    main()
@@ -34,6 +34,8 @@
 #include "intr.h"
 #include "boot.h"
 #include "io.h"
+#include "trace.h"
+#include "stats.h"
 
 
 /*
@@ -71,6 +73,22 @@ const struct {
 
 IntrTrampolineType ALIGNED(4) IntrTrampoline[NUM_INTR_VECTORS];
 
+/*
+ * Every trampoline counts its interrupts: one stat per IRQ, and one
+ * more shared by the fault and user vectors.
+ */
+
+#define INTR_IRQ_STAT(irq)  { "intr.irq" #irq, STAT_TYPE_COUNTER }
+
+static Stat gIntrIRQStats[NUM_IRQ_VECTORS] STAT_SECTION = {
+   INTR_IRQ_STAT(0),  INTR_IRQ_STAT(1),  INTR_IRQ_STAT(2),  INTR_IRQ_STAT(3),
+   INTR_IRQ_STAT(4),  INTR_IRQ_STAT(5),  INTR_IRQ_STAT(6),  INTR_IRQ_STAT(7),
+   INTR_IRQ_STAT(8),  INTR_IRQ_STAT(9),  INTR_IRQ_STAT(10), INTR_IRQ_STAT(11),
+   INTR_IRQ_STAT(12), INTR_IRQ_STAT(13), INTR_IRQ_STAT(14), INTR_IRQ_STAT(15),
+};
+
+STAT_COUNTER(gIntrOtherStat, "intr.other");
+
 /*
  * IntrDefaultHandler --
  *
@@ -84,6 +102,53 @@ IntrDefaultHandler(int vector)
 }
 
 
+#ifdef TRACE
+
+IntrHandler gIntrHandlers[NUM_INTR_VECTORS];
+
+/*
+ * IntrTraceEnter --
+ * IntrTraceExit --
+ *
+ *    Tracepoints around every interrupt handler.
+ */
+
+fastcall void
+IntrTraceEnter(int vector)
+{
+   Trace_Begin("intr", "vector", vector, 0, 0);
+}
+
+fastcall void
+IntrTraceExit(int vector)
+{
+   Trace_End("intr", "vector", vector, 0, 0);
+}
+
+/*
+ * IntrTraceTrampoline --
+ *
+ *    Called by the trampoline in place of the C handler. We pop our
+ *    return address, so the trampoline's argument is back on top of
+ *    the stack and the real handler finds it in the same place. The
+ *    trampoline saved all registers, so we can use %esi freely; the
+ *    C functions we call preserve it.
+ */
+
+asm(".global IntrTraceTrampoline \n IntrTraceTrampoline:"
+
+    "pop     %esi \n"                      // Return address, in the trampoline
+    "mov     (%esp), %ecx \n"
+    "call    IntrTraceEnter \n"
+    "mov     (%esp), %eax \n"
+    "call    *gIntrHandlers(,%eax,4) \n"   // handler(vector)
+    "mov     (%esp), %ecx \n"
+    "call    IntrTraceExit \n"
+    "jmp     *%esi" );
+
+#endif /* TRACE */
+
+
 /*
  * Intr_Init --
  *
@@ -147,6 +212,7 @@ Intr_Init(void)
        *
        * Our trampolines each look like:
        *
+       *    ff 05 <32-bit addr> incl   <addr>          // Count this interrupt
        *    60                 pusha                   // Save general-purpose regs
        *    68 <32-bit arg>    push   <arg>            // Call handler(arg)
        *    b8 <32-bit addr>   mov    <addr>, %eax
@@ -168,6 +234,7 @@ Intr_Init(void)
        * a template in the data segment.
        */
 
+      tramp->code0 = 0x05ff;
       tramp->code1 = 0x6860;
       tramp->code2 = 0xb8;
       tramp->code3 = 0x8b58d0ff;
@@ -177,8 +244,13 @@ Intr_Init(void)
       tramp->code7 = 0x8b61a5a5;
       tramp->code8 = 0xcfec2464;
 
-      tramp->handler = IntrDefaultHandler;
       tramp->arg = i;
+      if (i >= IRQ_VECTOR_BASE && i < IRQ_VECTOR_BASE + NUM_IRQ_VECTORS) {
+         tramp->counter = &gIntrIRQStats[i - IRQ_VECTOR_BASE].value;
+      } else {
+         tramp->counter = &gIntrOtherStat.value;
+      }
+      Intr_SetHandler(i, IntrDefaultHandler);
 
       idt++;
       tramp++;
@@ -186,6 +186,8 @@ fastcall void Intr_InitContext(IntrContext *ctx, uint32 *stack, IntrContextFn ma
  */
 
 typedef struct {
+   uint16      code0;
+   volatile uint32 *counter;
    uint16      code1;
    uint32      arg;
    uint8       code2;
@@ -200,6 +202,18 @@ typedef struct {
 
 extern IntrTrampolineType ALIGNED(4) IntrTrampoline[NUM_INTR_VECTORS];
 
+/*
+ * With tracing enabled, every trampoline calls IntrTraceTrampoline,
+ * which records the interrupt and calls the real handler from
+ * gIntrHandlers. It leaves the handler's argument where the
+ * trampoline put it, so Intr_GetContext still works.
+ */
+
+#ifdef TRACE
+extern IntrHandler gIntrHandlers[NUM_INTR_VECTORS];
+void IntrTraceTrampoline(int vector);
+#endif
+
 /*
  * Intr_SetHandler --
  *
@@ -210,39 +224,32 @@ extern IntrTrampolineType ALIGNED(4) IntrTrampoline[NUM_INTR_VECTORS];
 static inline void
 Intr_SetHandler(int vector, IntrHandler handler)
 {
+#ifdef TRACE
+   gIntrHandlers[vector] = handler;
+   IntrTrampoline[vector].handler = IntrTraceTrampoline;
+#else
    IntrTrampoline[vector].handler = handler;
+#endif
 }
 
 /*
  * Intr_SetMask --
  *
- *    (Un)mask a particular IRQ.
+ *    (Un)mask a particular IRQ. This is a macro rather than an
+ *    inline function so that, with IO_ACCOUNTING, the PIC accesses
+ *    are credited to the caller rather than to this header.
  */
 
-static inline void
-Intr_SetMask(int irq, Bool enable)
-{
-   uint8 port, bit, mask;
-
-   if (irq >= 8) {
-      bit = 1 << (irq - 8);
-      port = PIC2_DATA_PORT;
-   } else {
-      bit = 1 << irq;
-      port = PIC1_DATA_PORT;
-   }
-
-   mask = IO_In8(port);
-
-   /* A '1' bit in the mask inhibits the interrupt. */
-   if (enable) {
-      mask &= ~bit;
-   } else {
-      mask |= bit;
-   }
-
-   IO_Out8(port, mask);
-}
+#define Intr_SetMask(irq, enable)                                       \
+   do {                                                                 \
+      int _maskIRQ = (irq);                                             \
+      uint16 _maskPort = _maskIRQ >= 8 ? PIC2_DATA_PORT : PIC1_DATA_PORT; \
+      uint8 _maskBit = 1 << (_maskIRQ & 7);                             \
+      uint8 _mask = IO_In8(_maskPort);                                  \
+                                                                        \
+      /* A '1' bit in the mask inhibits the interrupt. */               \
+      IO_Out8(_maskPort, (enable) ? (_mask & ~_maskBit) : (_mask | _maskBit)); \
+   } while (0)
 
 
 #endif /* __INTR_H__ */
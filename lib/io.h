@@ -77,4 +77,80 @@ IO_In32(uint16 port)
    return value;
 }
 
+/*
+ * IO_OutString8 --
+ *
+ *    Write a buffer to one port, a byte at a time, with rep outsb.
+ */
+
+static __inline__ void
+IO_OutString8(uint16 port, const void *buf, uint32 count)
+{
+   __asm__ __volatile__ ("cld; rep outsb" : "+S" (buf), "+c" (count) : "d" (port) : "memory");
+}
+
+#ifdef IO_ACCOUNTING
+
+/*
+ * Port I/O accounting. Under virtualization every port access is a
+ * VM exit, so it's worth knowing which ones we make. Build with
+ * "make IO_ACCOUNTING=1" and every IO_In* and IO_Out* call counts
+ * itself, and its cycles, both per port and per call site. See
+ * ioacct.h for reports.
+ *
+ * Each call site gets a static IOAcctSite descriptor in its own
+ * linker section, like tracepoints, so sites need no lookup. Ports
+ * are hashed by IOAcct_Record(). A string write counts as one
+ * access. To make an unaccounted access, parenthesize the name:
+ * (IO_In8)(port). A static descriptor inside an inline function
+ * would credit every caller to the header, so helpers in headers
+ * that do port I/O are macros, like Intr_SetMask().
+ */
+
+#include "cpu.h"
+
+typedef struct {
+   const char *file;
+   uint32 line;
+   volatile uint32 port;         // Most recent port accessed from this site
+   volatile uint32 count;
+   volatile uint64 cycles;
+} ALIGNED(32) IOAcctSite;
+
+fastcall void IOAcct_Record(IOAcctSite *site, uint32 port, uint32 cycles);
+
+#define IO_ACCOUNT_SITE                                                 \
+   static IOAcctSite _ioSite                                            \
+      __attribute__ ((section(".ioacct_sites"), used)) = { __FILE__, __LINE__ }
+
+#define IO_ACCOUNT_OUT(fn, port, ...)                                   \
+   do {                                                                 \
+      IO_ACCOUNT_SITE;                                                  \
+      uint16 _ioPort = (port);                                          \
+      uint32 _ioStart = (uint32) CPU_ReadTSC();                         \
+      fn(_ioPort, __VA_ARGS__);                                         \
+      IOAcct_Record(&_ioSite, _ioPort, (uint32) CPU_ReadTSC() - _ioStart); \
+   } while (0)
+
+#define IO_ACCOUNT_IN(fn, port)                                         \
+   ({                                                                   \
+      IO_ACCOUNT_SITE;                                                  \
+      uint16 _ioPort = (port);                                          \
+      uint32 _ioStart = (uint32) CPU_ReadTSC();                         \
+      typeof(fn(0)) _ioValue = fn(_ioPort);                             \
+      IOAcct_Record(&_ioSite, _ioPort, (uint32) CPU_ReadTSC() - _ioStart); \
+      _ioValue;                                                         \
+   })
+
+#define IO_Out8(port, value)   IO_ACCOUNT_OUT(IO_Out8, port, value)
+#define IO_Out16(port, value)  IO_ACCOUNT_OUT(IO_Out16, port, value)
+#define IO_Out32(port, value)  IO_ACCOUNT_OUT(IO_Out32, port, value)
+#define IO_OutString8(port, buf, count) \
+   IO_ACCOUNT_OUT(IO_OutString8, port, buf, count)
+#define IO_In8(port)           IO_ACCOUNT_IN(IO_In8, port)
+#define IO_In16(port)          IO_ACCOUNT_IN(IO_In16, port)
+#define IO_In32(port)          IO_ACCOUNT_IN(IO_In32, port)
+
+#endif /* IO_ACCOUNTING */
+
 #endif /* __IO_H__ */
@@ -0,0 +1,269 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * ioacct.c - Port I/O accounting
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "io.h"
+#include "ioacct.h"
+#include "console.h"
+#include "intr.h"
+
+IOAcctState gIOAcct;
+
+
+/*
+ * IOAcct_Record --
+ *
+ *    Charge one access to its call site and its port. Called after
+ *    every accounted IO_In* or IO_Out*, possibly from IRQ handlers,
+ *    so the update runs with interrupts off.
+ */
+
+fastcall void
+IOAcct_Record(IOAcctSite *site, uint32 port, uint32 cycles)
+{
+   uint32 key = port | IOACCT_PORT_USED;
+   uint32 hash = (port * 0x9E3779B1) >> (32 - IOACCT_PORT_HASH_BITS);
+   uint32 probes;
+   Bool iFlag;
+
+   if (gIOAcct.paused) {
+      return;
+   }
+
+   iFlag = Intr_Save();
+   Intr_Disable();
+
+   site->port = port;
+   site->count++;
+   site->cycles += cycles;
+
+   for (probes = 0; probes < IOACCT_PORT_HASH_SIZE; probes++) {
+      IOAcctPort *entry = &gIOAcct.ports[(hash + probes) & (IOACCT_PORT_HASH_SIZE - 1)];
+
+      if (entry->key == 0) {
+         entry->key = key;
+      }
+      if (entry->key == key) {
+         entry->count++;
+         entry->cycles += cycles;
+         break;
+      }
+   }
+   if (probes == IOACCT_PORT_HASH_SIZE) {
+      gIOAcct.dropped++;
+   }
+
+   Intr_Restore(iFlag);
+}
+
+
+/*
+ * IOAcct_Reset --
+ *
+ *    Discard everything counted so far.
+ */
+
+fastcall void
+IOAcct_Reset(void)
+{
+   Bool iFlag = Intr_Save();
+   IOAcctSite *site;
+
+   Intr_Disable();
+
+   memset(gIOAcct.ports, 0, sizeof gIOAcct.ports);
+   gIOAcct.dropped = 0;
+
+   for (site = _ioacct_sites_start; site < _ioacct_sites_end; site++) {
+      site->count = 0;
+      site->cycles = 0;
+   }
+
+   Intr_Restore(iFlag);
+}
+
+
+/*
+ * IOAcctBaseName --
+ *
+ *    __FILE__ includes the path from the app's directory. Just
+ *    the file name is plenty for a report.
+ */
+
+static fastcall const char *
+IOAcctBaseName(const char *path)
+{
+   const char *name = path;
+
+   while (*path) {
+      if (*(path++) == '/') {
+         name = path;
+      }
+   }
+   return name;
+}
+
+
+/*
+ * IOAcct_Report --
+ *
+ *    Print the 'topN' most expensive ports, then the 'topN' most
+ *    expensive call sites, on the console. Accounting is paused while
+ *    we print, so the report doesn't count its own I/O.
+ */
+
+fastcall void
+IOAcct_Report(int topN)
+{
+   uint64 lastCycles;
+   const void *last;
+   int n;
+
+   gIOAcct.paused = TRUE;
+
+   Console_Format("%u accesses dropped\n"
+                  "Port       Count            Cycles  Cycles/access\n",
+                  gIOAcct.dropped);
+
+   /*
+    * Both lists are selection by (cycles descending, address
+    * ascending), the same order Instrument_Report() uses.
+    */
+   lastCycles = ~0ULL;
+   last = NULL;
+   for (n = topN; n; n--) {
+      IOAcctPort *best = NULL;
+      IOAcctPort *port;
+
+      for (port = gIOAcct.ports; port < gIOAcct.ports + IOACCT_PORT_HASH_SIZE; port++) {
+         if (port->count == 0 || port->cycles > lastCycles ||
+             (port->cycles == lastCycles && (const void*) port <= last)) {
+            continue;
+         }
+         if (!best || port->cycles > best->cycles) {
+            best = port;
+         }
+      }
+      if (!best) {
+         break;
+      }
+      lastCycles = best->cycles;
+      last = best;
+
+      Console_Format("%04x %11u %17llu %14u\n", best->key & 0xFFFF, best->count,
+                     best->cycles, (uint32)(best->cycles / best->count));
+   }
+
+   Console_Format("\nPort       Count            Cycles  Site\n");
+
+   lastCycles = ~0ULL;
+   last = NULL;
+   for (n = topN; n; n--) {
+      IOAcctSite *best = NULL;
+      IOAcctSite *site;
+
+      for (site = _ioacct_sites_start; site < _ioacct_sites_end; site++) {
+         if (site->count == 0 || site->cycles > lastCycles ||
+             (site->cycles == lastCycles && (const void*) site <= last)) {
+            continue;
+         }
+         if (!best || site->cycles > best->cycles) {
+            best = site;
+         }
+      }
+      if (!best) {
+         break;
+      }
+      lastCycles = best->cycles;
+      last = best;
+
+      Console_Format("%04x %11u %17llu  %s:%d\n", best->port, best->count,
+                     best->cycles, IOAcctBaseName(best->file), best->line);
+   }
+
+   gIOAcct.paused = FALSE;
+}
+
+
+/*
+ * IOAcctDumpLine --
+ *
+ *    Console_Format() to a specific console.
+ */
+
+static void
+IOAcctDumpLine(const ConsoleInterface *console, const char *fmt, ...)
+{
+   char line[80];
+
+   Console_WriteTo(console, line, Console_FormatToBuffer(line, sizeof line, &fmt));
+}
+
+
+/*
+ * IOAcct_Dump --
+ *
+ *    Write every port and call site to 'console', one tab-separated
+ *    line each, for sorting and diffing on the host:
+ *
+ *       IOACCT<tab>port<tab><port><tab><count><tab><cycles>
+ *       IOACCT<tab>site<tab><file>:<line><tab><port><tab><count><tab><cycles>
+ */
+
+fastcall void
+IOAcct_Dump(const ConsoleInterface *console)
+{
+   IOAcctSite *site;
+   int i;
+
+   gIOAcct.paused = TRUE;
+
+   for (i = 0; i < IOACCT_PORT_HASH_SIZE; i++) {
+      IOAcctPort *port = &gIOAcct.ports[i];
+
+      if (port->count) {
+         IOAcctDumpLine(console, "IOACCT\tport\t%04x\t%u\t%llu\n",
+                        port->key & 0xFFFF, port->count, port->cycles);
+      }
+   }
+
+   for (site = _ioacct_sites_start; site < _ioacct_sites_end; site++) {
+      if (site->count) {
+         IOAcctDumpLine(console, "IOACCT\tsite\t%s:%d\t%04x\t%u\t%llu\n",
+                        IOAcctBaseName(site->file), site->line, site->port,
+                        site->count, site->cycles);
+      }
+   }
+   console->flush();
+
+   gIOAcct.paused = FALSE;
+}
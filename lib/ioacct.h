@@ -0,0 +1,71 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * ioacct.h - Port I/O accounting reports
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __IOACCT_H__
+#define __IOACCT_H__
+
+#include "types.h"
+#include "io.h"
+#include "console.h"
+
+/*
+ * Reports for "make IO_ACCOUNTING=1" builds; see io.h. Accounting
+ * starts at boot. Ports and call sites are ranked by total cycles,
+ * which under a hypervisor is mostly the cost of the VM exits.
+ */
+
+#define IOACCT_PORT_HASH_BITS  8
+#define IOACCT_PORT_HASH_SIZE  (1 << IOACCT_PORT_HASH_BITS)
+
+typedef struct {
+   uint32 key;                   // Port plus IOACCT_PORT_USED, or 0 if free
+   uint32 count;
+   uint64 cycles;
+} IOAcctPort;
+
+#define IOACCT_PORT_USED       0x10000
+
+typedef struct {
+   Bool paused;
+   uint32 dropped;               // Accesses to ports that didn't fit
+   IOAcctPort ports[IOACCT_PORT_HASH_SIZE];
+} IOAcctState;
+
+extern IOAcctState gIOAcct;
+extern IOAcctSite _ioacct_sites_start[];
+extern IOAcctSite _ioacct_sites_end[];
+
+fastcall void IOAcct_Reset(void);
+fastcall void IOAcct_Report(int topN);
+fastcall void IOAcct_Dump(const ConsoleInterface *console);
+
+#endif /* __IOACCT_H__ */
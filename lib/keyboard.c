@@ -34,6 +34,8 @@
 #include "keyboard.h"
 #include "io.h"
 #include "intr.h"
+#include "trace.h"
+#include "stats.h"
 
 /*
  * Keyboard hardware definitions
@@ -276,12 +278,17 @@ KeyboardTranslate(KeyEvent *event)
  *    pass it on to any registered KeyboardIRQHandler.
  */
 
+STAT_COUNTER(gKeyboardEventStat, "keyboard.events");
+
 static void
 KeyboardHandlerInternal(int vector)
 {
    KeyEvent event = { KeyboardRead() };
 
    KeyboardTranslate(&event);
+   Trace_Instant("keyboard", "scancode,key,pressed",
+                 event.scancode, event.key, event.pressed);
+   Stat_Inc(&gKeyboardEventStat);
 
    if (gKeyboard.handler) {
       gKeyboard.handler(&event);
@@ -0,0 +1,227 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * lapic.c - Local APIC and per-CPU LAPIC timer support.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lapic.h"
+#include "cpu.h"
+#include "clock.h"
+#include "timer.h"
+#include "intr.h"
+
+/*
+ * Divide the bus clock by 16. On typical hardware (and in QEMU) this
+ * still gives a resolution well under 100ns, but the 32-bit counter
+ * can represent intervals of a minute or more.
+ */
+#define LAPIC_TIMER_DIVIDE          0x3
+#define LAPIC_TIMER_DIVISOR         16
+
+#define LAPIC_CALIBRATE_COUNT       (PIT_HZ / 100)    // 10ms
+
+LAPICState gLAPIC;
+
+
+/*
+ * LAPICRead --
+ * LAPICWrite --
+ *
+ *    Access a 32-bit local APIC register.
+ */
+
+static inline uint32
+LAPICRead(uint32 reg)
+{
+   return gLAPIC.regs[reg / sizeof(uint32)];
+}
+
+static inline void
+LAPICWrite(uint32 reg, uint32 value)
+{
+   gLAPIC.regs[reg / sizeof(uint32)] = value;
+}
+
+
+/*
+ * LAPICCalibrateTimer --
+ *
+ *    Measure the timer's tick rate by letting it count down from its
+ *    maximum value during a PIT channel 2 one-shot.
+ */
+
+static fastcall uint64
+LAPICCalibrateTimer(void)
+{
+   Bool iFlag = Intr_Save();
+   uint32 elapsed;
+
+   Intr_Disable();
+
+   LAPICWrite(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_LVT_TIMER_ONESHOT);
+   Timer_BeginPIT2(LAPIC_CALIBRATE_COUNT);
+   LAPICWrite(LAPIC_REG_TIMER_INITIAL, 0xFFFFFFFF);
+   while (!Timer_PIT2Done());
+   elapsed = 0xFFFFFFFF - LAPICRead(LAPIC_REG_TIMER_CURRENT);
+   LAPICWrite(LAPIC_REG_TIMER_INITIAL, 0);
+
+   Intr_Restore(iFlag);
+
+   return (uint64)elapsed * PIT_HZ / LAPIC_CALIBRATE_COUNT;
+}
+
+
+/*
+ * LAPIC_Init --
+ *
+ *    Enable the calling CPU's local APIC, with its timer stopped.
+ *    Every CPU that wants to use its LAPIC timer must call this. The
+ *    first call also calibrates the timer against the PIT.
+ *
+ *    Returns FALSE if this CPU has no local APIC.
+ */
+
+fastcall Bool
+LAPIC_Init(void)
+{
+   LAPICState *self = &gLAPIC;
+   CPUIDRegs id;
+   uint64 base;
+
+   CPU_GetID(1, &id);
+   if (!(id.edx & CPUID_1_EDX_APIC) || !(id.edx & CPUID_1_EDX_MSR)) {
+      return FALSE;
+   }
+   self->tscDeadline = (id.ecx & CPUID_1_ECX_TSC_DEADLINE) != 0;
+
+   base = CPU_ReadMSR(LAPIC_MSR_BASE);
+   CPU_WriteMSR(LAPIC_MSR_BASE, base | LAPIC_MSR_BASE_ENABLE);
+   self->regs = (volatile uint32*)(uint32)(base & 0xFFFFF000);
+
+   LAPICWrite(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+   LAPICWrite(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE);
+   LAPIC_TimerStop();
+
+   if (!self->timerHz) {
+      self->timerHz = LAPICCalibrateTimer();
+      Clock_CalcMultShift(NSEC_PER_SEC, self->timerHz, &self->cycMult, &self->cycShift);
+   }
+
+   return TRUE;
+}
+
+
+/*
+ * LAPICTimerStart --
+ *
+ *    Common implementation for one-shot and periodic modes.
+ */
+
+static fastcall void
+LAPICTimerStart(uint32 lvt, uint64 ns)
+{
+   uint64 ticks = Clock_Scale(ns, gLAPIC.cycMult, gLAPIC.cycShift);
+
+   /* A zero count stops the timer, so always wait at least one tick. */
+   ticks = MAX(ticks, 1);
+   ticks = MIN(ticks, 0xFFFFFFFF);
+
+   LAPICWrite(LAPIC_REG_LVT_TIMER, lvt);
+   LAPICWrite(LAPIC_REG_TIMER_INITIAL, ticks);
+}
+
+
+/*
+ * LAPIC_TimerOneShot --
+ * LAPIC_TimerPeriodic --
+ *
+ *    Start this CPU's timer, delivering 'vector' once after 'ns'
+ *    nanoseconds or repeatedly every 'ns' nanoseconds. Replaces any
+ *    timer that was already running on this CPU.
+ */
+
+fastcall void
+LAPIC_TimerOneShot(uint8 vector, uint64 ns)
+{
+   LAPICTimerStart(LAPIC_LVT_TIMER_ONESHOT | vector, ns);
+}
+
+fastcall void
+LAPIC_TimerPeriodic(uint8 vector, uint64 ns)
+{
+   LAPICTimerStart(LAPIC_LVT_TIMER_PERIODIC | vector, ns);
+}
+
+
+/*
+ * LAPIC_TimerDeadline --
+ *
+ *    Deliver 'vector' once, when the TSC reaches 'tsc'. If the CPU
+ *    supports TSC-deadline mode the hardware compares against the TSC
+ *    directly, with no conversion error. Otherwise we fall back to a
+ *    one-shot timer, which requires Clock_Init() to have been called.
+ */
+
+fastcall void
+LAPIC_TimerDeadline(uint8 vector, uint64 tsc)
+{
+   if (gLAPIC.tscDeadline) {
+      LAPICWrite(LAPIC_REG_LVT_TIMER, LAPIC_LVT_TIMER_DEADLINE | vector);
+
+      /*
+       * The LVT write must be visible before we arm the deadline,
+       * or the MSR write may be ignored.
+       */
+      asm volatile ("mfence" ::: "memory");
+      CPU_WriteMSR(LAPIC_MSR_TSC_DEADLINE, tsc);
+
+   } else {
+      uint64 now = Clock_Cycles();
+      uint64 ns = tsc > now ? Clock_CyclesToNanos(tsc - now) : 0;
+
+      LAPIC_TimerOneShot(vector, ns);
+   }
+}
+
+
+/*
+ * LAPIC_TimerStop --
+ *
+ *    Stop this CPU's timer, in any mode.
+ */
+
+fastcall void
+LAPIC_TimerStop(void)
+{
+   LAPICWrite(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+   LAPICWrite(LAPIC_REG_TIMER_INITIAL, 0);
+   if (gLAPIC.tscDeadline) {
+      CPU_WriteMSR(LAPIC_MSR_TSC_DEADLINE, 0);
+   }
+}
@@ -0,0 +1,110 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * lapic.h - Local APIC and per-CPU LAPIC timer support.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __LAPIC_H__
+#define __LAPIC_H__
+
+#include "types.h"
+
+#define LAPIC_MSR_BASE              0x1B
+#define LAPIC_MSR_BASE_ENABLE       (1 << 11)
+#define LAPIC_MSR_TSC_DEADLINE      0x6E0
+
+#define LAPIC_REG_ID                0x020
+#define LAPIC_REG_EOI               0x0B0
+#define LAPIC_REG_SVR               0x0F0
+#define LAPIC_REG_LVT_TIMER         0x320
+#define LAPIC_REG_TIMER_INITIAL     0x380
+#define LAPIC_REG_TIMER_CURRENT     0x390
+#define LAPIC_REG_TIMER_DIVIDE      0x3E0
+
+#define LAPIC_SVR_ENABLE            (1 << 8)
+#define LAPIC_LVT_MASKED            (1 << 16)
+#define LAPIC_LVT_TIMER_ONESHOT     (0 << 17)
+#define LAPIC_LVT_TIMER_PERIODIC    (1 << 17)
+#define LAPIC_LVT_TIMER_DEADLINE    (2 << 17)
+
+#define LAPIC_SPURIOUS_VECTOR       0xFF
+
+/*
+ * Every CPU has its own local APIC, mapped at the same physical
+ * address. So all of the functions below act on the calling CPU's
+ * APIC, and each CPU can run its own timer without involving the
+ * others. Timer calibration is global, since all local APIC timers
+ * run from the same bus clock.
+ */
+
+typedef struct LAPICState {
+   volatile uint32 *regs;
+   uint64 timerHz;         // Timer tick rate, after the divider
+   uint32 cycMult;         // ticks = (ns * cycMult) >> cycShift
+   uint32 cycShift;
+   Bool tscDeadline;       // CPU supports TSC-deadline mode
+} LAPICState;
+
+extern LAPICState gLAPIC;
+
+fastcall Bool LAPIC_Init(void);
+fastcall void LAPIC_TimerOneShot(uint8 vector, uint64 ns);
+fastcall void LAPIC_TimerPeriodic(uint8 vector, uint64 ns);
+fastcall void LAPIC_TimerDeadline(uint8 vector, uint64 tsc);
+fastcall void LAPIC_TimerStop(void);
+
+
+/*
+ * LAPIC_GetID --
+ *
+ *    Return the calling CPU's local APIC ID.
+ */
+
+static inline uint32
+LAPIC_GetID(void)
+{
+   return gLAPIC.regs[LAPIC_REG_ID / sizeof(uint32)] >> 24;
+}
+
+
+/*
+ * LAPIC_EOI --
+ *
+ *    Signal end-of-interrupt. Unlike our PIC setup, the local APIC
+ *    doesn't do automatic EOI, so every handler for a LAPIC timer
+ *    vector must call this.
+ */
+
+static inline void
+LAPIC_EOI(void)
+{
+   gLAPIC.regs[LAPIC_REG_EOI / sizeof(uint32)] = 0;
+}
+
+#endif /* __LAPIC_H__ */
@@ -0,0 +1,326 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * log.c - Lock-free in-memory log ring
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "log.h"
+#include "console.h"
+#include "clock.h"
+#include "cpu.h"
+#include "intr.h"
+#include "lapic.h"
+
+/*
+ * Logging is safe from any context: threads, interrupt handlers, and
+ * code running with interrupts off. Writers claim space in the ring
+ * with a compare-and-exchange on the head, so an IRQ that logs while
+ * a thread is halfway through a message just claims the next slot.
+ * Nobody waits. If the ring is full, the message is dropped and
+ * counted.
+ *
+ * Nothing reaches the screen until the ring is drained, either in
+ * the background by Log_StartDrain() or by calling Log_Drain(),
+ * typically from the main loop or an idle thread. The drain writes
+ * each record to every registered console backend, with a timestamp.
+ * A panic drains whatever is left before printing the panic message.
+ */
+
+LogState gLog;
+
+#define LOG_RECORD_SIZE(length) \
+   (roundup(sizeof(LogRecord) + (length), LOG_RECORD_ALIGN) * LOG_RECORD_ALIGN)
+
+#define LOG_RECORD_AT(pos)       ((LogRecord*) &gLog.ring[(pos) & (LOG_RING_SIZE - 1)])
+
+#define LogCompilerBarrier()     asm volatile ("" ::: "memory")
+
+
+/*
+ * LogReserve --
+ *
+ *    Claim 'size' contiguous bytes in the ring. If the record would
+ *    straddle the end of the ring, we also claim the leftover space
+ *    at the end and fill it with a padding record. Returns NULL if
+ *    there isn't room.
+ */
+
+static fastcall LogRecord *
+LogReserve(uint32 size)
+{
+   uint32 head, offset, pad;
+
+   do {
+      head = gLog.head;
+      offset = head & (LOG_RING_SIZE - 1);
+      pad = offset + size > LOG_RING_SIZE ? LOG_RING_SIZE - offset : 0;
+
+      if (head + pad + size - gLog.tail > LOG_RING_SIZE) {
+         return NULL;
+      }
+   } while (Atomic_CompareExchange(&gLog.head, head, head + pad + size) != head);
+
+   if (pad) {
+      LogRecord *padding = LOG_RECORD_AT(head);
+      padding->size = pad;
+      padding->length = 0;
+      LogCompilerBarrier();
+      padding->flags = LOG_RECORD_COMMITTED | LOG_RECORD_PADDING;
+   }
+
+   return LOG_RECORD_AT(head + pad);
+}
+
+
+/*
+ * Log_Write --
+ *
+ *    Append one message to the log. Never blocks.
+ */
+
+fastcall void
+Log_Write(const char *text, uint32 length)
+{
+   LogRecord *record;
+   uint32 size;
+
+   length = MIN(length, LOG_MAX_MESSAGE);
+   size = LOG_RECORD_SIZE(length);
+
+   record = LogReserve(size);
+   if (!record) {
+      uint32 one = 1;
+      Atomic_Add(gLog.dropped, one);
+      return;
+   }
+
+   record->tsc = CPU_ReadTSC();
+   record->length = length;
+   record->size = size;
+   memcpy(record + 1, text, length);
+
+   LogCompilerBarrier();
+   record->flags = LOG_RECORD_COMMITTED;
+}
+
+
+/*
+ * Log_Format --
+ * Log_FormatV --
+ *
+ *    Append a formatted message to the log. Takes the same format
+ *    strings as Console_Format().
+ */
+
+void
+Log_Format(const char *fmt, ...)
+{
+   Log_FormatV(&fmt);
+}
+
+fastcall void
+Log_FormatV(const char **args)
+{
+   char text[LOG_MAX_MESSAGE];
+
+   Log_Write(text, Console_FormatToBuffer(text, sizeof text, args));
+}
+
+
+/*
+ * LogFormatAll --
+ *
+ *    Console_Format(), but to every registered console backend.
+ */
+
+static void
+LogFormatAll(const char *fmt, ...)
+{
+   char text[64];
+
+   Console_WriteAll(text, Console_FormatToBuffer(text, sizeof text, &fmt));
+}
+
+
+/*
+ * LogDrainRecords --
+ *
+ *    Write out every committed record, oldest first, stopping at the
+ *    first one that is still being written. Consumed records are
+ *    zeroed before we move the tail past them, so a writer's header
+ *    never looks committed before it is.
+ */
+
+static fastcall void
+LogDrainRecords(void)
+{
+   uint32 tail = gLog.tail;
+   uint32 dropped;
+
+   while (tail != gLog.head) {
+      LogRecord *record = LOG_RECORD_AT(tail);
+      uint32 size;
+
+      if (!(record->flags & LOG_RECORD_COMMITTED)) {
+         break;
+      }
+      size = record->size;
+
+      if (!(record->flags & LOG_RECORD_PADDING)) {
+         uint64 ns = Clock_CyclesToNanos(record->tsc - gClock.tscBase);
+         uint32 sec = ns / NSEC_PER_SEC;
+         uint32 usec = (uint32)(ns - sec * NSEC_PER_SEC) / 1000;
+         const char *text = (const char*) (record + 1);
+
+         LogFormatAll("[%5u.%06u] ", sec, usec);
+         Console_WriteAll(text, record->length);
+         if (record->length == 0 || text[record->length - 1] != '\n') {
+            Console_WriteAll("\n", 1);
+         }
+      }
+
+      memset(record, 0, size);
+      LogCompilerBarrier();
+      tail += size;
+      gLog.tail = tail;
+   }
+
+   dropped = gLog.dropped;
+   if (dropped != gLog.reportedDropped) {
+      LogFormatAll("[log: %u messages dropped]\n", dropped - gLog.reportedDropped);
+      gLog.reportedDropped = dropped;
+   }
+
+   Console_FlushAll();
+}
+
+
+/*
+ * Log_Drain --
+ *
+ *    Move everything in the ring to the console backends. Only one
+ *    drain runs at a time; if this interrupted another drain, it
+ *    returns immediately and leaves the work to that one.
+ */
+
+fastcall void
+Log_Drain(void)
+{
+   uint32 busy = 1;
+
+   Atomic_Exchange(gLog.draining, busy);
+   if (busy) {
+      return;
+   }
+
+   LogDrainRecords();
+   gLog.draining = 0;
+}
+
+
+/*
+ * LogDrainIRQ --
+ *
+ *    Local APIC timer handler for Log_StartDrain(). Interrupts are
+ *    enabled while we drain, so that a slow backend doesn't hold off
+ *    everything else. The local APIC won't deliver this vector again
+ *    until our EOI, and the drain lock covers a Log_Drain() we may
+ *    have interrupted.
+ */
+
+static void
+LogDrainIRQ(int vector)
+{
+   Intr_Enable();
+   Log_Drain();
+   Intr_Disable();
+   LAPIC_EOI();
+}
+
+
+/*
+ * Log_StartDrain --
+ *
+ *    Drain the ring in the background, every 'ns' nanoseconds, from
+ *    this CPU's local APIC timer on 'vector'. Call LAPIC_Init()
+ *    first. LAPIC_TimerStop() stops it.
+ *
+ *    The drain runs in interrupt context, so once it's started, only
+ *    write to the console through the log; a direct Console_Format()
+ *    could be interrupted halfway by the drain writing to the same
+ *    backend.
+ */
+
+fastcall void
+Log_StartDrain(uint8 vector, uint64 ns)
+{
+   Intr_SetHandler(vector, LogDrainIRQ);
+   LAPIC_TimerPeriodic(vector, ns);
+}
+
+
+/*
+ * LogPanicHook --
+ *
+ *    Runs when the console is panicking. Whatever the drain was
+ *    doing will never finish, so ignore the drain lock. Other
+ *    backends are prepared for a panic too, so that their output
+ *    doesn't depend on interrupts.
+ */
+
+static fastcall void
+LogPanicHook(void)
+{
+   int i;
+
+   for (i = 0; i < gConsoleNumBackends; i++) {
+      if (gConsoleBackends[i].writeChar != gConsole.writeChar) {
+         gConsoleBackends[i].beginPanic();
+      }
+   }
+
+   LogDrainRecords();
+}
+
+
+/*
+ * Log_Init --
+ *
+ *    Empty the log ring, and arrange for it to be drained on panic.
+ *    Messages are timestamped in TSC cycles, and converted to
+ *    seconds using the Clock module's calibration.
+ */
+
+fastcall void
+Log_Init(void)
+{
+   memset(&gLog, 0, sizeof gLog);
+   gConsolePanicHook = LogPanicHook;
+}
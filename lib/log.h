@@ -0,0 +1,87 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * log.h - Lock-free in-memory log ring
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include "types.h"
+
+/*
+ * Size of the log ring, in bytes. Must be a power of two, and no
+ * larger than 64 KB.
+ */
+#define LOG_RING_SIZE       16384
+
+/*
+ * Longest message we'll store. Longer messages are truncated.
+ */
+#define LOG_MAX_MESSAGE     240
+
+/*
+ * Each message is stored as a LogRecord header followed by its text,
+ * padded to a multiple of LOG_RECORD_ALIGN. Records never wrap
+ * around the end of the ring; a padding record fills any gap.
+ *
+ * 'flags' is written last. Until LOG_RECORD_COMMITTED is set, the
+ * record belongs to its writer and the drain stops there.
+ */
+#define LOG_RECORD_ALIGN      16
+#define LOG_RECORD_COMMITTED  (1 << 0)
+#define LOG_RECORD_PADDING    (1 << 1)
+
+typedef struct {
+   volatile uint16 flags;
+   uint16 length;       // Text length, in bytes
+   uint32 size;         // Total record size, including this header
+   uint64 tsc;          // Timestamp, in TSC cycles
+} LogRecord;
+
+typedef struct {
+   volatile uint32 head;      // Next byte to reserve (writers)
+   volatile uint32 tail;      // Oldest byte not yet drained (drain)
+   volatile uint32 dropped;   // Messages lost because the ring was full
+   uint32 reportedDropped;
+   uint32 draining;
+   uint8 ring[LOG_RING_SIZE] ALIGNED(LOG_RECORD_ALIGN);
+} LogState;
+
+extern LogState gLog;
+
+fastcall void Log_Init(void);
+fastcall void Log_Write(const char *text, uint32 length);
+fastcall void Log_FormatV(const char **args);
+fastcall void Log_Drain(void);
+fastcall void Log_StartDrain(uint8 vector, uint64 ns);
+
+void Log_Format(const char *fmt, ...);
+
+#endif /* __LOG_H__ */
@@ -0,0 +1,133 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * palette.c - VGA DAC palette programming.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "palette.h"
+#include "vbe.h"
+#include "bios.h"
+#include "intr.h"
+#include "io.h"
+
+PaletteState gPalette = { TRUE, 6 };
+
+
+/*
+ * Palette_Init --
+ *
+ *    Choose how to program the palette in the current video mode,
+ *    and widen the DAC to 8 bits if the VBE controller can. Call
+ *    this again after every mode set, since a mode set resets the
+ *    DAC to 6 bits.
+ */
+
+fastcall void
+Palette_Init(void)
+{
+   const uint32 caps = gVBE.cInfo.capabilities;
+
+   gPalette.direct = TRUE;
+   gPalette.dacBits = 6;
+
+   if (!gVBE.current.mode) {
+      return;
+   }
+
+   if ((caps & VBE_CAPS_NONVGA) || (gVBE.current.info.attributes & VBE_MODEATTR_NONVGA)) {
+      gPalette.direct = FALSE;
+   }
+
+   if (caps & VBE_CAPS_DAC8) {
+      Regs reg = {};
+
+      reg.ax = 0x4f08;
+      reg.bl = 0x00;     // Set DAC width
+      reg.bh = 8;
+      BIOS_Call(0x10, &reg);
+
+      if (reg.ax == 0x004f && reg.bh == 8) {
+         gPalette.dacBits = 8;
+      }
+   }
+}
+
+
+/*
+ * Palette_Set --
+ *
+ *    Load any range of palette entries. This is safe to call from an
+ *    interrupt handler.
+ *
+ *    On the direct path, entries are packed into R, G, B bytes and
+ *    written with a single rep outsb after setting the DAC's write
+ *    index; the DAC advances the index by itself. Interrupts are off
+ *    while we do that, so that nothing can move the index under us.
+ *    That's one port write per byte, but no mode switches and no
+ *    BIOS scratch buffer.
+ */
+
+fastcall void
+Palette_Set(int firstColor, int numColors, const uint32 *colors)
+{
+   const uint32 shift = 8 - gPalette.dacBits;
+   int i;
+
+   if (firstColor < 0 || numColors <= 0 || firstColor + numColors > PALETTE_SIZE) {
+      return;
+   }
+
+   if (gPalette.direct) {
+      uint8 rgb[PALETTE_SIZE * 3];
+      uint8 *p = rgb;
+      Bool iFlag;
+
+      for (i = 0; i < numColors; i++) {
+         uint32 c = colors[i];
+         *(p++) = (uint8)(c >> 16) >> shift;
+         *(p++) = (uint8)(c >> 8) >> shift;
+         *(p++) = (uint8) c >> shift;
+      }
+
+      iFlag = Intr_Save();
+      Intr_Disable();
+      IO_Out8(VGA_DAC_WRITE_INDEX, firstColor);
+      IO_OutString8(VGA_DAC_DATA, rgb, numColors * 3);
+      Intr_Restore(iFlag);
+
+   } else {
+      uint32 bgrx[PALETTE_SIZE];
+      const uint32 mask = (0xFF >> shift) * 0x010101;
+
+      for (i = 0; i < numColors; i++) {
+         bgrx[i] = (colors[i] >> shift) & mask;
+      }
+      VBE_SetPalette(firstColor, numColors, bgrx);
+   }
+}
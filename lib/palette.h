@@ -0,0 +1,62 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * palette.h - VGA DAC palette programming.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PALETTE_H__
+#define __PALETTE_H__
+
+#include "types.h"
+
+#define VGA_DAC_WRITE_INDEX   0x3C8
+#define VGA_DAC_DATA          0x3C9
+#define PALETTE_SIZE          256
+
+/*
+ * Fast palette updates for 8-bit modes. In text modes and
+ * VGA-compatible VBE modes, we write the DAC's I/O ports directly,
+ * with no trip through real mode. Otherwise, we have to go through
+ * VBE_SetPalette().
+ *
+ * Colors are 0x00RRGGBB with 8 bits per component, whatever the
+ * DAC's real width; they're scaled down if it only has 6 bits.
+ */
+
+typedef struct {
+   Bool   direct;         // Write the VGA DAC ports
+   uint32 dacBits;        // 6 or 8
+} PaletteState;
+
+extern PaletteState gPalette;
+
+fastcall void Palette_Init(void);
+fastcall void Palette_Set(int firstColor, int numColors, const uint32 *colors);
+
+#endif /* __PALETTE_H__ */
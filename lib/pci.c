@@ -34,6 +34,7 @@
 
 #include "pci.h"
 #include "io.h"
+#include "stats.h"
 
 /*
  * There can be up to 256 PCI busses, but it takes a noticeable
@@ -46,10 +47,14 @@
 #define PCI_REG_CONFIG_DATA     0xCFC
 
 
+STAT_COUNTER(gPCIConfigStat, "pci.config_accesses");
+
+
 /*
  * PCIConfigPackAddress --
  *
- *    Pack a 32-bit CONFIG_ADDRESS value.
+ *    Pack a 32-bit CONFIG_ADDRESS value. Every config space access
+ *    goes through here, so this is also where we count them.
  */
 
 static fastcall uint32
@@ -57,6 +62,8 @@ PCIConfigPackAddress(const PCIAddress *addr, uint16 offset)
 {
    const uint32 enableBit = 0x80000000UL;
 
+   Stat_Inc(&gPCIConfigStat);
+
    return (((uint32)addr->bus << 16) |
            ((uint32)addr->device << 11) |
            ((uint32)addr->function << 8) |
@@ -0,0 +1,377 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * pixfmt.c - Pixel format conversion.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "pixfmt.h"
+
+/*
+ * Each layout's kernels are generated from one of three templates
+ * below, which are always inlined so that the layout parameters and
+ * the choice of stores are compile-time constants. The SSE2 shift
+ * counts are immediates, so the templates must also stay out of
+ * PROFILE=1 instrumentation, which would stop them from folding.
+ */
+
+#define PIXFMT_TEMPLATE   static inline __attribute__((always_inline, no_instrument_function))
+
+
+/*
+ * PixFmtSwapRB --
+ *
+ *    Exchange the red and blue channels of an ARGB pixel.
+ */
+
+PIXFMT_TEMPLATE uint32
+PixFmtSwapRB(uint32 p)
+{
+   uint32 rb = p & 0x00FF00FF;
+   return (p ^ rb) | (rb << 16) | (rb >> 16);
+}
+
+
+/*
+ * PixFmtStore32 --
+ *
+ *    Store one 32-bit word, with movnti if 'streaming'.
+ */
+
+PIXFMT_TEMPLATE void
+PixFmtStore32(uint32 *dest, uint32 value, Bool streaming)
+{
+   if (streaming) {
+      asm volatile ("movnti %1, %0" : "=m" (*dest) : "r" (value));
+   } else {
+      *dest = value;
+   }
+}
+
+
+/*
+ * PixFmtConvert32 --
+ *
+ *    32 bits per pixel: a copy, or a red/blue swap. The streaming
+ *    version does 64 bytes per iteration for a copy and 16 for a
+ *    swap, after using movnti to reach a 16-byte aligned destination.
+ */
+
+PIXFMT_TEMPLATE void
+PixFmtConvert32(uint32 *dest, const uint32 *src, uint32 count, Bool swap, Bool streaming)
+{
+   uint32 blocks;
+
+   if (!streaming) {
+      if (!swap) {
+         memcpy32(dest, src, count);
+         return;
+      }
+      while (count--) {
+         *(dest++) = PixFmtSwapRB(*(src++));
+      }
+      return;
+   }
+
+   while ((((uint32) dest) & 15) && count) {
+      PixFmtStore32(dest++, swap ? PixFmtSwapRB(*src) : *src, TRUE);
+      src++;
+      count--;
+   }
+
+   if (!swap && (blocks = count / 16)) {
+      asm volatile ("1: \n"
+                    "movdqu    (%1), %%xmm0 \n"
+                    "movdqu  16(%1), %%xmm1 \n"
+                    "movdqu  32(%1), %%xmm2 \n"
+                    "movdqu  48(%1), %%xmm3 \n"
+                    "movntdq %%xmm0,   (%0) \n"
+                    "movntdq %%xmm1, 16(%0) \n"
+                    "movntdq %%xmm2, 32(%0) \n"
+                    "movntdq %%xmm3, 48(%0) \n"
+                    "addl $64, %1 \n"
+                    "addl $64, %0 \n"
+                    "decl %2 \n"
+                    "jnz 1b \n"
+                    : "+r" (dest), "+r" (src), "+r" (blocks) :: "memory");
+      count &= 15;
+   }
+
+   if (swap && (blocks = count / 4)) {
+      asm volatile ("pcmpeqd %%xmm7, %%xmm7 \n"
+                    "psrlw $8, %%xmm7 \n"            // 0x00FF00FF
+                    "1: \n"
+                    "movdqu (%1), %%xmm0 \n"
+                    "movdqa %%xmm7, %%xmm1 \n"
+                    "pand %%xmm0, %%xmm1 \n"         // Red and blue
+                    "pxor %%xmm1, %%xmm0 \n"         // Alpha and green
+                    "movdqa %%xmm1, %%xmm2 \n"
+                    "pslld $16, %%xmm1 \n"
+                    "psrld $16, %%xmm2 \n"
+                    "por %%xmm1, %%xmm0 \n"
+                    "por %%xmm2, %%xmm0 \n"
+                    "movntdq %%xmm0, (%0) \n"
+                    "addl $16, %1 \n"
+                    "addl $16, %0 \n"
+                    "decl %2 \n"
+                    "jnz 1b \n"
+                    : "+r" (dest), "+r" (src), "+r" (blocks) :: "memory");
+      count &= 3;
+   }
+
+   while (count--) {
+      PixFmtStore32(dest++, swap ? PixFmtSwapRB(*src) : *src, TRUE);
+      src++;
+   }
+}
+
+
+/*
+ * PixFmtConvert16 --
+ *
+ *    15 or 16 bits per pixel, with blue in the low 5 bits, 'gBits' of
+ *    green above it, and 5 bits of red at 'rPos'. The streaming
+ *    version converts eight pixels per iteration: each channel is
+ *    shifted and masked in 32-bit lanes, then the lanes are narrowed
+ *    to 16 bits. packssdw saturates, so each lane is sign-extended
+ *    from 16 bits first to make it pass through unchanged.
+ */
+
+PIXFMT_TEMPLATE uint16
+PixFmtPack16(uint32 p, const int gBits, const int rPos)
+{
+   return ((p >> (19 - rPos)) & (0x1F << rPos)) |
+          ((p >> (11 - gBits)) & (((1 << gBits) - 1) << 5)) |
+          ((p >> 3) & 0x1F);
+}
+
+PIXFMT_TEMPLATE void
+PixFmtConvert16(uint16 *dest, const uint32 *src, uint32 count,
+                const int gBits, const int rPos, Bool streaming)
+{
+   uint32 blocks;
+
+   if (streaming) {
+      while ((((uint32) dest) & 15) && count) {
+         *(dest++) = PixFmtPack16(*(src++), gBits, rPos);
+         count--;
+      }
+
+      if ((blocks = count / 8)) {
+         asm volatile ("pcmpeqd %%xmm7, %%xmm7 \n"
+                       "psrld $27, %%xmm7 \n"             // Blue mask
+                       "movdqa %%xmm7, %%xmm5 \n"
+                       "pslld %[rPos], %%xmm5 \n"         // Red mask
+                       "pcmpeqd %%xmm6, %%xmm6 \n"
+                       "psrld %[gMaskShift], %%xmm6 \n"
+                       "pslld $5, %%xmm6 \n"              // Green mask
+                       "1: \n"
+                       "movdqu   (%1), %%xmm0 \n"
+                       "movdqu 16(%1), %%xmm1 \n"
+
+                       "movdqa %%xmm0, %%xmm2 \n"
+                       "psrld $3, %%xmm2 \n"
+                       "pand %%xmm7, %%xmm2 \n"
+                       "movdqa %%xmm0, %%xmm3 \n"
+                       "psrld %[gShift], %%xmm3 \n"
+                       "pand %%xmm6, %%xmm3 \n"
+                       "por %%xmm3, %%xmm2 \n"
+                       "psrld %[rShift], %%xmm0 \n"
+                       "pand %%xmm5, %%xmm0 \n"
+                       "por %%xmm2, %%xmm0 \n"
+
+                       "movdqa %%xmm1, %%xmm2 \n"
+                       "psrld $3, %%xmm2 \n"
+                       "pand %%xmm7, %%xmm2 \n"
+                       "movdqa %%xmm1, %%xmm3 \n"
+                       "psrld %[gShift], %%xmm3 \n"
+                       "pand %%xmm6, %%xmm3 \n"
+                       "por %%xmm3, %%xmm2 \n"
+                       "psrld %[rShift], %%xmm1 \n"
+                       "pand %%xmm5, %%xmm1 \n"
+                       "por %%xmm2, %%xmm1 \n"
+
+                       "pslld $16, %%xmm0 \n"
+                       "psrad $16, %%xmm0 \n"
+                       "pslld $16, %%xmm1 \n"
+                       "psrad $16, %%xmm1 \n"
+                       "packssdw %%xmm1, %%xmm0 \n"
+                       "movntdq %%xmm0, (%0) \n"
+                       "addl $32, %1 \n"
+                       "addl $16, %0 \n"
+                       "decl %2 \n"
+                       "jnz 1b \n"
+                       : "+r" (dest), "+r" (src), "+r" (blocks)
+                       : [rPos] "i" (rPos), [gMaskShift] "i" (32 - gBits),
+                         [gShift] "i" (11 - gBits), [rShift] "i" (19 - rPos)
+                       : "memory");
+         count &= 7;
+      }
+   }
+
+   while (count--) {
+      *(dest++) = PixFmtPack16(*(src++), gBits, rPos);
+   }
+}
+
+
+/*
+ * PixFmtConvert24 --
+ *
+ *    Packed 24 bits per pixel. Storing three bytes at a time would
+ *    mean three byte stores, or an unaligned store per pixel, and
+ *    this is usually going over the bus to video memory. Instead,
+ *    once the destination is 4-byte aligned, each group of four
+ *    pixels is shifted together into three aligned 32-bit words.
+ *
+ *    There's no SSE2 version: without SSSE3's pshufb, moving bytes
+ *    between lanes costs more than it saves. The streaming version
+ *    uses movnti for the 32-bit stores.
+ */
+
+PIXFMT_TEMPLATE void
+PixFmtConvert24(uint8 *dest, const uint32 *src, uint32 count, Bool swap, Bool streaming)
+{
+   uint32 *words;
+   uint32 p;
+
+   while ((((uint32) dest) & 3) && count) {
+      p = swap ? PixFmtSwapRB(*src) : *src;
+      dest[0] = p;
+      dest[1] = p >> 8;
+      dest[2] = p >> 16;
+      dest += 3;
+      src++;
+      count--;
+   }
+
+   words = (uint32*) dest;
+   while (count >= 4) {
+      uint32 p0 = src[0], p1 = src[1], p2 = src[2], p3 = src[3];
+
+      if (swap) {
+         p0 = PixFmtSwapRB(p0);
+         p1 = PixFmtSwapRB(p1);
+         p2 = PixFmtSwapRB(p2);
+         p3 = PixFmtSwapRB(p3);
+      }
+
+      PixFmtStore32(words + 0, (p0 & 0xFFFFFF) | (p1 << 24), streaming);
+      PixFmtStore32(words + 1, ((p1 >> 8) & 0xFFFF) | (p2 << 16), streaming);
+      PixFmtStore32(words + 2, ((p2 >> 16) & 0xFF) | (p3 << 8), streaming);
+      words += 3;
+      src += 4;
+      count -= 4;
+   }
+
+   dest = (uint8*) words;
+   while (count--) {
+      p = swap ? PixFmtSwapRB(*src) : *src;
+      dest[0] = p;
+      dest[1] = p >> 8;
+      dest[2] = p >> 16;
+      dest += 3;
+      src++;
+   }
+}
+
+
+/*
+ * The kernels themselves.
+ */
+
+#define PIXFMT_KERNELS(name, call)                                        \
+   static fastcall void                                                   \
+   PixFmt##name(void *dest, const uint32 *src, uint32 count)              \
+   {                                                                      \
+      const Bool streaming = FALSE;                                       \
+      call;                                                               \
+   }                                                                      \
+   static fastcall void                                                   \
+   PixFmt##name##Streaming(void *dest, const uint32 *src, uint32 count)   \
+   {                                                                      \
+      const Bool streaming = TRUE;                                        \
+      call;                                                               \
+   }
+
+PIXFMT_KERNELS(RGB555, PixFmtConvert16(dest, src, count, 5, 10, streaming))
+PIXFMT_KERNELS(RGB565, PixFmtConvert16(dest, src, count, 6, 11, streaming))
+PIXFMT_KERNELS(RGB888, PixFmtConvert24(dest, src, count, FALSE, streaming))
+PIXFMT_KERNELS(BGR888, PixFmtConvert24(dest, src, count, TRUE, streaming))
+PIXFMT_KERNELS(XRGB8888, PixFmtConvert32(dest, src, count, FALSE, streaming))
+PIXFMT_KERNELS(XBGR8888, PixFmtConvert32(dest, src, count, TRUE, streaming))
+
+#define PIXFMT_ENTRY(name)   { #name, { PixFmt##name, PixFmt##name##Streaming } }
+
+static const struct {
+   const char *name;
+   PixFmtConvertFn kernels[2];
+} gPixFmtTable[VBE_PIXFMT_COUNT] = {
+   [VBE_PIXFMT_UNKNOWN]  = { "unknown" },
+   [VBE_PIXFMT_INDEXED8] = { "indexed8" },
+   [VBE_PIXFMT_RGB555]   = PIXFMT_ENTRY(RGB555),
+   [VBE_PIXFMT_RGB565]   = PIXFMT_ENTRY(RGB565),
+   [VBE_PIXFMT_RGB888]   = PIXFMT_ENTRY(RGB888),
+   [VBE_PIXFMT_BGR888]   = PIXFMT_ENTRY(BGR888),
+   [VBE_PIXFMT_XRGB8888] = PIXFMT_ENTRY(XRGB8888),
+   [VBE_PIXFMT_XBGR8888] = PIXFMT_ENTRY(XBGR8888),
+};
+
+
+/*
+ * PixFmt_GetConverter --
+ *
+ *    Return the kernel that converts ARGB8888 to 'format', or NULL
+ *    if there isn't one. 'streaming' selects the kernel that uses
+ *    SSE2 and non-temporal stores.
+ */
+
+fastcall PixFmtConvertFn
+PixFmt_GetConverter(uint32 format, Bool streaming)
+{
+   if (format >= VBE_PIXFMT_COUNT) {
+      return NULL;
+   }
+   return gPixFmtTable[format].kernels[streaming ? 1 : 0];
+}
+
+
+/*
+ * PixFmt_GetName --
+ *
+ *    Return a short name for a VBE_PIXFMT_* value.
+ */
+
+fastcall const char *
+PixFmt_GetName(uint32 format)
+{
+   if (format >= VBE_PIXFMT_COUNT) {
+      return "unknown";
+   }
+   return gPixFmtTable[format].name;
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * pixfmt.h - Pixel format conversion.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PIXFMT_H__
+#define __PIXFMT_H__
+
+#include "types.h"
+#include "vbe.h"
+
+/*
+ * Kernels that convert a run of pixels from canonical ARGB8888
+ * (0xAARRGGBB in a uint32) to one of the native VBE_PIXFMT_*
+ * layouts. Alpha is dropped, except by the 32-bit layouts, which
+ * carry it into their unused byte.
+ *
+ * Each layout has a plain kernel and a streaming one. The streaming
+ * kernels need SSE2 and the XMM registers (CPU_EnableSSE()), and
+ * write with non-temporal stores. After using them, the caller must
+ * execute an sfence before anything else reads the destination.
+ */
+
+typedef fastcall void (*PixFmtConvertFn)(void *dest, const uint32 *src, uint32 count);
+
+fastcall PixFmtConvertFn PixFmt_GetConverter(uint32 format, Bool streaming);
+fastcall const char *PixFmt_GetName(uint32 format);
+
+#endif /* __PIXFMT_H__ */
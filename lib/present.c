@@ -0,0 +1,241 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * present.c - Damage-tracked framebuffer presentation.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "present.h"
+#include "vbe.h"
+#include "cpu.h"
+#include "pixfmt.h"
+#include "stats.h"
+
+PresentState gPresent;
+
+STAT_COUNTER(gPresentRectStat, "present.rects");
+STAT_COUNTER(gPresentByteStat, "present.bytes");
+
+
+/*
+ * Present_Init --
+ *
+ *    Start presenting to the current VBE mode, from an ARGB8888 back
+ *    buffer of the same size. The back buffer's pitch doesn't need to
+ *    match the framebuffer's.
+ *
+ *    The whole screen starts out damaged. Returns FALSE if the mode
+ *    has no linear framebuffer, is too large, or has a pixel format
+ *    we can't convert to.
+ */
+
+fastcall Bool
+Present_Init(void *backBuffer, uint32 backPitch)
+{
+   VBEModeInfo *info = &gVBE.current.info;
+
+   if (!(info->attributes & VBE_MODEATTR_LINEAR) ||
+       info->width > PRESENT_MAX_WIDTH ||
+       info->height > PRESENT_MAX_HEIGHT ||
+       !PixFmt_GetConverter(gVBE.current.format, FALSE)) {
+      return FALSE;
+   }
+
+   gPresent.back = backBuffer;
+   gPresent.backPitch = backPitch;
+   gPresent.front = info->linearAddress;
+   gPresent.frontPitch = info->bytesPerLine;
+   gPresent.width = info->width;
+   gPresent.height = info->height;
+   gPresent.bytesPerPixel = (info->bitsPerPixel + 7) / 8;
+   gPresent.tilesX = roundup(info->width, PRESENT_TILE_SIZE);
+   gPresent.tilesY = roundup(info->height, PRESENT_TILE_SIZE);
+   gPresent.streaming = CPU_EnableSSE();
+
+   Present_DamageAll();
+   return TRUE;
+}
+
+
+/*
+ * PresentSetBits --
+ *
+ *    Mark tiles 'first' through 'last' (inclusive) on one row dirty.
+ */
+
+static fastcall void
+PresentSetBits(uint32 *row, uint32 first, uint32 last)
+{
+   uint32 tx;
+
+   for (tx = first; tx <= last; tx++) {
+      row[tx >> 5] |= 1 << (tx & 31);
+   }
+}
+
+
+/*
+ * PresentFindBit --
+ *
+ *    Starting at tile 'tx', find the first tile on a row that is
+ *    dirty (invert == 0) or clean (invert == ~0). Returns 'limit' if
+ *    there's no such tile. Whole words are skipped at a time.
+ */
+
+static fastcall uint32
+PresentFindBit(const uint32 *row, uint32 tx, uint32 limit, uint32 invert)
+{
+   while (tx < limit) {
+      uint32 word = (row[tx >> 5] ^ invert) >> (tx & 31);
+
+      if (word) {
+         return MIN(limit, tx + __builtin_ctz(word));
+      }
+      tx = (tx | 31) + 1;
+   }
+   return limit;
+}
+
+
+/*
+ * PresentTakeSpan --
+ *
+ *    If tiles 'first' through 'last' on a row are all dirty, mark
+ *    them clean and return TRUE.
+ */
+
+static fastcall Bool
+PresentTakeSpan(uint32 *row, uint32 first, uint32 last)
+{
+   uint32 tx;
+
+   for (tx = first; tx <= last; tx++) {
+      if (!(row[tx >> 5] & (1 << (tx & 31)))) {
+         return FALSE;
+      }
+   }
+   for (tx = first; tx <= last; tx++) {
+      row[tx >> 5] &= ~(1 << (tx & 31));
+   }
+   return TRUE;
+}
+
+
+/*
+ * Present_Damage --
+ *
+ *    Mark a rectangle of the back buffer as changed since the last
+ *    flush. It's clipped to the screen.
+ */
+
+fastcall void
+Present_Damage(int x, int y, int width, int height)
+{
+   int x1 = MIN(x + width, (int) gPresent.width);
+   int y1 = MIN(y + height, (int) gPresent.height);
+   int ty;
+
+   x = MAX(x, 0);
+   y = MAX(y, 0);
+   if (x >= x1 || y >= y1) {
+      return;
+   }
+
+   for (ty = y >> PRESENT_TILE_SHIFT; ty <= (y1 - 1) >> PRESENT_TILE_SHIFT; ty++) {
+      PresentSetBits(gPresent.dirty[ty], x >> PRESENT_TILE_SHIFT,
+                     (x1 - 1) >> PRESENT_TILE_SHIFT);
+   }
+}
+
+
+/*
+ * Present_DamageAll --
+ *
+ *    Mark the whole screen as changed.
+ */
+
+fastcall void
+Present_DamageAll(void)
+{
+   Present_Damage(0, 0, gPresent.width, gPresent.height);
+}
+
+
+/*
+ * Present_Flush --
+ *
+ *    Convert every damaged part of the back buffer to the screen, and
+ *    mark the screen clean.
+ *
+ *    Each run of dirty tiles along a tile row becomes a span. The
+ *    span grows downward for as long as the rows below have the same
+ *    tiles dirty, so a damaged rectangle is copied as one rectangle
+ *    no matter how many tile rows it covers.
+ */
+
+fastcall void
+Present_Flush(void)
+{
+   PixFmtConvertFn convert = PixFmt_GetConverter(gVBE.current.format, gPresent.streaming);
+   const uint32 bpp = gPresent.bytesPerPixel;
+   uint32 ty;
+
+   for (ty = 0; ty < gPresent.tilesY; ty++) {
+      uint32 *row = gPresent.dirty[ty];
+      uint32 tx = 0;
+
+      while ((tx = PresentFindBit(row, tx, gPresent.tilesX, 0)) < gPresent.tilesX) {
+         uint32 end = PresentFindBit(row, tx, gPresent.tilesX, ~0);
+         uint32 ty1 = ty + 1;
+         uint32 x0, x1, y, y1;
+
+         PresentTakeSpan(row, tx, end - 1);
+         while (ty1 < gPresent.tilesY &&
+                PresentTakeSpan(gPresent.dirty[ty1], tx, end - 1)) {
+            ty1++;
+         }
+
+         x0 = tx << PRESENT_TILE_SHIFT;
+         x1 = MIN(end << PRESENT_TILE_SHIFT, gPresent.width);
+         y1 = MIN(ty1 << PRESENT_TILE_SHIFT, gPresent.height);
+
+         for (y = ty << PRESENT_TILE_SHIFT; y < y1; y++) {
+            convert(gPresent.front + y * gPresent.frontPitch + x0 * bpp,
+                    Present_BackBuffer(x0, y), x1 - x0);
+         }
+
+         Stat_Inc(&gPresentRectStat);
+         Stat_Add(&gPresentByteStat, (x1 - x0) * bpp * (y1 - (ty << PRESENT_TILE_SHIFT)));
+         tx = end;
+      }
+   }
+
+   if (gPresent.streaming) {
+      asm volatile ("sfence" ::: "memory");
+   }
+}
@@ -0,0 +1,97 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * present.h - Damage-tracked framebuffer presentation.
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PRESENT_H__
+#define __PRESENT_H__
+
+#include "types.h"
+
+/*
+ * A presentation layer for apps that redraw only part of the screen
+ * each frame. The app draws into a back buffer in system RAM, and
+ * tells us which rectangles it touched. Present_Flush() copies just
+ * those parts to the linear framebuffer of the current VBE mode.
+ *
+ * The back buffer is always ARGB8888. Pixels are converted to the
+ * mode's own format on their way to the screen, by a pixfmt kernel
+ * chosen for the mode when presentation starts.
+ *
+ * Damage is tracked per tile in a bitmap. At flush time, runs of
+ * dirty tiles along a row are merged into spans, and identical spans
+ * on the rows below are merged into rectangles.
+ *
+ * If the CPU has SSE2, the conversion uses non-temporal (streaming)
+ * stores. The framebuffer is never read back, so there's no reason
+ * to let it push the app's working set out of the cache.
+ */
+
+#define PRESENT_TILE_SHIFT      4     // 16x16 pixel tiles
+#define PRESENT_TILE_SIZE       (1 << PRESENT_TILE_SHIFT)
+#define PRESENT_MAX_WIDTH       2048
+#define PRESENT_MAX_HEIGHT      1536
+#define PRESENT_MAX_TILES_X     (PRESENT_MAX_WIDTH / PRESENT_TILE_SIZE)
+#define PRESENT_MAX_TILES_Y     (PRESENT_MAX_HEIGHT / PRESENT_TILE_SIZE)
+#define PRESENT_BITMAP_WORDS    (PRESENT_MAX_TILES_X / 32)
+
+typedef struct {
+   uint8       *back;               // ARGB8888 back buffer, in system RAM
+   uint32       backPitch;
+   uint8       *front;              // Linear framebuffer
+   uint32       frontPitch;
+   uint32       width, height;
+   uint32       bytesPerPixel;      // In the framebuffer
+   uint32       tilesX, tilesY;
+   Bool         streaming;          // Use SSE2 streaming stores. May be cleared.
+   uint32       dirty[PRESENT_MAX_TILES_Y][PRESENT_BITMAP_WORDS];
+} PresentState;
+
+extern PresentState gPresent;
+
+fastcall Bool Present_Init(void *backBuffer, uint32 backPitch);
+fastcall void Present_Damage(int x, int y, int width, int height);
+fastcall void Present_DamageAll(void);
+fastcall void Present_Flush(void);
+
+
+/*
+ * Present_BackBuffer --
+ *
+ *    Return the address of one pixel in the back buffer.
+ */
+
+static inline uint32 *
+Present_BackBuffer(int x, int y)
+{
+   return (uint32*) (gPresent.back + y * gPresent.backPitch) + x;
+}
+
+#endif /* __PRESENT_H__ */
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+#
+# Symbolize a Metalkit profiler dump (see Profiler_Dump in profiler.c)
+# and print it as folded stacks, one "outer;...;inner count" line per
+# unique stack. Feed the output to flamegraph.pl, or load it in
+# speedscope.
+#
+#   python3 profile2folded.py app.elf < serial.txt > app.folded
+#
+# Symbols come from 'nm', like the 'sizeprof' make target. Set $NM to
+# use a different nm. If the dump has stack samples they're used;
+# otherwise each flat histogram entry becomes a one-frame stack.
+#
+
+import bisect
+import collections
+import os
+import subprocess
+import sys
+
+
+def loadSymbols(elf):
+    nm = os.environ.get("NM", "nm")
+    out = subprocess.run([nm, "-n", "--defined-only", elf],
+                         check=True, capture_output=True, text=True).stdout
+    addrs, names = [], []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[1] in "tTwW":
+            addrs.append(int(fields[0], 16))
+            names.append(fields[2])
+    return addrs, names
+
+
+def symbolize(symbols, addr):
+    addrs, names = symbols
+    i = bisect.bisect_right(addrs, addr) - 1
+    if i < 0:
+        return "0x%08x" % addr
+    return names[i]
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: %s app.elf < dump" % sys.argv[0])
+
+    symbols = loadSymbols(sys.argv[1])
+    flat = collections.Counter()
+    stacks = collections.Counter()
+
+    for line in sys.stdin:
+        fields = line.strip().split("\t")
+        if len(fields) != 4 or fields[0] != "PROFILE":
+            continue
+        kind, count, addrs = fields[1], int(fields[2]), fields[3].split(",")
+
+        # Return addresses point after the call; step back into it.
+        frames = [int(addrs[0], 16)] + [int(a, 16) - 1 for a in addrs[1:]]
+        names = tuple(symbolize(symbols, a) for a in reversed(frames))
+
+        if kind == "flat":
+            flat[names] += count
+        elif kind == "stack":
+            stacks[names] += count
+
+    for names, count in sorted((stacks or flat).items()):
+        print("%s %d" % (";".join(names), count))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,425 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * profiler.c - Sampling profiler driven by the RTC periodic interrupt
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "profiler.h"
+#include "console.h"
+#include "intr.h"
+#include "io.h"
+
+/*
+ * MC146818 real-time clock. Its periodic interrupt rate is
+ * 32768 >> (rate - 1) Hz, so rate 3 gives us 8192 Hz. The interrupt
+ * isn't delivered again until register C has been read.
+ */
+
+#define RTC_INDEX_PORT     0x70
+#define RTC_DATA_PORT      0x71
+#define RTC_IRQ            8
+
+#define RTC_REG_A          0x0A
+#define RTC_REG_B          0x0B
+#define RTC_REG_C          0x0C
+
+#define RTC_A_RATE_MASK    0x0F
+#define RTC_A_RATE_8192HZ  0x03
+#define RTC_B_PIE          (1 << 6)   // Periodic interrupt enable
+
+/*
+ * Frame pointers farther apart than this are assumed to be garbage,
+ * and end the stack walk.
+ */
+#define PROFILER_MAX_FRAME_SIZE  0x10000
+
+/*
+ * How far to probe in the hash table before giving up on a sample.
+ */
+#define PROFILER_MAX_PROBES      16
+
+ProfilerState gProfiler;
+
+
+/*
+ * ProfilerReadRTC --
+ * ProfilerWriteRTC --
+ *
+ *    Access RTC registers. Must be called with interrupts disabled,
+ *    since the index register is shared.
+ */
+
+static fastcall uint8
+ProfilerReadRTC(uint8 reg)
+{
+   IO_Out8(RTC_INDEX_PORT, reg);
+   return IO_In8(RTC_DATA_PORT);
+}
+
+static fastcall void
+ProfilerWriteRTC(uint8 reg, uint8 value)
+{
+   IO_Out8(RTC_INDEX_PORT, reg);
+   IO_Out8(RTC_DATA_PORT, value);
+}
+
+
+/*
+ * ProfilerCount --
+ *
+ *    Add one sample at 'eip' to the flat histogram.
+ */
+
+static fastcall void
+ProfilerCount(uint32 eip)
+{
+   uint32 index = (eip * 2654435761U) >> (32 - PROFILER_HASH_BITS);
+   int probes;
+
+   for (probes = PROFILER_MAX_PROBES; probes; probes--) {
+      ProfilerBucket *bucket = &gProfiler.buckets[index];
+
+      if (bucket->count == 0) {
+         bucket->eip = eip;
+         bucket->count = 1;
+         return;
+      }
+      if (bucket->eip == eip) {
+         bucket->count++;
+         return;
+      }
+
+      index = (index + 1) & (PROFILER_HASH_SIZE - 1);
+   }
+
+   gProfiler.dropped++;
+}
+
+
+/*
+ * ProfilerStackSlot --
+ *
+ *    Choose where the next stack sample goes: the next free slot
+ *    until the buffer is full, then, with probability
+ *    PROFILER_STACK_SAMPLES / samples taken, a random stored sample
+ *    to replace. Returns PROFILER_STACK_SAMPLES to discard it.
+ */
+
+static fastcall uint32
+ProfilerStackSlot(void)
+{
+   uint32 taken = gProfiler.stackSamples++;
+
+   if (taken < PROFILER_STACK_SAMPLES) {
+      gProfiler.numStacks = taken + 1;
+      return taken;
+   }
+
+   gProfiler.seed = gProfiler.seed * 1103515245 + 12345;
+   return MIN((gProfiler.seed >> 8) % (taken + 1), PROFILER_STACK_SAMPLES);
+}
+
+
+/*
+ * ProfilerWalkStack --
+ *
+ *    Record, in 'stack', %eip and the return addresses of up to
+ *    PROFILER_MAX_DEPTH - 1 callers. Each frame pointer must be
+ *    above the last one, starting from the interrupted %esp, and
+ *    not too far away. We have no paging, so a bad pointer can't
+ *    fault, but it can produce nonsense.
+ */
+
+static fastcall void
+ProfilerWalkStack(IntrContext *ctx, uint32 *stack)
+{
+   /*
+    * The saved %esp still includes the three words pushed by the
+    * interrupt itself; see Console_UnhandledFault().
+    */
+   uint32 esp = ctx->esp + 3 * sizeof(uint32);
+   uint32 ebp = ctx->ebp;
+   int depth;
+
+   stack[0] = ctx->eip;
+
+   /*
+    * Code that doesn't keep a frame pointer may be using %ebp for
+    * anything. Only follow it if it points into the live stack.
+    */
+   if (ebp < esp || ebp - esp > PROFILER_MAX_FRAME_SIZE) {
+      ebp = 0;
+   }
+
+   for (depth = 1; depth < PROFILER_MAX_DEPTH; depth++) {
+      uint32 *frame = (uint32*) ebp;
+      uint32 next;
+
+      if (ebp == 0 || (ebp & 3)) {
+         break;
+      }
+
+      stack[depth] = frame[1];
+      next = frame[0];
+
+      if (next <= ebp || next - ebp > PROFILER_MAX_FRAME_SIZE) {
+         depth++;
+         break;
+      }
+      ebp = next;
+   }
+
+   for (; depth < PROFILER_MAX_DEPTH; depth++) {
+      stack[depth] = 0;
+   }
+}
+
+
+/*
+ * ProfilerIRQ --
+ *
+ *    RTC periodic interrupt: take one sample of the code we
+ *    interrupted.
+ */
+
+static void
+ProfilerIRQ(int vector)
+{
+   IntrContext *ctx = Intr_GetContext(vector);
+
+   /*
+    * The context lies past the end of 'vector' as far as gcc knows,
+    * and -Warray-bounds objects to reading it. Hide where it came from.
+    */
+   asm ("" : "+r" (ctx));
+
+   ProfilerReadRTC(RTC_REG_C);
+
+   gProfiler.samples++;
+   ProfilerCount(ctx->eip);
+
+   if (gProfiler.flags & PROFILER_STACKS) {
+      uint32 slot = ProfilerStackSlot();
+
+      if (slot < PROFILER_STACK_SAMPLES) {
+         ProfilerWalkStack(ctx, gProfiler.stacks[slot]);
+      }
+   }
+}
+
+
+/*
+ * Profiler_Start --
+ * Profiler_Stop --
+ *
+ *    Turn the RTC's periodic interrupt on or off. Samples are kept
+ *    until Profiler_Reset().
+ */
+
+fastcall void
+Profiler_Start(void)
+{
+   Bool iFlag = Intr_Save();
+
+   Intr_Disable();
+   ProfilerWriteRTC(RTC_REG_A, (ProfilerReadRTC(RTC_REG_A) & ~RTC_A_RATE_MASK)
+                    | RTC_A_RATE_8192HZ);
+   ProfilerWriteRTC(RTC_REG_B, ProfilerReadRTC(RTC_REG_B) | RTC_B_PIE);
+   ProfilerReadRTC(RTC_REG_C);
+   Intr_SetMask(RTC_IRQ, TRUE);
+   Intr_Restore(iFlag);
+}
+
+fastcall void
+Profiler_Stop(void)
+{
+   Bool iFlag = Intr_Save();
+
+   Intr_Disable();
+   ProfilerWriteRTC(RTC_REG_B, ProfilerReadRTC(RTC_REG_B) & ~RTC_B_PIE);
+   Intr_SetMask(RTC_IRQ, FALSE);
+   Intr_Restore(iFlag);
+}
+
+
+/*
+ * Profiler_Reset --
+ *
+ *    Discard all samples.
+ */
+
+fastcall void
+Profiler_Reset(void)
+{
+   Bool iFlag = Intr_Save();
+
+   Intr_Disable();
+   gProfiler.samples = 0;
+   gProfiler.dropped = 0;
+   gProfiler.numStacks = 0;
+   gProfiler.stackSamples = 0;
+   memset(gProfiler.buckets, 0, sizeof gProfiler.buckets);
+   Intr_Restore(iFlag);
+}
+
+
+/*
+ * Profiler_Init --
+ *
+ *    Install the RTC interrupt handler. 'flags' may include
+ *    PROFILER_STACKS, which needs an image built with
+ *    FRAME_POINTERS=1. Sampling doesn't begin until Profiler_Start().
+ */
+
+fastcall void
+Profiler_Init(uint32 flags)
+{
+#ifndef FRAME_POINTERS
+   if (flags & PROFILER_STACKS) {
+      Console_Panic("PROFILER_STACKS needs an image built with FRAME_POINTERS=1.");
+   }
+#endif
+
+   Profiler_Stop();
+   Profiler_Reset();
+   gProfiler.flags = flags;
+   Intr_SetHandler(IRQ_VECTOR(RTC_IRQ), ProfilerIRQ);
+}
+
+
+/*
+ * Profiler_Report --
+ *
+ *    Print the 'topN' most frequently sampled addresses on the
+ *    console. Symbolize them with addr2line or the .lst file.
+ */
+
+fastcall void
+Profiler_Report(int topN)
+{
+   uint32 lastCount = 0xFFFFFFFF;
+   int lastIndex = -1;
+
+   Console_Format("%u samples, %u dropped\n",
+                  gProfiler.samples, gProfiler.dropped);
+   if (gProfiler.flags & PROFILER_STACKS) {
+      Console_Format("%u of %u stack samples kept\n",
+                     gProfiler.numStacks, gProfiler.stackSamples);
+   }
+   Console_Format(" Samples  Share  Address\n");
+
+   /*
+    * Selection by (count descending, index ascending). Quadratic,
+    * but the table is small and this isn't time critical.
+    */
+   while (topN--) {
+      int i, best = -1;
+
+      for (i = 0; i < PROFILER_HASH_SIZE; i++) {
+         uint32 count = gProfiler.buckets[i].count;
+
+         if (count == 0 || count > lastCount || (count == lastCount && i <= lastIndex)) {
+            continue;
+         }
+         if (best < 0 || count > gProfiler.buckets[best].count) {
+            best = i;
+         }
+      }
+
+      if (best < 0) {
+         break;
+      }
+
+      lastCount = gProfiler.buckets[best].count;
+      lastIndex = best;
+
+      uint32 permille = (uint64)lastCount * 1000 / gProfiler.samples;
+      Console_Format("%8u %3u.%u%%  %08x\n", lastCount,
+                     permille / 10, permille % 10, gProfiler.buckets[best].eip);
+   }
+}
+
+
+/*
+ * ProfilerDumpLine --
+ *
+ *    Console_Format() to a specific console.
+ */
+
+static void
+ProfilerDumpLine(const ConsoleInterface *console, const char *fmt, ...)
+{
+   char line[128];
+
+   Console_WriteTo(console, line, Console_FormatToBuffer(line, sizeof line, &fmt));
+}
+
+
+/*
+ * Profiler_Dump --
+ *
+ *    Write every sample to 'console', usually the serial console,
+ *    for lib/profile2folded.py. One line per histogram bucket, then
+ *    one line per stored stack sample, innermost frame first:
+ *
+ *       PROFILE<tab>flat<tab><count><tab><eip>
+ *       PROFILE<tab>stack<tab>1<tab><eip>,<return>,<return>...
+ *
+ *    Stop the profiler first.
+ */
+
+fastcall void
+Profiler_Dump(const ConsoleInterface *console)
+{
+   uint32 i;
+
+   ProfilerDumpLine(console, "PROFILE\tbegin\t%u\t%u\n", gProfiler.samples, PROFILER_HZ);
+
+   for (i = 0; i < PROFILER_HASH_SIZE; i++) {
+      ProfilerBucket *bucket = &gProfiler.buckets[i];
+      if (bucket->count) {
+         ProfilerDumpLine(console, "PROFILE\tflat\t%u\t%08x\n", bucket->count, bucket->eip);
+      }
+   }
+
+   for (i = 0; i < gProfiler.numStacks; i++) {
+      uint32 *stack = gProfiler.stacks[i];
+      int depth;
+
+      ProfilerDumpLine(console, "PROFILE\tstack\t1\t%08x", stack[0]);
+      for (depth = 1; depth < PROFILER_MAX_DEPTH && stack[depth]; depth++) {
+         ProfilerDumpLine(console, ",%08x", stack[depth]);
+      }
+      ProfilerDumpLine(console, "\n");
+   }
+
+   ProfilerDumpLine(console, "PROFILE\tend\n");
+   console->flush();
+}
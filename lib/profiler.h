@@ -0,0 +1,94 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * profiler.h - Sampling profiler driven by the RTC periodic interrupt
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "types.h"
+#include "console.h"
+
+/*
+ * The profiler samples the interrupted %eip from the RTC's periodic
+ * interrupt (IRQ 8, 8192 Hz). That's independent of the PIT, which
+ * apps tend to use for themselves. Note that the HPET's legacy
+ * replacement mode takes over IRQ 8, so don't use both.
+ *
+ * Samples accumulate in a flat histogram, keyed by exact address.
+ * With PROFILER_STACKS, each sample also records a short call stack
+ * by following saved frame pointers; this needs an app built with
+ * "make FRAME_POINTERS=1", and Profiler_Init() panics without it.
+ * Once PROFILER_STACK_SAMPLES stacks are stored, new ones replace
+ * old ones at random (reservoir sampling), so the stored stacks stay
+ * a uniform sample of the whole run.
+ *
+ * Profiler_Report() prints the hottest addresses on the console.
+ * Profiler_Dump() writes every sample in a text format that
+ * lib/profile2folded.py symbolizes against the app's .elf, producing
+ * folded stacks for flamegraph.pl or speedscope:
+ *
+ *    make profile-folded PROFILE_DUMP=serial.txt > app.folded
+ */
+
+#define PROFILER_HZ             8192
+#define PROFILER_HASH_BITS      12
+#define PROFILER_HASH_SIZE      (1 << PROFILER_HASH_BITS)
+#define PROFILER_MAX_DEPTH      8        // Frames per stack sample, including %eip
+#define PROFILER_STACK_SAMPLES  4096
+
+#define PROFILER_STACKS         (1 << 0)
+
+typedef struct {
+   uint32 eip;
+   uint32 count;
+} ProfilerBucket;
+
+typedef struct {
+   uint32 flags;
+   uint32 samples;
+   uint32 dropped;            // Samples that didn't fit in the hash table
+   uint32 numStacks;          // Stack samples stored
+   uint32 stackSamples;       // Stack samples taken
+   uint32 seed;               // Reservoir sampling PRNG state
+   ProfilerBucket buckets[PROFILER_HASH_SIZE];
+   uint32 stacks[PROFILER_STACK_SAMPLES][PROFILER_MAX_DEPTH];
+} ProfilerState;
+
+extern ProfilerState gProfiler;
+
+fastcall void Profiler_Init(uint32 flags);
+fastcall void Profiler_Start(void);
+fastcall void Profiler_Stop(void);
+fastcall void Profiler_Reset(void);
+fastcall void Profiler_Report(int topN);
+fastcall void Profiler_Dump(const ConsoleInterface *console);
+
+#endif /* __PROFILER_H__ */
@@ -65,6 +65,10 @@
 
 #include <setjmp.h>             /* for setjmp(), longjmp(), and jmp_buf */
 #include "puff.h"               /* prototype for puff() */
+#ifndef TEST
+#include "stats.h"              /* for Metalkit's bytes-inflated counter */
+STAT_COUNTER(puffBytesStat, "puff.bytes_inflated");
+#endif
 
 #define local static            /* for local function definitions */
 #define NIL ((unsigned char *)0)        /* for no output option */
@@ -778,6 +782,9 @@ int puff(unsigned char *dest,           /* pointer to destination pointer */
     if (err <= 0) {
         *destlen = s.outcnt;
         *sourcelen = s.incnt;
+#ifndef TEST
+        Stat_Add(&puffBytesStat, s.outcnt);
+#endif
     }
     return err;
 }
@@ -0,0 +1,127 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * stats.c - Global statistics registry
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "stats.h"
+#include "console.h"
+
+static const char *gStatTypeNames[] = {
+   [STAT_TYPE_COUNTER]   = "counter",
+   [STAT_TYPE_GAUGE]     = "gauge",
+   [STAT_TYPE_HISTOGRAM] = "histogram",
+};
+
+
+/*
+ * Stats_Reset --
+ *
+ *    Zero every counter and histogram. Gauges keep their values,
+ *    since they describe the present rather than accumulate.
+ */
+
+fastcall void
+Stats_Reset(void)
+{
+   Stat *stat;
+
+   for (stat = _stats_start; stat < _stats_end; stat++) {
+      if (stat->type == STAT_TYPE_GAUGE) {
+         continue;
+      }
+      stat->value = 0;
+      if (stat->type == STAT_TYPE_HISTOGRAM) {
+         stat->sum = 0;
+         memset32((void*) stat->buckets, 0, STAT_HISTOGRAM_BUCKETS);
+      }
+   }
+}
+
+
+/*
+ * StatsDumpLine --
+ *
+ *    Console_Format() to a specific console.
+ */
+
+static void
+StatsDumpLine(const ConsoleInterface *console, const char *fmt, ...)
+{
+   char line[80];
+
+   Console_WriteTo(console, line, Console_FormatToBuffer(line, sizeof line, &fmt));
+}
+
+
+/*
+ * Stats_Dump --
+ *
+ *    Write every stat to 'console', one tab-separated line each:
+ *
+ *       STAT<tab>counter<tab><name><tab><value>
+ *       STAT<tab>gauge<tab><name><tab><value>
+ *       STAT<tab>histogram<tab><name><tab><count><tab><sum><tab><buckets>
+ *
+ *    where <buckets> is a comma-separated list of bucket counts,
+ *    starting at bucket 0 and ending at the last non-empty one.
+ */
+
+fastcall void
+Stats_Dump(const ConsoleInterface *console)
+{
+   Stat *stat;
+
+   StatsDumpLine(console, "STAT\tbegin\t%d\n", _stats_end - _stats_start);
+
+   for (stat = _stats_start; stat < _stats_end; stat++) {
+      StatsDumpLine(console, "STAT\t%s\t%s\t%u", gStatTypeNames[stat->type],
+                    stat->name, stat->value);
+
+      if (stat->type == STAT_TYPE_HISTOGRAM) {
+         int last = STAT_HISTOGRAM_BUCKETS - 1;
+         int i;
+
+         while (last > 0 && !stat->buckets[last]) {
+            last--;
+         }
+
+         StatsDumpLine(console, "\t%llu\t", stat->sum);
+         for (i = 0; i <= last; i++) {
+            StatsDumpLine(console, i ? ",%u" : "%u", stat->buckets[i]);
+         }
+      }
+
+      StatsDumpLine(console, "\n");
+   }
+
+   StatsDumpLine(console, "STAT\tend\n");
+   console->flush();
+}
@@ -0,0 +1,141 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * stats.h - Global statistics registry
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include "types.h"
+#include "console.h"
+
+/*
+ * Statistics are always on. Each one is a Stat declared at file
+ * scope, in the module that owns it, with one of the STAT_* macros
+ * below. The linker collects them all into a table bounded by
+ * _stats_start and _stats_end, so there's no registration step,
+ * and Stats_Dump() or the dashboard can walk every stat in the
+ * image.
+ *
+ * Updates are a single read-modify-write instruction on the stat,
+ * which an interrupt can't split, so stats may be updated from IRQ
+ * handlers without locking. Readers may see a histogram's count,
+ * sum, and buckets a sample apart.
+ *
+ *   STAT_COUNTER    Counts events. Stat_Inc() or Stat_Add().
+ *   STAT_GAUGE      Holds the latest value of something. Stat_Set().
+ *   STAT_HISTOGRAM  Stat_Sample() tallies samples into power-of-two
+ *                   buckets, and keeps their count and sum.
+ */
+
+#define STAT_TYPE_COUNTER       0
+#define STAT_TYPE_GAUGE         1
+#define STAT_TYPE_HISTOGRAM     2
+
+#define STAT_HISTOGRAM_BUCKETS  32     // Bucket n holds [2^n, 2^(n+1))
+
+/*
+ * Every Stat is the same size and alignment, so the linker's table
+ * is a plain array.
+ */
+typedef struct {
+   const char *name;
+   uint32 type;
+   volatile uint32 value;     // Counter or gauge value, or histogram samples
+   volatile uint64 sum;       // Histograms only
+   volatile uint32 *buckets;  // Histograms only
+} ALIGNED(32) Stat;
+
+extern Stat _stats_start[];
+extern Stat _stats_end[];
+
+#define STAT_SECTION  __attribute__ ((section(".stats"), used))
+
+/*
+ * Declarations. 'var' is the C name, 'name' a string literal for
+ * display. Stats are static; other modules reach them through the
+ * table.
+ */
+
+#define STAT_COUNTER(var, name) \
+   static Stat var STAT_SECTION = { name, STAT_TYPE_COUNTER }
+
+#define STAT_GAUGE(var, name) \
+   static Stat var STAT_SECTION = { name, STAT_TYPE_GAUGE }
+
+#define STAT_HISTOGRAM(var, name)                                       \
+   static volatile uint32 var##Buckets[STAT_HISTOGRAM_BUCKETS];         \
+   static Stat var STAT_SECTION = { name, STAT_TYPE_HISTOGRAM, .buckets = var##Buckets }
+
+
+static inline void
+Stat_Inc(Stat *stat)
+{
+   asm volatile ("incl %0" : "+m" (stat->value));
+}
+
+static inline void
+Stat_Add(Stat *stat, uint32 n)
+{
+   asm volatile ("addl %1, %0" : "+m" (stat->value) : "ri" (n));
+}
+
+static inline void
+Stat_Set(Stat *stat, uint32 value)
+{
+   stat->value = value;
+}
+
+/*
+ * Stat_Sample --
+ *
+ *    Add one sample to a histogram. The 64-bit sum is an add/adc
+ *    pair; an interrupt between the two saves and restores our
+ *    carry, so the total still comes out right.
+ */
+
+static inline void
+Stat_Sample(Stat *stat, uint32 sample)
+{
+   uint32 bucket = 0;
+
+   if (sample) {
+      asm ("bsrl %1, %0" : "=r" (bucket) : "rm" (sample));
+   }
+
+   asm volatile ("incl %0" : "+m" (stat->buckets[bucket]));
+   asm volatile ("incl %0" : "+m" (stat->value));
+   asm volatile ("addl %1, %0 \n adcl $0, 4+%0" : "+m" (stat->sum) : "r" (sample));
+}
+
+fastcall void Stats_Reset(void);
+fastcall void Stats_Dump(const ConsoleInterface *console);
+
+#endif /* __STATS_H__ */
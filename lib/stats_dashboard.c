@@ -0,0 +1,239 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * stats_dashboard.c - Live on-screen statistics dashboard
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "stats.h"
+#include "stats_dashboard.h"
+#include "console_vga.h"
+#include "keyboard.h"
+
+#define DASHBOARD_COLUMNS     2
+#define DASHBOARD_CELL_WIDTH  (VGA_TEXT_WIDTH / DASHBOARD_COLUMNS)
+#define DASHBOARD_ROWS        (VGA_TEXT_HEIGHT - 1)   // Below the title
+
+#define DASHBOARD_TITLE_ATTR  ((VGA_COLOR_BLUE << 4) | VGA_COLOR_WHITE)
+#define DASHBOARD_NAME_ATTR   ((VGA_COLOR_BLACK << 4) | VGA_COLOR_LIGHT_GRAY)
+#define DASHBOARD_VALUE_ATTR  ((VGA_COLOR_BLACK << 4) | VGA_COLOR_YELLOW)
+
+static struct {
+   Keycode toggleKey;
+   Keycode dumpKey;
+   const ConsoleInterface *dumpConsole;
+   KeyboardIRQHandler nextHandler;
+   volatile Bool shown;
+
+   /*
+    * Frames are drawn here and copied to the overlay page in one go,
+    * so a refresh never shows a half-drawn screen.
+    */
+   uint16 frame[VGA_TEXT_WIDTH * VGA_TEXT_HEIGHT];
+} gStatsDashboard;
+
+
+/*
+ * StatsDashboardPut --
+ *
+ *    Write 'len' characters into the frame, in one color.
+ */
+
+static fastcall void
+StatsDashboardPut(uint16 *cell, const char *str, uint32 len, uint8 attr)
+{
+   while (len--) {
+      *(cell++) = (uint8)*(str++) | (attr << 8);
+   }
+}
+
+
+/*
+ * StatsDashboardFormat --
+ *
+ *    Console_Format() into a caller-provided buffer, returning the
+ *    length. The result is not NUL-terminated.
+ */
+
+static uint32
+StatsDashboardFormat(char *buf, uint32 size, const char *fmt, ...)
+{
+   return Console_FormatToBuffer(buf, size, &fmt);
+}
+
+
+/*
+ * StatsDashboardDrawStat --
+ *
+ *    Draw one stat into a cell: its name on the left and its value
+ *    right-justified. Histograms show their sample count and mean.
+ */
+
+static fastcall void
+StatsDashboardDrawStat(uint16 *cell, const Stat *stat)
+{
+   char value[DASHBOARD_CELL_WIDTH - 2];
+   uint32 count = stat->value;
+   uint32 nameLen = 0;
+   uint32 valueLen;
+
+   if (stat->type != STAT_TYPE_HISTOGRAM) {
+      valueLen = StatsDashboardFormat(value, sizeof value, "%u", count);
+   } else if (count) {
+      valueLen = StatsDashboardFormat(value, sizeof value, "%u avg %u",
+                                      count, (uint32)(stat->sum / count));
+   } else {
+      valueLen = StatsDashboardFormat(value, sizeof value, "-");
+   }
+
+   while (stat->name[nameLen] && nameLen < DASHBOARD_CELL_WIDTH - valueLen - 2) {
+      nameLen++;
+   }
+
+   StatsDashboardPut(cell + 1, stat->name, nameLen, DASHBOARD_NAME_ATTR);
+   StatsDashboardPut(cell + DASHBOARD_CELL_WIDTH - 1 - valueLen,
+                     value, valueLen, DASHBOARD_VALUE_ATTR);
+}
+
+
+/*
+ * StatsDashboard_Refresh --
+ *
+ *    Redraw the dashboard, if it's shown. Stats fill the left column
+ *    and then the right; any that don't fit are left off-screen, but
+ *    still appear in dumps.
+ */
+
+fastcall void
+StatsDashboard_Refresh(void)
+{
+   uint16 *frame = gStatsDashboard.frame;
+   const Stat *stat;
+   char title[VGA_TEXT_WIDTH];
+   uint32 titleLen;
+   int i;
+
+   if (!gStatsDashboard.shown) {
+      return;
+   }
+
+   titleLen = StatsDashboardFormat(title, sizeof title, " Metalkit stats: %d",
+                                   _stats_end - _stats_start);
+   memset16(frame, ' ' | (DASHBOARD_TITLE_ATTR << 8), VGA_TEXT_WIDTH);
+   StatsDashboardPut(frame, title, titleLen, DASHBOARD_TITLE_ATTR);
+
+   memset16(frame + VGA_TEXT_WIDTH, ' ' | (DASHBOARD_NAME_ATTR << 8),
+            VGA_TEXT_WIDTH * DASHBOARD_ROWS);
+
+   for (stat = _stats_start, i = 0;
+        stat < _stats_end && i < DASHBOARD_COLUMNS * DASHBOARD_ROWS;
+        stat++, i++) {
+      StatsDashboardDrawStat(frame + (1 + i % DASHBOARD_ROWS) * VGA_TEXT_WIDTH +
+                             (i / DASHBOARD_ROWS) * DASHBOARD_CELL_WIDTH, stat);
+   }
+
+   memcpy32(ConsoleVGA_GetOverlay(), frame, sizeof gStatsDashboard.frame / sizeof(uint32));
+}
+
+
+/*
+ * StatsDashboard_Show --
+ *
+ *    Show or hide the dashboard. It's drawn before it's shown, so it
+ *    never appears stale.
+ */
+
+fastcall void
+StatsDashboard_Show(Bool show)
+{
+   gStatsDashboard.shown = show;
+
+   if (show) {
+      StatsDashboard_Refresh();
+   }
+   ConsoleVGA_ShowOverlay(show);
+}
+
+
+/*
+ * StatsDashboardKeyHandler --
+ *
+ *    Keyboard IRQ handler, chained in front of the application's.
+ *    Our hotkeys are consumed; everything else is passed on.
+ *
+ *    The dump runs right here in the IRQ handler, so 'dumpConsole'
+ *    should be one the application doesn't otherwise write to,
+ *    such as a serial port used only for dumps.
+ */
+
+static fastcall void
+StatsDashboardKeyHandler(KeyEvent *event)
+{
+   if (event->key && event->key == gStatsDashboard.toggleKey) {
+      if (event->pressed) {
+         StatsDashboard_Show(!gStatsDashboard.shown);
+      }
+      return;
+   }
+
+   if (event->key && event->key == gStatsDashboard.dumpKey &&
+       gStatsDashboard.dumpConsole) {
+      if (event->pressed) {
+         Stats_Dump(gStatsDashboard.dumpConsole);
+      }
+      return;
+   }
+
+   if (gStatsDashboard.nextHandler) {
+      gStatsDashboard.nextHandler(event);
+   }
+}
+
+
+/*
+ * StatsDashboard_Init --
+ *
+ *    Hook the dashboard's hotkeys into the keyboard driver. Call this
+ *    after Keyboard_Init() and after the application has set its own
+ *    keyboard handler, if any. 'dumpKey' writes every stat to
+ *    'dumpConsole' with Stats_Dump(); pass a NULL console to disable
+ *    it.
+ */
+
+fastcall void
+StatsDashboard_Init(Keycode toggleKey, Keycode dumpKey,
+                    const ConsoleInterface *dumpConsole)
+{
+   gStatsDashboard.toggleKey = toggleKey;
+   gStatsDashboard.dumpKey = dumpKey;
+   gStatsDashboard.dumpConsole = dumpConsole;
+   gStatsDashboard.nextHandler = gKeyboard.handler;
+
+   Keyboard_SetHandler(StatsDashboardKeyHandler);
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * stats_dashboard.h - Live on-screen statistics dashboard
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __STATS_DASHBOARD_H__
+#define __STATS_DASHBOARD_H__
+
+#include "types.h"
+#include "console.h"
+#include "keyboard.h"
+
+/*
+ * The dashboard shows every stat in the image on the VGA console's
+ * overlay page. A hotkey flips between it and the console, which
+ * keeps running underneath. Call StatsDashboard_Refresh() from a
+ * timer at a few Hz to keep it live.
+ *
+ * Requires the VGA console and the keyboard driver.
+ */
+
+#define STATS_DASHBOARD_REFRESH_HZ  4    // Suggested refresh rate
+
+fastcall void StatsDashboard_Init(Keycode toggleKey, Keycode dumpKey,
+                                  const ConsoleInterface *dumpConsole);
+fastcall void StatsDashboard_Show(Bool show);
+fastcall void StatsDashboard_Refresh(void);
+
+#endif /* __STATS_DASHBOARD_H__ */
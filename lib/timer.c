@@ -32,6 +32,19 @@
 
 #include "timer.h"
 #include "io.h"
+#include "intr.h"
+
+static fastcall uint64 TimerReadPIT2(void);
+
+ClockSource gClockSourcePIT = {
+   .name = "PIT",
+   .read = TimerReadPIT2,
+};
+
+static struct {
+   uint64 ticks;
+   uint16 last;
+} gPITClock;
 
 /*
  * Timer_InitPIT --
@@ -47,3 +60,105 @@ Timer_InitPIT(uint16 divisor)
    IO_Out8(0x40, divisor & 0xFF);
    IO_Out8(0x40, divisor >> 8);
 }
+
+
+/*
+ * Timer_BeginPIT2 --
+ *
+ *    Start a one-shot countdown of 'count' PIT ticks on channel 2,
+ *    with the speaker disconnected. Poll Timer_PIT2Done() to find
+ *    out when it expires. No interrupts are involved, so this can
+ *    be used with interrupts disabled.
+ */
+
+fastcall void
+Timer_BeginPIT2(uint16 count)
+{
+   uint8 portB = IO_In8(PIT_PORTB);
+
+   /* Gate off while we reprogram, and keep the speaker quiet. */
+   portB &= ~(PIT_PORTB_GATE2 | PIT_PORTB_SPEAKER);
+   IO_Out8(PIT_PORTB, portB);
+
+   /* Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count) */
+   IO_Out8(0x43, 0xB0);
+   IO_Out8(0x42, count & 0xFF);
+   IO_Out8(0x42, count >> 8);
+
+   /* Raising the gate starts the count. */
+   IO_Out8(PIT_PORTB, portB | PIT_PORTB_GATE2);
+}
+
+
+/*
+ * TimerLatchPIT2 --
+ *
+ *    Latch and read the current value of PIT channel 2's counter.
+ */
+
+static fastcall uint16
+TimerLatchPIT2(void)
+{
+   uint8 low, high;
+
+   IO_Out8(0x43, 0x80);
+   low = IO_In8(0x42);
+   high = IO_In8(0x42);
+
+   return low | (high << 8);
+}
+
+
+/*
+ * TimerReadPIT2 --
+ *
+ *    ClockSource read function for the PIT. The hardware counter is
+ *    only 16 bits wide and counts down, so we extend it in software.
+ *    This means the clock must be read at least once per wrap
+ *    (every 55ms) to stay accurate.
+ */
+
+static fastcall uint64
+TimerReadPIT2(void)
+{
+   Bool iFlag = Intr_Save();
+   uint16 now;
+   uint64 ticks;
+
+   Intr_Disable();
+   now = TimerLatchPIT2();
+   gPITClock.ticks += (uint16)(gPITClock.last - now);
+   gPITClock.last = now;
+   ticks = gPITClock.ticks;
+   Intr_Restore(iFlag);
+
+   return ticks;
+}
+
+
+/*
+ * Timer_InitPITClockSource --
+ *
+ *    Set up PIT channel 2 as a free-running counter, and make
+ *    gClockSourcePIT usable. This takes over channel 2, so do any
+ *    calibration with Timer_BeginPIT2() (including Clock_Init) first.
+ *
+ *    This is the slowest ClockSource to read, since every read is
+ *    three port I/O operations.
+ */
+
+fastcall void
+Timer_InitPITClockSource(void)
+{
+   uint8 portB = IO_In8(PIT_PORTB) & ~PIT_PORTB_SPEAKER;
+
+   /* Channel 2, lobyte/hibyte, mode 2 (rate generator), period 65536 */
+   IO_Out8(0x43, 0xB4);
+   IO_Out8(0x42, 0);
+   IO_Out8(0x42, 0);
+   IO_Out8(PIT_PORTB, portB | PIT_PORTB_GATE2);
+
+   gPITClock.ticks = 0;
+   gPITClock.last = TimerLatchPIT2();
+   ClockSource_SetFrequency(&gClockSourcePIT, PIT_HZ);
+}
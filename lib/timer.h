@@ -34,10 +34,37 @@
 #define __TIMER_H__
 
 #include "types.h"
+#include "io.h"
+#include "clock.h"
 
 #define PIT_HZ   1193182
 #define PIT_IRQ  0
 
+/*
+ * Port 0x61 (the "system control port B") gates PIT channel 2
+ * and lets us read back its output. Channel 2 isn't connected to
+ * any IRQ, so it's useful for calibrating other timers.
+ */
+#define PIT_PORTB              0x61
+#define PIT_PORTB_GATE2        (1 << 0)
+#define PIT_PORTB_SPEAKER      (1 << 1)
+#define PIT_PORTB_OUT2         (1 << 5)
+
 fastcall void Timer_InitPIT(uint16 divisor);
+fastcall void Timer_BeginPIT2(uint16 count);
+fastcall void Timer_InitPITClockSource(void);
+
+extern ClockSource gClockSourcePIT;
+
+
+/*
+ * Timer_PIT2Done --
+ *
+ *    Returns TRUE once the one-shot countdown started by
+ *    Timer_BeginPIT2() has expired. A macro, so that IO_ACCOUNTING
+ *    credits the read to the caller.
+ */
+
+#define Timer_PIT2Done()  ((IO_In8(PIT_PORTB) & PIT_PORTB_OUT2) != 0)
 
 #endif /* __TIMER_H__ */
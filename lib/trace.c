@@ -0,0 +1,122 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * trace.c - Compact binary event tracing
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "types.h"
+#include "trace.h"
+#include "intr.h"
+#include "clock.h"
+#include "debugport.h"
+
+TraceBuffer gTrace[TRACE_MAX_CPUS];
+
+
+/*
+ * TraceDumpUInt32 --
+ * TraceDumpString --
+ *
+ *    Little-endian integers and NUL-terminated strings.
+ */
+
+static fastcall void
+TraceDumpUInt32(uint32 value)
+{
+   DebugPort_Write(&value, sizeof value);
+}
+
+static fastcall void
+TraceDumpString(const char *str)
+{
+   const char *end = str;
+   while (*end) {
+      end++;
+   }
+   DebugPort_Write(str, end - str + 1);
+}
+
+
+/*
+ * Trace_Dump --
+ *
+ *    Write the event table and every CPU's ring to the debug port,
+ *    in a binary format that lib/trace2json.py understands. In QEMU,
+ *    capture it with "-debugcon file:trace.bin".
+ *
+ *    Format, all integers little-endian:
+ *
+ *       char     magic[8]         TRACE_DUMP_MAGIC
+ *       uint64   tscHz
+ *       uint32   numEvents
+ *       uint32   numCPUs
+ *       numEvents times:
+ *          uint32   phase
+ *          char     name[]        NUL-terminated
+ *          char     argNames[]    NUL-terminated, possibly empty
+ *       numCPUs times:
+ *          uint32       numRecords
+ *          TraceRecord  records[numRecords]   oldest first
+ *
+ *    Interrupts are off while we dump, so the rings hold still.
+ */
+
+fastcall void
+Trace_Dump(void)
+{
+   const TraceEvent *event;
+   Bool iFlag = Intr_Save();
+   int cpu;
+
+   Intr_Disable();
+
+   DebugPort_Write(TRACE_DUMP_MAGIC, 8);
+   DebugPort_Write(&gClock.tscHz, sizeof gClock.tscHz);
+   TraceDumpUInt32(_trace_events_end - _trace_events_start);
+   TraceDumpUInt32(TRACE_MAX_CPUS);
+
+   for (event = _trace_events_start; event < _trace_events_end; event++) {
+      TraceDumpUInt32(event->phase);
+      TraceDumpString(event->name);
+      TraceDumpString(event->argNames ? event->argNames : "");
+   }
+
+   for (cpu = 0; cpu < TRACE_MAX_CPUS; cpu++) {
+      TraceBuffer *buffer = &gTrace[cpu];
+      uint32 count = MIN(buffer->head, TRACE_RING_ENTRIES);
+      uint32 first = (buffer->head - count) & (TRACE_RING_ENTRIES - 1);
+      uint32 tailCount = MIN(count, TRACE_RING_ENTRIES - first);
+
+      TraceDumpUInt32(count);
+      DebugPort_Write(&buffer->records[first], tailCount * sizeof(TraceRecord));
+      DebugPort_Write(&buffer->records[0], (count - tailCount) * sizeof(TraceRecord));
+   }
+
+   Intr_Restore(iFlag);
+}
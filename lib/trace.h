@@ -0,0 +1,145 @@
+/* -*- Mode: C; c-basic-offset: 3 -*-
+ *
+ * trace.h - Compact binary event tracing
+ *
+ * This file is part of Metalkit, a simple collection of modules for
+ * writing software that runs on the bare metal. Get the latest code
+ * at http://svn.navi.cx/misc/trunk/metalkit/
+ *
+ * Copyright (c) 2008-2009 Micah Dowty
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "types.h"
+
+/*
+ * Tracepoints record an event into a per-CPU ring in a handful of
+ * instructions: a timestamp, the event's ID, and up to three 32-bit
+ * arguments. There's no formatting at all. Trace_Dump() writes the
+ * rings to the debug port, and lib/trace2json.py turns that into
+ * Chrome trace JSON, for viewing in chrome://tracing or Perfetto.
+ *
+ * Tracing is a compile-time option. Build with "make TRACE=1" to
+ * define TRACE and link this module; otherwise every tracepoint
+ * compiles to nothing.
+ *
+ * Each tracepoint's TraceEvent descriptor is placed in its own
+ * linker section, so event IDs are assigned at link time and the
+ * whole table can be dumped alongside the records.
+ */
+
+#define TRACE_MAX_CPUS       1      // Until we can start other CPUs
+#define TRACE_RING_ENTRIES   4096   // Per CPU, must be a power of two
+
+#define TRACE_PHASE_BEGIN    'B'
+#define TRACE_PHASE_END      'E'
+#define TRACE_PHASE_INSTANT  'i'
+
+#define TRACE_DUMP_MAGIC     "MKTRACE1"
+
+typedef struct {
+   const char *name;
+   const char *argNames;      // Comma-separated, for the decoder
+   uint32 phase;
+} ALIGNED(16) TraceEvent;
+
+typedef struct {
+   uint64 tsc;
+   uint16 cpu;
+   uint16 id;                 // Index into the TraceEvent table
+   uint32 args[3];
+} TraceRecord;
+
+typedef struct {
+   volatile uint32 head;      // Total number of records ever written
+   TraceRecord records[TRACE_RING_ENTRIES];
+} TraceBuffer;
+
+#ifdef TRACE
+
+#include "cpu.h"
+
+extern TraceBuffer gTrace[TRACE_MAX_CPUS];
+extern const TraceEvent _trace_events_start[];
+extern const TraceEvent _trace_events_end[];
+
+fastcall void Trace_Dump(void);
+
+
+/*
+ * Trace_Record --
+ *
+ *    Append a record to this CPU's ring, overwriting the oldest
+ *    record when it's full. The slot is claimed with a single xadd,
+ *    which an interrupt can't split, so tracepoints in IRQ handlers
+ *    never collide with the code they interrupted.
+ */
+
+static inline void
+Trace_Record(const TraceEvent *event, uint32 arg0, uint32 arg1, uint32 arg2)
+{
+   TraceBuffer *buffer = &gTrace[0];
+   TraceRecord *record;
+   uint32 index = 1;
+
+   asm volatile ("xaddl %0, %1" : "+r" (index), "+m" (buffer->head));
+   record = &buffer->records[index & (TRACE_RING_ENTRIES - 1)];
+
+   record->tsc = CPU_ReadTSC();
+   record->cpu = 0;
+   record->id = event - _trace_events_start;
+   record->args[0] = arg0;
+   record->args[1] = arg1;
+   record->args[2] = arg2;
+}
+
+#define TRACE_POINT(phase, name, argNames, a0, a1, a2)                  \
+   do {                                                                 \
+      static const TraceEvent _traceEvent                               \
+         __attribute__ ((section(".trace_events"), used)) =             \
+         { name, argNames, phase };                                     \
+      Trace_Record(&_traceEvent, (uint32)(a0), (uint32)(a1), (uint32)(a2)); \
+   } while (0)
+
+#else /* !TRACE */
+
+#define TRACE_POINT(phase, name, argNames, a0, a1, a2)  ((void)0)
+
+#endif /* TRACE */
+
+/*
+ * Tracepoints. 'name' and 'argNames' must be string literals. Begin
+ * and End events nest, per CPU; Instant events stand alone.
+ */
+
+#define Trace_Begin(name, argNames, a0, a1, a2) \
+   TRACE_POINT(TRACE_PHASE_BEGIN, name, argNames, a0, a1, a2)
+#define Trace_End(name, argNames, a0, a1, a2) \
+   TRACE_POINT(TRACE_PHASE_END, name, argNames, a0, a1, a2)
+#define Trace_Instant(name, argNames, a0, a1, a2) \
+   TRACE_POINT(TRACE_PHASE_INSTANT, name, argNames, a0, a1, a2)
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+#
+# Convert a Metalkit trace dump (see Trace_Dump in trace.c) into
+# Chrome trace JSON, which can be loaded in chrome://tracing or
+# https://ui.perfetto.dev.
+#
+#   python3 trace2json.py < trace.bin > trace.json
+#
+# Each CPU becomes one thread of a single process. Timestamps are
+# converted from TSC cycles to microseconds, relative to the oldest
+# record in the dump.
+#
+
+import json
+import struct
+import sys
+
+MAGIC = b"MKTRACE1"
+RECORD = struct.Struct("<QHH3I")
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.offset = 0
+
+    def unpack(self, fmt):
+        values = struct.unpack_from(fmt, self.data, self.offset)
+        self.offset += struct.calcsize(fmt)
+        return values
+
+    def string(self):
+        end = self.data.index(b"\0", self.offset)
+        s = self.data[self.offset:end].decode("ascii", "replace")
+        self.offset = end + 1
+        return s
+
+
+def decode(data):
+    start = data.find(MAGIC)
+    if start < 0:
+        raise ValueError("no trace dump found")
+
+    r = Reader(data)
+    r.offset = start + len(MAGIC)
+
+    tscHz, numEvents, numCPUs = r.unpack("<QII")
+    events = []
+    for _ in range(numEvents):
+        phase, = r.unpack("<I")
+        name = r.string()
+        argNames = [a for a in r.string().split(",") if a]
+        events.append((chr(phase), name, argNames))
+
+    records = []
+    for _ in range(numCPUs):
+        count, = r.unpack("<I")
+        for _ in range(count):
+            records.append(RECORD.unpack_from(data, r.offset))
+            r.offset += RECORD.size
+
+    return tscHz, events, records
+
+
+def convert(tscHz, events, records):
+    if not tscHz:
+        tscHz = 1000000   # Uncalibrated; treat cycles as microseconds
+    base = min((rec[0] for rec in records), default=0)
+    out = []
+
+    for tsc, cpu, eventId, a0, a1, a2 in sorted(records):
+        phase, name, argNames = events[eventId]
+        event = {
+            "name": name,
+            "ph": phase,
+            "ts": (tsc - base) * 1e6 / tscHz,
+            "pid": 0,
+            "tid": cpu,
+            "args": dict(zip(argNames, (a0, a1, a2))),
+        }
+        if phase == "i":
+            event["s"] = "t"
+        out.append(event)
+
+    for cpu in sorted(set(rec[1] for rec in records)):
+        out.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": cpu,
+                    "args": {"name": "CPU %d" % cpu}})
+
+    return {"traceEvents": out, "displayTimeUnit": "ns"}
+
+
+def main():
+    tscHz, events, records = decode(sys.stdin.buffer.read())
+    json.dump(convert(tscHz, events, records), sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
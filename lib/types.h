@@ -108,5 +108,20 @@ memset32(void *dest, uint32 value, uint32 size)
 #define Atomic_Or(mem, reg) \
    asm volatile ("lock orl %1, %0" :"+m" (mem) :"r" (reg))
 
+#define Atomic_Add(mem, reg) \
+   asm volatile ("lock addl %1, %0" :"+m" (mem) :"r" (reg))
+
+/*
+ * If *mem equals oldVal, replace it with newVal. Returns the value
+ * that was in memory; the exchange happened if it equals oldVal.
+ */
+static inline uint32
+Atomic_CompareExchange(volatile uint32 *mem, uint32 oldVal, uint32 newVal)
+{
+   asm volatile ("lock cmpxchgl %2, %1"
+                 : "+a" (oldVal), "+m" (*mem) : "r" (newVal) : "memory");
+   return oldVal;
+}
+
 #endif /* __TYPES_H__ */
 
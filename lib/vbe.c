@@ -32,15 +32,93 @@
 
 #include "vbe.h"
 #include "console.h"
+#include "stats.h"
 
 VBEState gVBE;
 
+static fastcall uint32 VBEPixelFormat(VBEModeInfo *info);
+
+/*
+ * VBEInitProtectedMode --
+ *
+ *    Look for the protected-mode interface (function 0Ah). It returns
+ *    a table in the video BIOS: the offsets of the entry points for
+ *    functions 05h, 07h and 09h, then the offset of a list of I/O
+ *    ports followed by a list of memory regions the code touches.
+ *
+ *    We call the code in place, with flat segments. That's fine for
+ *    ports, but code that needs a memory region expects a selector
+ *    for it in ES, which we don't have. In that case we leave the
+ *    interface disabled, as Linux does.
+ */
+
+static fastcall void
+VBEInitProtectedMode(void)
+{
+   VBEProtectedMode *pm = &gVBE.pm;
+   Regs reg = {};
+   uint8 *table;
+   uint16 *offsets;
+
+   memset(pm, 0, sizeof *pm);
+
+   reg.ax = 0x4f0a;
+   reg.bx = 0x0000;
+   BIOS_Call(0x10, &reg);
+   if (reg.ax != 0x004F) {
+      return;
+   }
+
+   table = PTR_NEAR_TO_32(reg.es, reg.di);
+   offsets = (uint16*) table;
+
+   if (offsets[3]) {
+      uint16 *list = (uint16*) (table + offsets[3]);
+
+      while (*list != 0xFFFF) {
+         list++;
+      }
+      if (list[1] != 0xFFFF) {
+         return;
+      }
+   }
+
+   pm->setWindow = table + offsets[0];
+   pm->setDisplayStart = table + offsets[1];
+   pm->setPalette = table + offsets[2];
+   pm->enabled = TRUE;
+}
+
+
+/*
+ * VBECallProtectedMode --
+ *
+ *    Call one of the protected-mode entry points. They take the same
+ *    registers as the real-mode function, except that pointers are
+ *    flat.
+ */
+
+static inline void
+VBECallProtectedMode(void *entry, uint32 eax, uint32 ebx, uint32 ecx,
+                     uint32 edx, uint32 edi)
+{
+   asm volatile ("call *%%esi"
+                 : "+a" (eax), "+b" (ebx), "+c" (ecx), "+d" (edx),
+                   "+D" (edi), "+S" (entry)
+                 :: "memory", "cc");
+}
+
+
 /*
  * VBE_Init --
  *
  *    Probe for VBE support, and retrieve information
  *    about the video adapter and its supported modes.
  *
+ *    The information we need about every mode is fetched now, into
+ *    gVBE.modes, so that looking for a mode costs no BIOS calls.
+ *    Later calls return immediately.
+ *
  *    On success, returns TRUE and initializes gVBE.
  *    Returns FALSE if VBE is unsupported.
  */
@@ -51,7 +129,13 @@ VBE_Init()
    VBEState *self = &gVBE;
    Regs reg = {};
    VBEControllerInfo *cInfo = (void*) BIOS_SHARED->userdata;
+   VBEModeInfo *info = (void*) BIOS_SHARED->userdata;
    uint16 *modes;
+   uint32 i;
+
+   if (self->initialized) {
+      return TRUE;
+   }
 
    /* Let the BIOS know we support VBE2 */
    cInfo->signature = SIGNATURE_VBE2;
@@ -74,12 +158,40 @@ VBE_Init()
    memcpy(&self->cInfo, cInfo, sizeof *cInfo);
    modes = PTR_FAR_TO_32(self->cInfo.videoModes);
    self->numModes = 0;
-   while (*modes != 0xFFFF) {
-      self->modes[self->numModes] = *modes;
+   while (*modes != 0xFFFF && self->numModes < MAX_SUPPORTED_MODES) {
+      self->modes[self->numModes].mode = *modes;
       modes++;
       self->numModes++;
    }
 
+   /*
+    * One "Get SuperVGA Mode Information" call per mode, read in
+    * place. A mode the BIOS won't describe is left unsupported.
+    */
+
+   for (i = 0; i < self->numModes; i++) {
+      VBEModeSummary *summary = &self->modes[i];
+
+      memset(info, 0, sizeof *info);
+      memset(&reg, 0, sizeof reg);
+      reg.ax = 0x4f01;
+      reg.cx = summary->mode;
+      reg.di = PTR_32_TO_NEAR(info, 0);
+      BIOS_Call(0x10, &reg);
+
+      summary->attributes = reg.ax == 0x004F ? info->attributes : 0;
+      summary->width = info->width;
+      summary->height = info->height;
+      summary->bytesPerLine = info->bytesPerLine;
+      summary->bitsPerPixel = info->bitsPerPixel;
+      summary->format = VBEPixelFormat(info);
+   }
+
+   if (self->cInfo.verMajor >= 2) {
+      VBEInitProtectedMode();
+   }
+
+   self->initialized = TRUE;
    return TRUE;
 }
 
@@ -108,6 +220,78 @@ VBE_GetModeInfo(uint16 mode, VBEModeInfo *info)
 }
 
 
+/*
+ * VBEPixelFormat --
+ *
+ *    Classify a mode's pixel layout. VBE 1.2 added the color masks;
+ *    older BIOSes leave them zero, and we assume the usual layout
+ *    for the depth. As a side effect, missing masks are filled in so
+ *    that VBE_MapRGB() works.
+ */
+
+static fastcall uint32
+VBEPixelFormat(VBEModeInfo *info)
+{
+   uint32 rgb;
+
+   if (info->memType == VBE_MEMTYPE_PACKED && info->bitsPerPixel == 8) {
+      return VBE_PIXFMT_INDEXED8;
+   }
+   if (info->memType != VBE_MEMTYPE_DIRECT && info->memType != VBE_MEMTYPE_PACKED) {
+      return VBE_PIXFMT_UNKNOWN;
+   }
+
+   if (info->red.maskSize == 0) {
+      const uint8 green = info->bitsPerPixel == 16 ? 6 : info->bitsPerPixel == 15 ? 5 : 8;
+      const uint8 blue = green == 6 ? 5 : green;
+
+      info->blue.maskSize = blue;
+      info->blue.fieldPos = 0;
+      info->green.maskSize = green;
+      info->green.fieldPos = blue;
+      info->red.maskSize = blue;
+      info->red.fieldPos = blue + green;
+   }
+
+   /*
+    * Pack the size and position of each channel into 5 bits apiece,
+    * so each layout is a single constant.
+    */
+
+#define VBE_CHANNELS(rs, rp, gs, gp, bs, bp) \
+   (((rs) << 25) | ((rp) << 20) | ((gs) << 15) | ((gp) << 10) | ((bs) << 5) | (bp))
+
+   rgb = VBE_CHANNELS(info->red.maskSize, info->red.fieldPos,
+                      info->green.maskSize, info->green.fieldPos,
+                      info->blue.maskSize, info->blue.fieldPos);
+
+   switch (info->bitsPerPixel) {
+   case 15:
+   case 16:
+      if (rgb == VBE_CHANNELS(5, 10, 5, 5, 5, 0)) {
+         return VBE_PIXFMT_RGB555;
+      }
+      if (rgb == VBE_CHANNELS(5, 11, 6, 5, 5, 0)) {
+         return VBE_PIXFMT_RGB565;
+      }
+      break;
+   case 24:
+   case 32:
+      if (rgb == VBE_CHANNELS(8, 16, 8, 8, 8, 0)) {
+         return info->bitsPerPixel == 24 ? VBE_PIXFMT_RGB888 : VBE_PIXFMT_XRGB8888;
+      }
+      if (rgb == VBE_CHANNELS(8, 0, 8, 8, 8, 16)) {
+         return info->bitsPerPixel == 24 ? VBE_PIXFMT_BGR888 : VBE_PIXFMT_XBGR8888;
+      }
+      break;
+   }
+
+#undef VBE_CHANNELS
+
+   return VBE_PIXFMT_UNKNOWN;
+}
+
+
 /*
  * VBE_SetMode --
  *
@@ -124,6 +308,10 @@ VBE_SetMode(uint16 mode, uint16 modeFlags)
    self->current.mode = mode;
    self->current.flags = modeFlags;
    VBE_GetModeInfo(mode, &self->current.info);
+   self->current.format = VBEPixelFormat(&self->current.info);
+   self->current.startX = 0;
+   self->current.startY = 0;
+   self->current.setDisplayStart = NULL;
 
    Regs reg = {};
    reg.ax = 0x4f02;
@@ -132,6 +320,91 @@ VBE_SetMode(uint16 mode, uint16 modeFlags)
 }
 
 
+STAT_COUNTER(gVBEFlipStat, "vbe.flips");
+
+
+/*
+ * Subfunctions of VBE function 07h, "Set/Get Display Start".
+ */
+
+#define VBE_DISPLAY_START_NOW         0x00
+#define VBE_DISPLAY_START_SCHEDULE    0x02   // VBE 3.0, ECX is a byte offset
+#define VBE_DISPLAY_START_STATUS      0x04   // VBE 3.0
+#define VBE_DISPLAY_START_VBLANK      0x80
+
+
+/*
+ * VBESetDisplayStart --
+ *
+ *    Call VBE function 07h with the given subfunction, through the
+ *    protected-mode interface when we can. Every change to the
+ *    display start address counts as a flip.
+ *
+ *    A schedule only takes effect later, but since nothing else can
+ *    be scheduled until it does, we consider it current right away.
+ *
+ *    Modes set by a native driver go through its own hook instead,
+ *    which never schedules.
+ */
+
+static fastcall void
+VBESetDisplayStart(uint8 subfunction, int x, int y)
+{
+   const VBEModeInfo *info = &gVBE.current.info;
+   uint32 offset = y * info->bytesPerLine + x * ((info->bitsPerPixel + 7) / 8);
+
+   if (gVBE.current.setDisplayStart) {
+      gVBE.current.setDisplayStart(x, y, subfunction != VBE_DISPLAY_START_NOW);
+   } else if (gVBE.pm.enabled && subfunction != VBE_DISPLAY_START_SCHEDULE) {
+      /*
+       * The protected-mode entry point takes a start address, in
+       * units of 4 bytes, split across CX and DX.
+       */
+      VBECallProtectedMode(gVBE.pm.setDisplayStart, 0x4f07, subfunction,
+                           (offset >> 2) & 0xFFFF, offset >> 18, 0);
+   } else {
+      Regs reg = {};
+      reg.ax = 0x4f07;
+      reg.bx = subfunction;
+      if (subfunction == VBE_DISPLAY_START_SCHEDULE) {
+         reg.ecx = offset;
+      } else {
+         reg.cx = x;
+         reg.dx = y;
+      }
+      BIOS_Call(0x10, &reg);
+   }
+
+   if (x != gVBE.current.startX || y != gVBE.current.startY) {
+      gVBE.current.startX = x;
+      gVBE.current.startY = y;
+      Stat_Inc(&gVBEFlipStat);
+   }
+}
+
+
+/*
+ * VBE_SetWindow --
+ *
+ *    Move a bank-switching window (0 for A, 1 for B) to 'position',
+ *    in units of the mode's window granularity.
+ */
+
+fastcall void
+VBE_SetWindow(int window, int position)
+{
+   if (gVBE.pm.enabled) {
+      VBECallProtectedMode(gVBE.pm.setWindow, 0x4f05, window, 0, position, 0);
+   } else {
+      Regs reg = {};
+      reg.ax = 0x4f05;
+      reg.bx = window;
+      reg.dx = position;
+      BIOS_Call(0x10, &reg);
+   }
+}
+
+
 /*
  * VBE_SetStartAddress --
  *
@@ -142,12 +415,24 @@ VBE_SetMode(uint16 mode, uint16 modeFlags)
 fastcall void
 VBE_SetStartAddress(int x, int y)
 {
-   Regs reg = {};
-   reg.ax = 0x4f07;
-   reg.bx = 0x0000;
-   reg.cx = x;
-   reg.dx = y;
-   BIOS_Call(0x10, &reg);
+   VBESetDisplayStart(VBE_DISPLAY_START_NOW, x, y);
+}
+
+
+/*
+ * VBE_WaitVBlank --
+ *
+ *    Wait for vertical retrace, by setting the display start address
+ *    to what it already is with the "during vertical retrace" flag.
+ *    This is the only way to find retrace in modes that aren't VGA
+ *    compatible, where the VGA status register stops working. The
+ *    BIOS busy-waits.
+ */
+
+fastcall void
+VBE_WaitVBlank(void)
+{
+   VBESetDisplayStart(VBE_DISPLAY_START_VBLANK, gVBE.current.startX, gVBE.current.startY);
 }
 
 
@@ -157,12 +442,15 @@ VBE_SetStartAddress(int x, int y)
  *    Use the VESA BIOS (not the VGA registers) to update any number
  *    of palette entries.
  *
- *    Note that the entire block of palette entries must fit in the
- *    BIOS_SHARED scratch area. Currently this is 1 kilobyte, which
- *    is exactly the size of a full VBE palette.
+ *    Without the protected-mode interface, the entire block of
+ *    palette entries must fit in the BIOS_SHARED scratch area.
+ *    Currently this is 1 kilobyte, which is exactly the size of a
+ *    full VBE palette.
  *
  *    Each palette entry is a 32-bit BGRX-format color. By default,
  *    each color component is 6 bits wide.
+ *
+ *    In VGA-compatible modes, Palette_Set() is much cheaper.
  */
 
 fastcall void
@@ -171,6 +459,12 @@ VBE_SetPalette(int firstColor, int numColors, uint32 *colors)
    Regs reg = {};
    uint32 *tempColors = (void*) BIOS_SHARED->userdata;
 
+   if (gVBE.pm.enabled) {
+      VBECallProtectedMode(gVBE.pm.setPalette, 0x4f09, 0x0000, numColors,
+                           firstColor, (uint32) colors);
+      return;
+   }
+
    memcpy32(tempColors, colors, numColors);
 
    reg.ax = 0x4f09;
@@ -183,6 +477,98 @@ VBE_SetPalette(int firstColor, int numColors, uint32 *colors)
 }
 
 
+/*
+ * VBE_FindMode --
+ *
+ *    Pick the available graphics mode that best fits a requested
+ *    size and depth, from the table cached by VBE_Init(). Returns
+ *    VBE_NO_MODE if nothing qualifies.
+ *
+ *    Modes that don't fit in video memory never qualify, nor do
+ *    planar and other layouts we can't draw to (VBE_PIXFMT_UNKNOWN).
+ *    The rest are ranked by, in order of importance:
+ *
+ *      1. Resolution: an exact match, then the smallest mode that
+ *         contains the requested size, then whichever smaller mode
+ *         covers the most of it.
+ *      2. Depth: an exact match, then the nearest deeper mode, then
+ *         the nearest shallower one.
+ *      3. Having a linear framebuffer.
+ *      4. Having room for VBE_FIND_PAGES(n) full-screen pages.
+ */
+
+fastcall uint16
+VBE_FindMode(int width, int height, int bpp, uint32 flags)
+{
+   const uint32 required = VBE_MODEATTR_SUPPORTED | VBE_MODEATTR_GRAPHICS;
+   const uint64 memBytes = gVBE.cInfo.totalMemory * 0x10000ULL;
+   const uint32 pages = MAX(VBE_FIND_PAGES(flags), 1);
+   uint64 bestScore = ~0ULL;
+   uint16 best = VBE_NO_MODE;
+   uint32 i;
+
+   for (i = 0; i < gVBE.numModes; i++) {
+      const VBEModeSummary *m = &gVBE.modes[i];
+      const uint64 pageBytes = m->bytesPerLine * m->height;
+      const Bool linear = (m->attributes & VBE_MODEATTR_LINEAR) != 0;
+      const Bool exactSize = m->width == width && m->height == height;
+      uint32 resClass, areaDiff, depthClass, depthDiff;
+      uint64 score;
+
+      if ((m->attributes & required) != required || pageBytes > memBytes ||
+          m->format == VBE_PIXFMT_UNKNOWN) {
+         continue;
+      }
+      if ((flags & VBE_FIND_LINEAR) && !linear) {
+         continue;
+      }
+      if ((flags & VBE_FIND_EXACT) && !(exactSize && m->bitsPerPixel == bpp)) {
+         continue;
+      }
+
+      if (exactSize) {
+         resClass = 0;
+         areaDiff = 0;
+      } else if (m->width >= width && m->height >= height) {
+         resClass = 1;
+         areaDiff = m->width * m->height - width * height;
+      } else {
+         resClass = 2;
+         areaDiff = width * height - MIN(m->width, width) * MIN(m->height, height);
+      }
+
+      if (m->bitsPerPixel == bpp) {
+         depthClass = 0;
+         depthDiff = 0;
+      } else if (m->bitsPerPixel > bpp) {
+         depthClass = 1;
+         depthDiff = m->bitsPerPixel - bpp;
+      } else {
+         depthClass = 2;
+         depthDiff = bpp - m->bitsPerPixel;
+      }
+
+      /*
+       * Pack the criteria into one number, most important in the
+       * high bits, so the best mode has the lowest score.
+       */
+      score = ((uint64) resClass << 62) |
+              ((uint64) MIN(areaDiff, 0xFFFFFF) << 38) |
+              ((uint64) depthClass << 36) |
+              ((uint64) MIN(depthDiff, 0xFF) << 28) |
+              ((uint64) !linear << 27) |
+              ((uint64) (pageBytes * pages > memBytes) << 26);
+
+      if (score < bestScore) {
+         bestScore = score;
+         best = m->mode;
+      }
+   }
+
+   return best;
+}
+
+
 /*
  * VBE_InitSimple --
  *
@@ -200,31 +586,111 @@ VBE_SetPalette(int firstColor, int numColors, uint32 *colors)
 fastcall void
 VBE_InitSimple(int width, int height, int bpp)
 {
-   VBEState *self = &gVBE;
-   int i;
+   uint16 mode;
 
    if (!VBE_Init()) {
       Console_Panic("VESA BIOS Extensions not available.");
    }
 
-   for (i = 0; i < self->numModes; i++) {
-      uint16 mode = self->modes[i];
-      VBEModeInfo info;
-      const uint32 requiredAttrs = VBE_MODEATTR_SUPPORTED |
-                                   VBE_MODEATTR_GRAPHICS |
-                                   VBE_MODEATTR_LINEAR;
+   mode = VBE_FindMode(width, height, bpp, VBE_FIND_EXACT | VBE_FIND_LINEAR);
+   if (mode == VBE_NO_MODE) {
+      Console_Panic("Can't find the requested video mode.");
+   }
+
+   VBE_SetMode(mode, VBE_MODEFLAG_LINEAR);
+}
 
-      VBE_GetModeInfo(mode, &info);
 
-      if ((info.attributes & requiredAttrs) == requiredAttrs &&
-          info.width == width &&
-          info.height == height &&
-          info.bitsPerPixel == bpp) {
+/*
+ * VBE_InitSurface --
+ *
+ *    Divide video memory, in the current mode, into 'numPages'
+ *    full-screen pages, and show the first one. Drawing starts in
+ *    the second. Returns FALSE if there isn't enough video memory.
+ */
 
-         VBE_SetMode(mode, VBE_MODEFLAG_LINEAR);
-         return;
-      }
+fastcall Bool
+VBE_InitSurface(VBESurface *surface, int numPages)
+{
+   const VBEModeInfo *info = &gVBE.current.info;
+   uint32 memory = (uint32)gVBE.cInfo.totalMemory << 16;
+   int i;
+
+   surface->pitch = info->bytesPerLine;
+   surface->pageBytes = surface->pitch * info->height;
+
+   if (numPages < 2 || numPages > VBE_MAX_PAGES ||
+       surface->pageBytes * numPages > memory) {
+      return FALSE;
+   }
+
+   for (i = 0; i < numPages; i++) {
+      surface->pages[i] = (uint8*) info->linearAddress + i * surface->pageBytes;
+   }
+   surface->numPages = numPages;
+   surface->front = 0;
+   surface->back = 1;
+   surface->scheduled = FALSE;
+
+   VBE_SetStartAddress(0, 0);
+   return TRUE;
+}
+
+
+/*
+ * VBEWaitForScheduledFlip --
+ *
+ *    Wait until a flip scheduled with VBE_DISPLAY_START_SCHEDULE
+ *    has happened, so the page it replaced is off the screen.
+ */
+
+static fastcall void
+VBEWaitForScheduledFlip(VBESurface *surface)
+{
+   Regs reg;
+
+   while (surface->scheduled) {
+      memset(&reg, 0, sizeof reg);
+      reg.ax = 0x4f07;
+      reg.bx = VBE_DISPLAY_START_STATUS;
+      BIOS_Call(0x10, &reg);
+      surface->scheduled = reg.ax == 0x004F && reg.cx == 0;
+   }
+}
+
+
+/*
+ * VBE_Flip --
+ *
+ *    Show the back page, and move on to the next one. With
+ *    VBE_FLIP_VBLANK the switch happens during vertical blank, so
+ *    frames never tear.
+ *
+ *    With three pages and VBE 3.0, we only schedule the switch; the
+ *    new back page is neither on the screen nor waiting to be. Before
+ *    scheduling the next flip we wait for this one, since that's when
+ *    the page after it comes off the screen.
+ */
+
+fastcall void
+VBE_Flip(VBESurface *surface, uint32 flags)
+{
+   uint32 page = surface->back;
+
+   if (!(flags & VBE_FLIP_VBLANK)) {
+      VBEWaitForScheduledFlip(surface);
+      VBESetDisplayStart(VBE_DISPLAY_START_NOW, 0, page * gVBE.current.info.height);
+
+   } else if (surface->numPages >= 3 && gVBE.cInfo.verMajor >= 3 &&
+              !gVBE.current.setDisplayStart) {
+      VBEWaitForScheduledFlip(surface);
+      VBESetDisplayStart(VBE_DISPLAY_START_SCHEDULE, 0, page * gVBE.current.info.height);
+      surface->scheduled = TRUE;
+
+   } else {
+      VBESetDisplayStart(VBE_DISPLAY_START_VBLANK, 0, page * gVBE.current.info.height);
    }
 
-   Console_Panic("Can't find the requested video mode.");
+   surface->front = page;
+   surface->back = (page + 1) % surface->numPages;
 }
@@ -40,6 +40,10 @@
 #define SIGNATURE_VBE2        0x32454256
 #define MAX_SUPPORTED_MODES   128
 
+#define VBE_CAPS_DAC8                (1 << 0)   // DAC can switch to 8 bits per primary
+#define VBE_CAPS_NONVGA              (1 << 1)   // Controller isn't VGA compatible
+#define VBE_CAPS_BLANK_DAC           (1 << 2)   // Program the DAC during blanking only
+
 #define VBE_MODEATTR_SUPPORTED       (1 << 0)
 #define VBE_MODEATTR_VBE1_2          (1 << 1)
 #define VBE_MODEATTR_BIOS_SUPPORTED  (1 << 2)
@@ -59,6 +63,23 @@
 #define VBE_MEMTYPE_PACKED           0x04
 #define VBE_MEMTYPE_DIRECT           0x06
 
+/*
+ * Pixel layouts we recognize, classified from the mode's color
+ * masks by VBE_SetMode(). Names list channels from the most
+ * significant bits down; the 24-bit formats are packed, three bytes
+ * per pixel.
+ */
+
+#define VBE_PIXFMT_UNKNOWN           0
+#define VBE_PIXFMT_INDEXED8          1
+#define VBE_PIXFMT_RGB555            2
+#define VBE_PIXFMT_RGB565            3
+#define VBE_PIXFMT_RGB888            4
+#define VBE_PIXFMT_BGR888            5
+#define VBE_PIXFMT_XRGB8888          6
+#define VBE_PIXFMT_XBGR8888          7
+#define VBE_PIXFMT_COUNT             8
+
 
 typedef struct {
    uint32       signature;
@@ -118,26 +139,140 @@ typedef struct {
    uint16       offscreenSizeKB;
 } PACKED VBEModeInfo;
 
+/*
+ * The VBE 2.0 protected-mode interface (function 0Ah): 32-bit entry
+ * points into the video BIOS for the functions that are called most
+ * often. They skip BIOS_Call's trip through real mode. 'enabled' is
+ * set when VBE_Init() finds a usable interface; clear it to force
+ * the real-mode path.
+ */
+
 typedef struct {
+   Bool              enabled;
+   void             *setWindow;          // Function 05h
+   void             *setDisplayStart;    // Function 07h
+   void             *setPalette;         // Function 09h
+} VBEProtectedMode;
+
+/*
+ * The parts of each mode's VBEModeInfo that mode selection needs,
+ * fetched once by VBE_Init().
+ */
+
+typedef struct {
+   uint16            mode;
+   uint16            attributes;
+   uint16            width;
+   uint16            height;
+   uint16            bytesPerLine;
+   uint8             bitsPerPixel;
+   uint8             format;          // VBE_PIXFMT_*
+} VBEModeSummary;
+
+typedef struct {
+   Bool              initialized;
    VBEControllerInfo cInfo;
-   uint8             numModes;
-   uint16            modes[MAX_SUPPORTED_MODES];
+   uint32            numModes;
+   VBEModeSummary    modes[MAX_SUPPORTED_MODES];
    struct {
-      uint16         mode;
+      uint16         mode;          // VBE_NO_MODE if set by a native driver
       uint16         flags;
+      uint32         format;        // VBE_PIXFMT_*
+      int            startX;        // Display start address
+      int            startY;
       VBEModeInfo    info;
+
+      /*
+       * A native driver that set the mode without the BIOS moves the
+       * display start address itself. NULL for BIOS modes.
+       */
+      fastcall void (*setDisplayStart)(int x, int y, Bool vblank);
    } current;
+   VBEProtectedMode  pm;
 } VBEState;
 
 extern VBEState gVBE;
 
+/*
+ * A VBESurface divides video memory into two or three full-screen
+ * pages. Apps draw straight into the hidden back page, and
+ * VBE_Flip() puts it on the screen by moving the display start
+ * address, so no frame is ever copied.
+ *
+ * With three pages and a VBE 3.0 BIOS, a flip that waits for
+ * vertical blank is only scheduled, and we can start drawing the
+ * next frame into the third page while the second waits to appear.
+ * Otherwise, waiting for vertical blank blocks inside the BIOS.
+ */
+
+#define VBE_MAX_PAGES                3
+#define VBE_FLIP_VBLANK              (1 << 0)   // Don't flip mid-frame
+
+typedef struct {
+   uint8       *pages[VBE_MAX_PAGES];
+   uint32       numPages;
+   uint32       pageBytes;
+   uint32       pitch;           // Bytes per scanline
+   uint32       front;           // Page on the screen, or scheduled to be
+   uint32       back;            // Page to draw the next frame into
+   Bool         scheduled;       // A VBE 3.0 scheduled flip may be pending
+} VBESurface;
+
+/*
+ * Flags for VBE_FindMode(). The low bits hold the number of
+ * full-screen pages the app would like to fit in video memory.
+ */
+
+#define VBE_FIND_PAGES(n)            ((n) & 0xFF)
+#define VBE_FIND_EXACT               (1 << 8)   // Size and depth must match
+#define VBE_FIND_LINEAR              (1 << 9)   // Require a linear framebuffer
+#define VBE_NO_MODE                  0xFFFF
+
 fastcall Bool VBE_Init();
 fastcall void VBE_GetModeInfo(uint16 mode, VBEModeInfo *info);
+fastcall uint16 VBE_FindMode(int width, int height, int bpp, uint32 flags);
 fastcall void VBE_SetMode(uint16 mode, uint16 modeFlags);
 
+fastcall void VBE_SetWindow(int window, int position);
 fastcall void VBE_SetStartAddress(int x, int y);
+fastcall void VBE_WaitVBlank(void);
 fastcall void VBE_SetPalette(int firstColor, int numColors, uint32 *colors);
 
 fastcall void VBE_InitSimple(int width, int height, int bpp);
 
+fastcall Bool VBE_InitSurface(VBESurface *surface, int numPages);
+fastcall void VBE_Flip(VBESurface *surface, uint32 flags);
+
+
+/*
+ * VBE_MapRGB --
+ *
+ *    Convert an 8-bit-per-channel color to a pixel value in the
+ *    current mode, using its color masks. For one color at a time;
+ *    convert whole buffers with the pixfmt module.
+ */
+
+static inline uint32
+VBE_MapRGB(uint8 r, uint8 g, uint8 b)
+{
+   const VBEModeInfo *info = &gVBE.current.info;
+
+   return ((r >> (8 - info->red.maskSize)) << info->red.fieldPos) |
+          ((g >> (8 - info->green.maskSize)) << info->green.fieldPos) |
+          ((b >> (8 - info->blue.maskSize)) << info->blue.fieldPos);
+}
+
+
+/*
+ * VBE_SurfaceBackBuffer --
+ *
+ *    Return the page that the next frame should be drawn into.
+ */
+
+static inline void *
+VBE_SurfaceBackBuffer(VBESurface *surface)
+{
+   return surface->pages[surface->back];
+}
+
 #endif /* __VBE_H_ */